@@ -106,6 +106,111 @@ base_uint<BITS>& base_uint<BITS>::operator/=(const base_uint& b)
     return *this;
 }
 
+/**
+ * Divide the little-endian word array pn[0..nWords-1] in place by a nonzero
+ * 64-bit divisor, most significant word first, and return the remainder.
+ */
+static uint64_t DivideWords(uint32_t* pn, int nWords, uint64_t nDiv)
+{
+    uint64_t nRem = 0;
+    if (nDiv <= 0xffffffff) {
+        // The running remainder is below 2**32, so each step fits in 64 bits.
+        for (int i = nWords - 1; i >= 0; i--) {
+            uint64_t n = (nRem << 32) | pn[i];
+            pn[i] = n / nDiv;
+            nRem = n % nDiv;
+        }
+        return nRem;
+    }
+#ifdef __SIZEOF_INT128__
+    for (int i = nWords - 1; i >= 0; i--) {
+        unsigned __int128 n = ((unsigned __int128)nRem << 32) | pn[i];
+        pn[i] = (uint32_t)(n / nDiv);
+        nRem = (uint64_t)(n % nDiv);
+    }
+#else
+    // No 128-bit type: shift each word into the remainder a bit at a time.
+    for (int i = nWords - 1; i >= 0; i--) {
+        uint32_t nQuot = 0;
+        for (int bit = 31; bit >= 0; bit--) {
+            bool fCarry = nRem >> 63;
+            nRem = (nRem << 1) | ((pn[i] >> bit) & 1);
+            if (fCarry || nRem >= nDiv) {
+                nRem -= nDiv;
+                nQuot |= (uint32_t)1 << bit;
+            }
+        }
+        pn[i] = nQuot;
+    }
+#endif
+    return nRem;
+}
+
+template <unsigned int BITS>
+base_uint<BITS>& base_uint<BITS>::Mul64(uint64_t b64)
+{
+    const uint64_t nLow = b64 & 0xffffffff;
+    const uint64_t nHigh = b64 >> 32;
+    uint64_t carry = 0;
+    uint32_t prev = 0;
+    for (int i = 0; i < WIDTH; i++) {
+        // pn[i] * nLow plus the previous word times nHigh, both lined up on word i
+        uint64_t n = carry + nLow * pn[i];
+        uint64_t m = (n & 0xffffffff) + nHigh * prev;
+        prev = pn[i];
+        pn[i] = m & 0xffffffff;
+        carry = (n >> 32) + (m >> 32);
+    }
+    return *this;
+}
+
+template <unsigned int BITS>
+uint64_t base_uint<BITS>::DivMod64(uint64_t b64)
+{
+    if (b64 == 0)
+        throw uint_error("Division by zero");
+    return DivideWords(pn, WIDTH, b64);
+}
+
+template <unsigned int BITS>
+bool base_uint<BITS>::MulDiv(uint64_t nMul, uint64_t nDiv)
+{
+    if (nDiv == 0)
+        throw uint_error("Division by zero");
+
+    // Full product, two words wider than *this
+    uint32_t prod[WIDTH + 2];
+    const uint64_t nLow = nMul & 0xffffffff;
+    const uint64_t nHigh = nMul >> 32;
+    uint64_t carry = 0;
+    for (int i = 0; i < WIDTH; i++) {
+        uint64_t n = carry + nLow * pn[i];
+        prod[i] = n & 0xffffffff;
+        carry = n >> 32;
+    }
+    prod[WIDTH] = carry;
+    prod[WIDTH + 1] = 0;
+    if (nHigh) {
+        carry = 0;
+        for (int i = 0; i < WIDTH; i++) {
+            uint64_t n = carry + prod[i + 1] + nHigh * pn[i];
+            prod[i + 1] = n & 0xffffffff;
+            carry = n >> 32;
+        }
+        prod[WIDTH + 1] = carry;
+    }
+
+    DivideWords(prod, WIDTH + 2, nDiv);
+    if (prod[WIDTH] || prod[WIDTH + 1]) {
+        for (int i = 0; i < WIDTH; i++)
+            pn[i] = 0xffffffff;
+        return false;
+    }
+    for (int i = 0; i < WIDTH; i++)
+        pn[i] = prod[i];
+    return true;
+}
+
 template <unsigned int BITS>
 int base_uint<BITS>::CompareTo(const base_uint<BITS>& b) const
 {
@@ -190,6 +295,9 @@ template base_uint<256>& base_uint<256>::operator>>=(unsigned int);
 template base_uint<256>& base_uint<256>::operator*=(uint32_t b32);
 template base_uint<256>& base_uint<256>::operator*=(const base_uint<256>& b);
 template base_uint<256>& base_uint<256>::operator/=(const base_uint<256>& b);
+template base_uint<256>& base_uint<256>::Mul64(uint64_t b64);
+template uint64_t base_uint<256>::DivMod64(uint64_t b64);
+template bool base_uint<256>::MulDiv(uint64_t nMul, uint64_t nDiv);
 template int base_uint<256>::CompareTo(const base_uint<256>&) const;
 template bool base_uint<256>::EqualTo(uint64_t) const;
 template double base_uint<256>::getdouble() const;
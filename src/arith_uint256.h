@@ -170,6 +170,23 @@ public:
     base_uint& operator*=(const base_uint& b);
     base_uint& operator/=(const base_uint& b);
 
+    /** Multiply by a 64-bit scalar (modulo 2**BITS), one word at a time. */
+    base_uint& Mul64(uint64_t b64);
+
+    /**
+     * Divide by a nonzero 64-bit scalar, one word at a time, and return the
+     * remainder. Much cheaper than operator/=, which works a bit at a time.
+     */
+    uint64_t DivMod64(uint64_t b64);
+
+    /**
+     * Replace by (*this * nMul) / nDiv, rounded down. The product is carried
+     * in two extra words, so unlike *= followed by /= it cannot overflow. If
+     * the quotient itself does not fit, saturates to the largest value and
+     * returns false.
+     */
+    bool MulDiv(uint64_t nMul, uint64_t nDiv);
+
     base_uint& operator++()
     {
         // prefix operator
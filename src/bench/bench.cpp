@@ -30,7 +30,8 @@ benchmark::BenchRunner::RunAll(double elapsedTimeForOne)
 {
     perf_init();
     std::cout << "#Benchmark" << "," << "count" << "," << "min" << "," << "max" << "," << "average" << ","
-              << "min_cycles" << "," << "max_cycles" << "," << "average_cycles" << "\n";
+              << "min_cycles" << "," << "max_cycles" << "," << "average_cycles" << ","
+              << "ns_per_call" << "," << "allocs_per_call" << "\n";
 
     for (const auto &p: benchmarks()) {
         State state(p.first, elapsedTimeForOne);
@@ -50,6 +51,7 @@ bool benchmark::State::KeepRunning()
     if (count == 0) {
         lastTime = beginTime = now = gettimedouble();
         lastCycles = beginCycles = nowCycles = perf_cpucycles();
+        beginAllocations = GetAllocations();
     }
     else {
         now = gettimedouble();
@@ -93,10 +95,13 @@ bool benchmark::State::KeepRunning()
     --count;
 
     // Output results
+    double allocationsPerCall = double(GetAllocations() - beginAllocations) / count / callsPerIteration;
     double average = (now-beginTime)/count;
     int64_t averageCycles = (nowCycles-beginCycles)/count;
+    double nsPerCall = average * 1e9 / callsPerIteration;
     std::cout << std::fixed << std::setprecision(15) << name << "," << count << "," << minTime << "," << maxTime << "," << average << ","
-              << minCycles << "," << maxCycles << "," << averageCycles << "\n";
+              << minCycles << "," << maxCycles << "," << averageCycles << ","
+              << std::setprecision(3) << nsPerCall << "," << allocationsPerCall << "\n";
 
     return false;
 }
@@ -32,6 +32,11 @@ static void CODE_TO_TIME(benchmark::State& state)
 
 BENCHMARK(CODE_TO_TIME);
 
+A case whose loop body makes several calls of the code under test can say so
+with state.SetCallsPerIteration(n) before the loop; the ns_per_call and
+allocs_per_call columns are then per call rather than per loop iteration.
+Allocations are counted by the operator new of allocations.cpp, in all threads.
+
  */
  
 namespace benchmark {
@@ -47,8 +52,10 @@ namespace benchmark {
         uint64_t lastCycles;
         uint64_t minCycles;
         uint64_t maxCycles;
+        uint64_t callsPerIteration;
+        uint64_t beginAllocations;
     public:
-        State(std::string _name, double _maxElapsed) : name(_name), maxElapsed(_maxElapsed), count(0) {
+        State(std::string _name, double _maxElapsed) : name(_name), maxElapsed(_maxElapsed), count(0), callsPerIteration(1) {
             minTime = std::numeric_limits<double>::max();
             maxTime = std::numeric_limits<double>::min();
             minCycles = std::numeric_limits<uint64_t>::max();
@@ -57,8 +64,12 @@ namespace benchmark {
             countMaskInv = 1./(countMask + 1);
         }
         bool KeepRunning();
+        void SetCallsPerIteration(uint64_t calls) { callsPerIteration = calls; }
     };
 
+    /** Number of operator new calls so far, in all threads. */
+    uint64_t GetAllocations();
+
     typedef boost::function<void(State&)> BenchFunction;
 
     class BenchRunner
@@ -0,0 +1,129 @@
+// Copyright (c) 2017 The Litebench developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "chainparams.h"
+#include "chainparamsbase.h"
+#include "crypto/scrypt.h"
+#include "hash.h"
+#include "pow.h"
+#include "powminer.h"
+#include "uint256.h"
+#include "utilstrencodings.h"
+
+#include <assert.h>
+#include <vector>
+
+// What the node does with a block's proof of work once it has one: check a
+// hash against the target, and turn the target into a difficulty for RPC and
+// logs; and the scrypt hash itself, one kernel per case. GetBlockProof is
+// BlockProofScalar in retarget_math.cpp.
+
+static const unsigned int benchBits[] = {
+    0x1f00ffff, 0x1e0fffff, 0x1e03ffff, 0x1d1fffff, 0x1d00ffff, 0x1c0a1b2c, 0x1b04864c, 0x1a0d5a9b,
+};
+
+/** 1024 hashes, as good as random. */
+static std::vector<uint256> GetBenchHashes()
+{
+    std::vector<uint256> vHashes;
+    for (int i = 0; i < 1024; i++)
+        vHashes.push_back(Hash(BEGIN(i), END(i)));
+    return vHashes;
+}
+
+static void GetDifficultyBits(benchmark::State& state)
+{
+    double dSum = 0;
+    state.SetCallsPerIteration(1000);
+    while (state.KeepRunning()) {
+        for (int i = 0; i < 1000; i++)
+            dSum += GetDifficulty(benchBits[i & 7]);
+    }
+    assert(dSum > 0);
+}
+
+static void CheckProofOfWorkHashes(benchmark::State& state)
+{
+    const Consensus::Params& params = Params(CBaseChainParams::MAIN).GetConsensus();
+    std::vector<uint256> vHashes = GetBenchHashes();
+    int nValid = 0;
+    state.SetCallsPerIteration(1000);
+    while (state.KeepRunning()) {
+        for (int i = 0; i < 1000; i++)
+            nValid += CheckProofOfWork(vHashes[i & 1023], benchBits[i & 7], params);
+    }
+    assert(nValid >= 0);
+}
+
+static void MiningTargetCheck(benchmark::State& state)
+{
+    const Consensus::Params& params = Params(CBaseChainParams::MAIN).GetConsensus();
+    std::vector<uint256> vHashes = GetBenchHashes();
+    CMiningTarget target;
+    bool fOk = target.SetCompact(benchBits[1], params.powLimit);
+    assert(fOk);
+    int nValid = 0;
+    state.SetCallsPerIteration(1000);
+    while (state.KeepRunning()) {
+        for (int i = 0; i < 1000; i++)
+            nValid += target.Check(vHashes[i & 1023]);
+    }
+    assert(nValid >= 0);
+}
+
+static void Scrypt(benchmark::State& state)
+{
+    char header[80] = {0}, hash[32];
+    while (state.KeepRunning()) {
+        scrypt_1024_1_1_256(header, hash);
+        header[76]++;
+    }
+}
+
+static void Scrypt_generic(benchmark::State& state)
+{
+    char header[80] = {0}, hash[32];
+    std::vector<char> scratchpad(SCRYPT_SCRATCHPAD_SIZE);
+    while (state.KeepRunning()) {
+        scrypt_1024_1_1_256_sp_generic(header, hash, scratchpad.data());
+        header[76]++;
+    }
+}
+
+#if defined(USE_SSE2)
+static void Scrypt_SSE2(benchmark::State& state)
+{
+    char header[80] = {0}, hash[32];
+    std::vector<char> scratchpad(SCRYPT_SCRATCHPAD_SIZE);
+    while (state.KeepRunning()) {
+        scrypt_1024_1_1_256_sp_sse2(header, hash, scratchpad.data());
+        header[76]++;
+    }
+}
+#endif
+
+static void Scrypt_multi(benchmark::State& state)
+{
+    char header[80] = {0}, hash[32 * SCRYPT_MAX_WAYS];
+    std::vector<char> scratchpad(SCRYPT_MULTI_SCRATCHPAD_SIZE);
+    const int nWays = scrypt_multi_ways();
+    uint32_t nNonce = 0;
+    state.SetCallsPerIteration(nWays);
+    while (state.KeepRunning()) {
+        scrypt_1024_1_1_256_multi(header, nNonce, hash, scratchpad.data());
+        nNonce += nWays;
+    }
+}
+
+BENCHMARK(GetDifficultyBits);
+BENCHMARK(CheckProofOfWorkHashes);
+BENCHMARK(MiningTargetCheck);
+BENCHMARK(Scrypt);
+BENCHMARK(Scrypt_generic);
+#if defined(USE_SSE2)
+BENCHMARK(Scrypt_SSE2);
+#endif
+BENCHMARK(Scrypt_multi);
@@ -0,0 +1,84 @@
+// Copyright (c) 2017 The Litebench developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "chainparams.h"
+#include "chainparamsbase.h"
+#include "pow.h"
+#include "retarget.h"
+#include "sim/simulator.h"
+#include "tinyformat.h"
+
+#include <assert.h>
+#include <memory>
+#include <string>
+
+// GetNextWorkRequired of every algorithm, called for each block of a chain in
+// turn, as a node does when it checks a chain it is syncing. Every loop
+// iteration walks the first N blocks of one simulated chain with a fresh
+// instance, so what an algorithm keeps about the chain (and the allocations
+// that takes) is paid for once per N calls, as it would be.
+
+static const char* const benchAlgorithms[] = {
+    "bitcoin", "dgw3", "kgw", "digishield", "dualkgw3", "oss", "lwma", "asert", "ema",
+};
+
+static const std::pair<const char*, int> benchChainSizes[] = {
+    {"1k", 1000}, {"100k", 100000}, {"1M", 1000000},
+};
+
+static const uint32_t BENCH_GENESIS_TIME = 1500000000;
+
+/** A chain of 1M blocks mined by the simulator at a constant hashrate, built on first use. */
+static const CSimChain& GetBenchChain()
+{
+    static const CHashrateModel hashrate(DEFAULT_SIM_HASHRATE);
+    static std::unique_ptr<CSimulator> sim;
+    if (!sim) {
+        const Consensus::Params& params = Params(CBaseChainParams::MAIN).GetConsensus();
+        sim.reset(new CSimulator(params, *RetargetTable()["bitcoin"], hashrate, 1, benchChainSizes[2].second));
+        sim->Reset(BENCH_GENESIS_TIME, UintToArith256(params.powLimit).GetCompact());
+        sim->Run(benchChainSizes[2].second - 1);
+    }
+    return sim->GetChain();
+}
+
+static void GetNextWorkRequiredChain(benchmark::State& state, const std::string& strAlgorithm, int nBlocks)
+{
+    // A copy of the params to bind each fresh instance to, as the simulator does
+    Consensus::Params params = Params(CBaseChainParams::MAIN).GetConsensus();
+    const CRetargetAlgorithm* palgorithm = RetargetTable()[strAlgorithm];
+    assert(palgorithm);
+    const CSimChain& chain = GetBenchChain();
+    assert(chain.Height() + 1 >= nBlocks);
+
+    CBlockHeader header;
+    state.SetCallsPerIteration(nBlocks);
+    while (state.KeepRunning()) {
+        std::unique_ptr<CRetarget> retarget = palgorithm->factory(params);
+        params.retarget = retarget.get();
+        for (int nHeight = 0; nHeight < nBlocks; nHeight++) {
+            const CBlockIndex* pindex = &chain[nHeight];
+            header.nTime = pindex->nTime + params.nPowTargetSpacing;
+            header.nBits = GetNextWorkRequired(pindex, &header, params);
+        }
+    }
+}
+
+/** Registers GetNextWorkRequired_<algorithm>_<blocks> for every algorithm and chain size. */
+static struct CRetargetBenchmarks
+{
+    CRetargetBenchmarks()
+    {
+        for (const char* pszAlgorithm : benchAlgorithms) {
+            for (const auto& size : benchChainSizes) {
+                std::string strAlgorithm = pszAlgorithm;
+                int nBlocks = size.second;
+                benchmark::BenchRunner(strprintf("GetNextWorkRequired_%s_%s", pszAlgorithm, size.first),
+                    [strAlgorithm, nBlocks](benchmark::State& state) { GetNextWorkRequiredChain(state, strAlgorithm, nBlocks); });
+            }
+        }
+    }
+} retargetBenchmarks;
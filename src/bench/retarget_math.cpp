@@ -0,0 +1,100 @@
+// Copyright (c) 2017 The Litebench developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "arith_uint256.h"
+#include "chain.h"
+
+// The retarget algorithms scale a target by a ratio of two timespans and
+// average targets over a window; GetBlockProof turns every block's target into
+// chain work. Each pair below times the old 256-bit operator path against the
+// scalar one that replaced it, on the same inputs.
+
+static const unsigned int benchTargets[] = {
+    0x1e0fffff, 0x1d00ffff, 0x1c0a1b2c, 0x1b04864c, 0x1a0d5a9b, 0x1f00ffff, 0x1e03ffff, 0x1d1fffff,
+};
+
+static void RetargetScaleOperators(benchmark::State& state)
+{
+    arith_uint256 bnNew;
+    state.SetCallsPerIteration(1000);
+    while (state.KeepRunning()) {
+        for (int i = 0; i < 1000; i++) {
+            bnNew.SetCompact(benchTargets[i & 7]);
+            bnNew *= 450 + i;
+            bnNew /= 600;
+        }
+    }
+}
+
+static void RetargetScaleMulDiv(benchmark::State& state)
+{
+    arith_uint256 bnNew;
+    state.SetCallsPerIteration(1000);
+    while (state.KeepRunning()) {
+        for (int i = 0; i < 1000; i++) {
+            bnNew.SetCompact(benchTargets[i & 7]);
+            bnNew.MulDiv(450 + i, 600);
+        }
+    }
+}
+
+static void RetargetAverageOperators(benchmark::State& state)
+{
+    arith_uint256 bnSum;
+    state.SetCallsPerIteration(1000);
+    while (state.KeepRunning()) {
+        for (int i = 0; i < 1000; i++) {
+            bnSum.SetCompact(benchTargets[i & 7]);
+            bnSum *= 25;
+            bnSum = bnSum / (24 + (i & 15));
+        }
+    }
+}
+
+static void RetargetAverageDivMod64(benchmark::State& state)
+{
+    arith_uint256 bnSum;
+    state.SetCallsPerIteration(1000);
+    while (state.KeepRunning()) {
+        for (int i = 0; i < 1000; i++) {
+            bnSum.SetCompact(benchTargets[i & 7]);
+            bnSum *= 25;
+            bnSum.DivMod64(24 + (i & 15));
+        }
+    }
+}
+
+static void BlockProofOperators(benchmark::State& state)
+{
+    arith_uint256 bnTarget, bnProof;
+    state.SetCallsPerIteration(1000);
+    while (state.KeepRunning()) {
+        for (int i = 0; i < 1000; i++) {
+            bnTarget.SetCompact(benchTargets[i & 7]);
+            bnProof = (~bnTarget / (bnTarget + 1)) + 1;
+        }
+    }
+}
+
+static void BlockProofScalar(benchmark::State& state)
+{
+    CBlockIndex index;
+    arith_uint256 bnProof;
+    state.SetCallsPerIteration(1000);
+    while (state.KeepRunning()) {
+        for (int i = 0; i < 1000; i++) {
+            index.nBits = benchTargets[i & 7];
+            bnProof = GetBlockProof(index);
+        }
+    }
+}
+
+BENCHMARK(RetargetScaleOperators);
+BENCHMARK(RetargetScaleMulDiv);
+BENCHMARK(RetargetAverageOperators);
+BENCHMARK(RetargetAverageDivMod64);
+BENCHMARK(BlockProofOperators);
+BENCHMARK(BlockProofScalar);
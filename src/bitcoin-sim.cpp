@@ -0,0 +1,654 @@
+// Copyright (c) 2017 The Litebench developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#if defined(HAVE_CONFIG_H)
+#include "config/bitcoin-config.h"
+#endif
+
+#include "chainparams.h"
+#include "clientversion.h"
+#include "manifest.h"
+#include "pow.h"
+#include "random.h"
+#include "retarget.h"
+#include "sim/attack.h"
+#include "sim/replay.h"
+#include "sim/scenario.h"
+#include "sim/simulator.h"
+#include "sim/sweep.h"
+#include "telemetry.h"
+#include "util.h"
+#include "utilstrencodings.h"
+#include "utiltime.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <list>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/filesystem.hpp>
+
+static const int CONTINUE_EXECUTION=-1;
+
+//
+// This function returns either one of EXIT_ codes when it's expected to stop the process or
+// CONTINUE_EXECUTION when it's expected to continue further.
+//
+static int AppInitSim(int argc, char* argv[])
+{
+    //
+    // Parameters
+    //
+    ParseParameters(argc, argv);
+
+    // Check for -testnet or -regtest parameter (Params() calls are only valid after this clause)
+    try {
+        SelectParams(ChainNameFromCommandLine());
+    } catch (const std::exception& e) {
+        fprintf(stderr, "Error: %s\n", e.what());
+        return EXIT_FAILURE;
+    }
+
+    if (IsArgSet("-?") || IsArgSet("-h") || IsArgSet("-help"))
+    {
+        const Consensus::Params& params = Params().GetConsensus();
+        // First part of help message is specific to this utility
+        std::string strUsage = strprintf(_("%s retarget simulator version"), _(PACKAGE_NAME)) + " " + FormatFullVersion() + "\n\n" +
+            _("Usage:") + "\n" +
+              "  litebench-sim [options]          " + _("Simulate a chain against the selected retarget algorithm") + "\n" +
+              "  litebench-sim -sweep [options]   " + _("Compare retarget algorithms over many simulated chains") + "\n" +
+              "  litebench-sim -attack [options]  " + _("Measure what timestamp-manipulating miners gain against each retarget algorithm") + "\n" +
+              "  litebench-sim -replay=<path> [options]  " + _("Replay the hashrate history of real block headers through each retarget algorithm") + "\n" +
+              "  litebench-sim -exporttelemetry=<file> [-csv=<file>]  " + _("Convert a retarget telemetry file (see -telemetry) to CSV, on stdout by default") + "\n" +
+              "\n";
+
+        fprintf(stdout, "%s", strUsage.c_str());
+
+        strUsage = HelpMessageGroup(_("Options:"));
+        strUsage += HelpMessageOpt("-?", _("This help message"));
+        strUsage += HelpMessageOpt("-blocks=<n>", strprintf(_("Number of blocks to simulate (default: %u)"), DEFAULT_SIM_BLOCKS));
+        strUsage += HelpMessageOpt("-csv=<file>", _("Write one line per simulated block (per trial with -sweep) to <file>"));
+        strUsage += HelpMessageOpt("-hashrate=<n>", strprintf(_("Total hashrate in hashes per second (default: %g)"), DEFAULT_SIM_HASHRATE));
+        strUsage += HelpMessageOpt("-manifest=<file>", _("Write what this run was (build, seed, mode, algorithms and parameters, genesis block, and the SHA256 of the -csv and -telemetry files) to <file> as JSON, with the results of a single run"));
+        strUsage += HelpMessageOpt("-retarget=<name>", strprintf(_("Retarget algorithm to simulate, by name or number: %s (default: %s)"), ListRetargetAlgorithms(), DEFAULT_RETARGET));
+        strUsage += HelpMessageOpt("-scenario=<file>", _("Hashrate scenario file to simulate, relative to -hashrate (see src/sim/scenario.h and contrib/scenarios)"));
+        strUsage += HelpMessageOpt("-seed=<n>", strprintf(_("Seed for the solve time sampler (default: random). Also mines the genesis block at time %d unless -genesistime is given, so that runs with equal seeds and options give equal results"), SEED_GENESIS_TIME));
+        strUsage += HelpMessageOpt("-telemetry=<file>", _("Write the retarget state of every simulated block to <file>, a memory-mapped columnar file (replaced if it exists)"));
+
+        strUsage += HelpMessageGroup(_("Sweep options:"));
+        strUsage += HelpMessageOpt("-sweep", _("Run every selected algorithm through every selected scenario, several times, and compare"));
+        strUsage += HelpMessageOpt("-algorithms=<name,...>", _("Retarget algorithms to sweep, by name or number (default: all)"));
+        for (const CRetargetParam* pparam : RetargetTable().listParams())
+            strUsage += HelpMessageOpt(strprintf("-%s=<n,...>", pparam->name), strprintf(_("%s, %d to %d (default: %d). Each value given, or each of a <first>:<last>:<step> range, is swept as a variant of %s; a single run takes one value"),
+                _(pparam->description.c_str()), pparam->nMin, pparam->nMax, params.*(pparam->pvalue), pparam->algorithm));
+        strUsage += HelpMessageOpt("-scenarios=<name,...>", _("Hashrate scenarios to sweep: constant, step (multiplied by -stepfactor halfway through), drop (divided by it), a scenario file, or a directory whose *.scn scenario files are all swept (default: constant,step,drop)"));
+        strUsage += HelpMessageOpt("-stepfactor=<n>", strprintf(_("Hashrate multiplier for the step and drop scenarios (default: %g)"), DEFAULT_SWEEP_STEP_FACTOR));
+        strUsage += HelpMessageOpt("-threads=<n>", _("Number of worker threads (default: number of cores)"));
+        strUsage += HelpMessageOpt("-trials=<n>", strprintf(_("Number of runs per algorithm and scenario (default: %u)"), DEFAULT_SWEEP_TRIALS));
+        strUsage += HelpMessageOpt("-warmup=<n>", strprintf(_("Number of leading blocks left out of the sweep statistics (default: %u)"), DEFAULT_SIM_WARMUP));
+
+        strUsage += HelpMessageGroup(_("Attack options (also -algorithms, -threads, -trials and -warmup):"));
+        strUsage += HelpMessageOpt("-attack", strprintf(_("Run every selected algorithm honestly and with an attacker stamping its blocks anywhere consensus allows, over -blocks blocks (default: %u), and compare"), DEFAULT_ATTACK_BLOCKS));
+        strUsage += HelpMessageOpt("-fractions=<n,...>", strprintf(_("Shares of the hashrate to try the attacker with (default: %s)"), DEFAULT_ATTACK_FRACTIONS));
+        strUsage += HelpMessageOpt("-strategies=<name,...>", strprintf(_("Attacker timestamp strategies to try: %s; warp's default period is the retarget interval (default: all)"), ListAttackStrategies()));
+
+        strUsage += HelpMessageGroup(_("Replay options:"));
+        strUsage += HelpMessageOpt("-replay=<path>", _("Reconstruct the hashrate a chain saw from its headers and mine the same span of time with every selected algorithm (-algorithms). <path> is a dump of consecutive 80-byte headers, a blk*.dat block file, or a directory of them"));
+        strUsage += HelpMessageOpt("-replayhead=<n>", strprintf(_("Number of leading headers copied verbatim into every replayed chain, so retargets start from the real difficulty (default: %u)"), DEFAULT_REPLAY_SEED_BLOCKS));
+        strUsage += HelpMessageOpt("-replaywindow=<n>", strprintf(_("Number of headers the observed hashrate is averaged over (default: %u)"), DEFAULT_REPLAY_WINDOW));
+        AppendParamsHelpMessages(strUsage);
+
+        fprintf(stdout, "%s", strUsage.c_str());
+        return EXIT_SUCCESS;
+    }
+    return CONTINUE_EXECUTION;
+}
+
+static void WriteCSV(const std::string& strFile, const CSimChain& chain)
+{
+    FILE* file = fopen(strFile.c_str(), "w");
+    if (!file)
+        throw std::runtime_error(strprintf("Cannot open %s for writing", strFile));
+    fprintf(file, "height,time,solvetime,bits,difficulty\n");
+    for (int nHeight = 0; nHeight <= chain.Height(); nHeight++) {
+        const CBlockIndex& block = chain[nHeight];
+        int64_t nSolveTime = block.pprev ? block.GetBlockTime() - block.pprev->GetBlockTime() : 0;
+        fprintf(file, "%d,%u,%d,%08x,%.8f\n", block.nHeight, block.nTime, (int)nSolveTime, block.nBits, GetDifficulty(block.nBits));
+    }
+    fclose(file);
+}
+
+static std::vector<std::string> SplitList(const std::string& strList)
+{
+    std::vector<std::string> vItems;
+    boost::split(vItems, strList, boost::is_any_of(","));
+    return vItems;
+}
+
+static void WriteSweepCSV(const std::string& strFile, const std::vector<CSweepResult>& vResults)
+{
+    FILE* file = fopen(strFile.c_str(), "w");
+    if (!file)
+        throw std::runtime_error(strprintf("Cannot open %s for writing", strFile));
+    fprintf(file, "retarget,scenario,trial,meanblocktime,stddevblocktime,oscillation,recoverytime,meandifficulty\n");
+    for (const CSweepResult& result : vResults) {
+        for (size_t nTrial = 0; nTrial < result.vTrials.size(); nTrial++) {
+            const CSimStats& stats = result.vTrials[nTrial];
+            fprintf(file, "%s,%s,%u,%.4f,%.4f,%.6f,%lld,%.8f\n", result.palgorithm->name.c_str(), result.strScenario.c_str(), (unsigned int)nTrial,
+                stats.dMeanBlockTime, stats.dStdDevBlockTime, stats.dOscillation, (long long)stats.nRecoveryTime, stats.dMeanDifficulty);
+        }
+    }
+    fclose(file);
+}
+
+/** Values given for a tunable: a list of numbers and <first>:<last>:<step> ranges. */
+static std::vector<int64_t> GetParamValues(const CRetargetParam& param)
+{
+    const std::string strArg = "-" + param.name;
+    std::vector<int64_t> vValues;
+    for (const std::string& strEntry : SplitList(GetArg(strArg, ""))) {
+        std::vector<std::string> vRange;
+        boost::split(vRange, strEntry, boost::is_any_of(":"));
+        int64_t nFirst, nLast, nStep = 1;
+        bool fValid = ParseRetargetParam(param, vRange[0], nFirst);
+        if (vRange.size() == 1)
+            nLast = nFirst;
+        else
+            fValid = fValid && vRange.size() == 3 && ParseRetargetParam(param, vRange[1], nLast) && nLast >= nFirst && ParseInt64(vRange[2], &nStep) && nStep > 0;
+        if (!fValid)
+            throw std::runtime_error(strprintf("Invalid %s entry: '%s' (expected %d to %d, or <first>:<last>:<step>)", strArg, strEntry, param.nMin, param.nMax));
+        // Stop before stepping past nLast, which a huge step would overflow
+        for (int64_t nValue = nFirst; ; nValue += nStep) {
+            vValues.push_back(nValue);
+            if (nLast - nValue < nStep)
+                break;
+        }
+    }
+    return vValues;
+}
+
+//! Parameter grid points of the selected algorithms, which vAlgorithms lists point into
+static std::list<CRetargetAlgorithm> listVariants;
+
+/**
+ * Append algorithm to vAlgorithms once for every point of the grid spanned by
+ * the values given for its tunables; tunables not given keep their defaults,
+ * and with none given the algorithm is appended as it is.
+ */
+static void AddAlgorithm(const CRetargetAlgorithm* palgorithm, std::vector<const CRetargetAlgorithm*>& vAlgorithms)
+{
+    std::vector<RetargetParamValues> vGrid(1);
+    for (const CRetargetParam* pparam : RetargetTable().listParams(palgorithm->name)) {
+        if (!IsArgSet("-" + pparam->name))
+            continue;
+        std::vector<int64_t> vValues = GetParamValues(*pparam);
+        std::vector<RetargetParamValues> vNext;
+        for (const RetargetParamValues& point : vGrid) {
+            for (int64_t nValue : vValues) {
+                vNext.push_back(point);
+                vNext.back().emplace_back(pparam, nValue);
+            }
+        }
+        vGrid.swap(vNext);
+    }
+    if (vGrid.front().empty()) {
+        vAlgorithms.push_back(palgorithm);
+        return;
+    }
+    for (const RetargetParamValues& point : vGrid) {
+        listVariants.push_back(MakeRetargetVariant(*palgorithm, point));
+        vAlgorithms.push_back(&listVariants.back());
+    }
+}
+
+/** The algorithms named by -algorithms, or all of them, each over its parameter grid. */
+static std::vector<const CRetargetAlgorithm*> GetAlgorithms()
+{
+    std::vector<const CRetargetAlgorithm*> vAlgorithms;
+    if (!IsArgSet("-algorithms")) {
+        for (const CRetargetAlgorithm* palgorithm : RetargetTable().listAlgorithms())
+            AddAlgorithm(palgorithm, vAlgorithms);
+        return vAlgorithms;
+    }
+    for (const std::string& strRetarget : SplitList(GetArg("-algorithms", ""))) {
+        const CRetargetAlgorithm* palgorithm = RetargetTable()[strRetarget];
+        if (!palgorithm)
+            throw std::runtime_error(strprintf("Invalid -algorithms entry: '%s'", strRetarget));
+        AddAlgorithm(palgorithm, vAlgorithms);
+    }
+    return vAlgorithms;
+}
+
+/** A manifest for this run of mode strMode over vAlgorithms, for FinishManifest to complete. */
+static CRunManifest StartManifest(const std::string& strMode, uint64_t nSeed, const std::vector<const CRetargetAlgorithm*>& vAlgorithms, const Consensus::Params& params)
+{
+    CRunManifest manifest("litebench-sim");
+    manifest.Set("mode", strMode);
+    manifest.SetSeed(nSeed);
+    manifest.SetRetarget(vAlgorithms, params);
+    return manifest;
+}
+
+/** Record the -csv file, if any, and write the manifest to -manifest, if given. */
+static void FinishManifest(CRunManifest& manifest)
+{
+    if (IsArgSet("-csv"))
+        manifest.AddOutput("csv", GetArg("-csv", ""));
+    if (IsArgSet("-manifest"))
+        manifest.Write(GetArg("-manifest", ""));
+}
+
+/** Names of the entries of v, as a JSON array. */
+template <typename T, typename F>
+static UniValue NameArray(const std::vector<T>& v, F getName)
+{
+    UniValue names(UniValue::VARR);
+    for (const T& item : v)
+        names.push_back(getName(item));
+    return names;
+}
+
+/** Width of the retarget column of a table of vAlgorithms. */
+static int GetNameWidth(const std::vector<const CRetargetAlgorithm*>& vAlgorithms)
+{
+    size_t nWidth = 11;
+    for (const CRetargetAlgorithm* palgorithm : vAlgorithms)
+        nWidth = std::max(nWidth, palgorithm->name.size());
+    return nWidth;
+}
+
+/**
+ * Add the scenarios named by a -scenarios entry: a built-in scenario, a
+ * scenario file, or a directory of *.scn files, taken in file name order.
+ */
+static void AddScenarios(const std::string& strEntry, int64_t nEventTime, double dStepFactor, std::vector<CScenario>& vScenarios)
+{
+    CScenario scenario;
+    if (CScenario::GetBuiltin(strEntry, nEventTime, dStepFactor, scenario)) {
+        vScenarios.push_back(scenario);
+        return;
+    }
+    boost::filesystem::path path(strEntry);
+    if (!boost::filesystem::is_directory(path)) {
+        if (!boost::filesystem::exists(path))
+            throw std::runtime_error(strprintf("Invalid -scenarios entry: '%s' is neither a built-in scenario nor a file", strEntry));
+        vScenarios.push_back(CScenario::Read(strEntry));
+        return;
+    }
+    std::vector<std::string> vFiles;
+    for (boost::filesystem::directory_iterator it(path); it != boost::filesystem::directory_iterator(); ++it) {
+        if (boost::filesystem::is_regular_file(it->status()) && it->path().extension() == ".scn")
+            vFiles.push_back(it->path().string());
+    }
+    if (vFiles.empty())
+        throw std::runtime_error(strprintf("Invalid -scenarios entry: no *.scn files in %s", strEntry));
+    std::sort(vFiles.begin(), vFiles.end());
+    for (const std::string& strFile : vFiles)
+        vScenarios.push_back(CScenario::Read(strFile));
+}
+
+static void Sweep(const Consensus::Params& params, int nBlocks, double dHashrate, uint64_t nSeed)
+{
+    CSweepConfig config;
+    config.nBlocks = nBlocks;
+    config.dHashrate = dHashrate;
+    config.nSeed = nSeed;
+    config.nTrials = GetArg("-trials", DEFAULT_SWEEP_TRIALS);
+    if (config.nTrials < 1)
+        throw std::runtime_error("-trials must be positive");
+    config.nWarmup = GetArg("-warmup", DEFAULT_SIM_WARMUP);
+    if (config.nWarmup < 0 || config.nWarmup >= nBlocks)
+        throw std::runtime_error("-warmup must be at least 0 and less than -blocks");
+    config.nThreads = GetArg("-threads", GetNumCores());
+    if (config.nThreads < 1)
+        config.nThreads = 1;
+    double dStepFactor = DEFAULT_SWEEP_STEP_FACTOR;
+    if (IsArgSet("-stepfactor") && (!ParseDouble(GetArg("-stepfactor", ""), &dStepFactor) || dStepFactor <= 0))
+        throw std::runtime_error(strprintf("Invalid -stepfactor: '%s'", GetArg("-stepfactor", "")));
+    config.vAlgorithms = GetAlgorithms();
+    int64_t nEventTime = (int64_t)(nBlocks / 2) * params.nPowTargetSpacing;
+    for (const std::string& strScenario : SplitList(GetArg("-scenarios", "constant,step,drop")))
+        AddScenarios(strScenario, nEventTime, dStepFactor, config.vScenarios);
+    size_t nNameWidth = 9;
+    for (const CScenario& scenario : config.vScenarios)
+        nNameWidth = std::max(nNameWidth, scenario.strName.size());
+
+    const CBlock& genesis = Params().GenesisBlock();
+    int64_t nStart = GetTimeMicros();
+    std::vector<CSweepResult> vResults = RunSweep(params, genesis.nTime, genesis.nBits, config);
+    int64_t nDuration = GetTimeMicros() - nStart;
+
+    fprintf(stdout, "seed %llu, %d trials of %d blocks (%d warmup), hashrate %g H/s, target spacing %d\n\n", (unsigned long long)nSeed,
+        config.nTrials, nBlocks, config.nWarmup, dHashrate, (int)params.nPowTargetSpacing);
+    const int nRetargetWidth = GetNameWidth(config.vAlgorithms);
+    fprintf(stdout, "%-*s %-*s %17s %17s %15s %21s\n", nRetargetWidth, "retarget", (int)nNameWidth, "scenario", "block time", "block time sd", "oscillation", "recovery (s)");
+    for (const CSweepResult& result : vResults) {
+        std::string strRecovery = "-";
+        if (result.fEvent) {
+            strRecovery = result.recoveryTime.Count() ? strprintf("%.0f +- %.0f", result.recoveryTime.Mean(), result.recoveryTime.StdDev()) : "never";
+            if (result.nUnrecovered)
+                strRecovery += strprintf(" (%d never)", result.nUnrecovered);
+        }
+        fprintf(stdout, "%-*s %-*s %8.2f +- %-5.2f %8.2f +- %-5.2f %6.3f +- %-5.3f %21s\n", nRetargetWidth, result.palgorithm->name.c_str(), (int)nNameWidth, result.strScenario.c_str(),
+            result.meanBlockTime.Mean(), result.meanBlockTime.StdDev(), result.stdDevBlockTime.Mean(), result.stdDevBlockTime.StdDev(),
+            result.oscillation.Mean(), result.oscillation.StdDev(), strRecovery.c_str());
+    }
+    fprintf(stdout, "\nwall time: %.3f s on %d threads\n", nDuration * 0.000001, config.nThreads);
+
+    if (IsArgSet("-csv"))
+        WriteSweepCSV(GetArg("-csv", ""), vResults);
+
+    CRunManifest manifest = StartManifest("sweep", nSeed, config.vAlgorithms, params);
+    manifest.Set("blocks", nBlocks);
+    manifest.Set("warmup", config.nWarmup);
+    manifest.Set("trials", config.nTrials);
+    manifest.Set("hashrate", dHashrate);
+    manifest.Set("stepfactor", dStepFactor);
+    manifest.Set("scenarios", NameArray(config.vScenarios, [](const CScenario& scenario) { return scenario.strName; }));
+    FinishManifest(manifest);
+}
+
+static void WriteAttackCSV(const std::string& strFile, const std::vector<CAttackResult>& vResults)
+{
+    FILE* file = fopen(strFile.c_str(), "w");
+    if (!file)
+        throw std::runtime_error(strprintf("Cannot open %s for writing", strFile));
+    fprintf(file, "retarget,strategy,fraction,speedup,speedupsd,difficulty,mindifficulty,finaldifficulty,timelag,stalled\n");
+    for (const CAttackResult& result : vResults) {
+        fprintf(file, "%s,%s,%g,%.6f,%.6f,%.6f,%.6f,%.6f,%.0f,%d\n", result.palgorithm->name.c_str(), result.strategy.ToString().c_str(), result.dFraction,
+            result.speedup.Mean(), result.speedup.StdDev(), result.difficulty.Mean(), result.minDifficulty.Mean(), result.finalDifficulty.Mean(), result.timeLag.Mean(), result.nStalled);
+    }
+    fclose(file);
+}
+
+static void Attack(const Consensus::Params& params, int nBlocks, double dHashrate, uint64_t nSeed)
+{
+    CAttackConfig config;
+    config.nBlocks = nBlocks;
+    config.dHashrate = dHashrate;
+    config.nSeed = nSeed;
+    config.nTrials = GetArg("-trials", DEFAULT_SWEEP_TRIALS);
+    if (config.nTrials < 1)
+        throw std::runtime_error("-trials must be positive");
+    config.nWarmup = GetArg("-warmup", DEFAULT_SIM_WARMUP);
+    if (config.nWarmup < 0 || config.nWarmup >= nBlocks)
+        throw std::runtime_error("-warmup must be at least 0 and less than -blocks");
+    config.nThreads = GetArg("-threads", GetNumCores());
+    if (config.nThreads < 1)
+        config.nThreads = 1;
+    config.vAlgorithms = GetAlgorithms();
+    for (const std::string& strStrategy : SplitList(GetArg("-strategies", "mtp,future,alternate,warp,random"))) {
+        CAttackStrategy strategy;
+        if (!CAttackStrategy::Parse(strStrategy, params.DifficultyAdjustmentInterval(), strategy))
+            throw std::runtime_error(strprintf("Invalid -strategies entry: '%s'", strStrategy));
+        config.vStrategies.push_back(strategy);
+    }
+    for (const std::string& strFraction : SplitList(GetArg("-fractions", DEFAULT_ATTACK_FRACTIONS))) {
+        double dFraction;
+        if (!ParseDouble(strFraction, &dFraction) || dFraction <= 0 || dFraction > 1)
+            throw std::runtime_error(strprintf("Invalid -fractions entry: '%s'", strFraction));
+        config.vFractions.push_back(dFraction);
+    }
+
+    const CBlock& genesis = Params().GenesisBlock();
+    int64_t nStart = GetTimeMicros();
+    std::vector<CAttackResult> vResults = RunAttacks(params, genesis.nTime, genesis.nBits, config);
+    int64_t nDuration = GetTimeMicros() - nStart;
+
+    fprintf(stdout, "seed %llu, %d trials of %d blocks (%d warmup), hashrate %g H/s, target spacing %d\n", (unsigned long long)nSeed,
+        config.nTrials, nBlocks, config.nWarmup, dHashrate, (int)params.nPowTargetSpacing);
+    fprintf(stdout, "speedup: blocks per wall clock second over an honest chain; difficulty: attacked over honest (mean, min, last tenth);\n"
+                    "stalled: trials whose difficulty ran away until the clock left nTime's range, left out of the other columns\n\n");
+    const int nRetargetWidth = GetNameWidth(config.vAlgorithms);
+    fprintf(stdout, "%-*s %-12s %5s %17s %10s %10s %10s %13s %7s\n", nRetargetWidth, "retarget", "strategy", "share", "speedup", "difficulty", "min diff", "final diff", "time lag (h)", "stalled");
+    for (const CAttackResult& result : vResults) {
+        if (!result.speedup.Count()) {
+            fprintf(stdout, "%-*s %-12s %5.2f %17s %10s %10s %10s %13s %7d\n", nRetargetWidth, result.palgorithm->name.c_str(), result.strategy.ToString().c_str(), result.dFraction,
+                "-", "-", "-", "-", "-", result.nStalled);
+            continue;
+        }
+        fprintf(stdout, "%-*s %-12s %5.2f %8.3f +- %-5.3f %10.4f %10.4f %10.4f %13.1f %7d\n", nRetargetWidth, result.palgorithm->name.c_str(), result.strategy.ToString().c_str(), result.dFraction,
+            result.speedup.Mean(), result.speedup.StdDev(), result.difficulty.Mean(), result.minDifficulty.Mean(), result.finalDifficulty.Mean(), result.timeLag.Mean() / 3600, result.nStalled);
+    }
+    fprintf(stdout, "\nwall time: %.3f s on %d threads\n", nDuration * 0.000001, config.nThreads);
+
+    if (IsArgSet("-csv"))
+        WriteAttackCSV(GetArg("-csv", ""), vResults);
+
+    CRunManifest manifest = StartManifest("attack", nSeed, config.vAlgorithms, params);
+    manifest.Set("blocks", nBlocks);
+    manifest.Set("warmup", config.nWarmup);
+    manifest.Set("trials", config.nTrials);
+    manifest.Set("hashrate", dHashrate);
+    manifest.Set("strategies", NameArray(config.vStrategies, [](const CAttackStrategy& strategy) { return strategy.ToString(); }));
+    manifest.Set("fractions", NameArray(config.vFractions, [](double dFraction) { return UniValue(dFraction); }));
+    FinishManifest(manifest);
+}
+
+static void WriteReplayCSV(const std::string& strFile, const CHashrateHistory& history, const std::vector<CReplayResult>& vResults)
+{
+    FILE* file = fopen(strFile.c_str(), "w");
+    if (!file)
+        throw std::runtime_error(strprintf("Cannot open %s for writing", strFile));
+    fprintf(file, "retarget,day,blocks,meanblocktime,meandifficulty\n");
+    auto writeDays = [file](const std::string& strName, const std::vector<CReplayDay>& vDays) {
+        for (size_t nDay = 0; nDay < vDays.size(); nDay++) {
+            const CReplayDay& day = vDays[nDay];
+            fprintf(file, "%s,%u,%d,%.4f,%.8g\n", strName.c_str(), (unsigned int)nDay, day.nBlocks,
+                day.nBlocks ? day.dSolveTimeSum / day.nBlocks : 0.0, day.nBlocks ? day.dDifficultySum / day.nBlocks : 0.0);
+        }
+    };
+    writeDays("observed", history.GetDays());
+    for (const CReplayResult& result : vResults)
+        writeDays(result.palgorithm->name, result.vDays);
+    fclose(file);
+}
+
+static void Replay(const Consensus::Params& params, uint64_t nSeed)
+{
+    int nWindow = GetArg("-replaywindow", DEFAULT_REPLAY_WINDOW);
+    if (nWindow < 1)
+        throw std::runtime_error("-replaywindow must be positive");
+    int nHead = GetArg("-replayhead", DEFAULT_REPLAY_SEED_BLOCKS);
+    if (nHead < 1)
+        throw std::runtime_error("-replayhead must be positive");
+    int nThreads = std::max<int>(GetArg("-threads", GetNumCores()), 1);
+    std::vector<const CRetargetAlgorithm*> vAlgorithms = GetAlgorithms();
+
+    const std::string strPath = GetArg("-replay", "");
+    CHashrateHistory history(nWindow, nHead);
+    int64_t nStart = GetTimeMicros();
+    history.Read(strPath);
+    int64_t nReadDuration = GetTimeMicros() - nStart;
+    nStart = GetTimeMicros();
+    std::vector<CReplayResult> vResults = RunReplays(params, history, vAlgorithms, nSeed, nThreads);
+    int64_t nDuration = GetTimeMicros() - nStart;
+
+    const std::vector<CReplayDay>& vObserved = history.GetDays();
+    CReplayDay observed;
+    for (const CReplayDay& day : vObserved) {
+        observed.nBlocks += day.nBlocks;
+        observed.dSolveTimeSum += day.dSolveTimeSum;
+        observed.dDifficultySum += day.dDifficultySum;
+    }
+    fprintf(stdout, "%s: %u headers over %.1f days, first %u copied into every chain; hashrate averaged over %d headers\n", strPath.c_str(),
+        (unsigned int)history.Headers(), (history.GetEndTime() - history.GetStartTime()) / 86400.0, (unsigned int)history.GetSeed().size(), nWindow);
+    fprintf(stdout, "seed %llu, target spacing %d; block time and difficulty columns cover the blocks after the copied ones,\n"
+                    "except for observed, which covers every header\n\n", (unsigned long long)nSeed, (int)params.nPowTargetSpacing);
+    const int nRetargetWidth = GetNameWidth(vAlgorithms);
+    fprintf(stdout, "%-*s %9s %12s %10s %11s %14s\n", nRetargetWidth, "retarget", "blocks", "block time", "stddev", "oscillation", "difficulty");
+    fprintf(stdout, "%-*s %9d %12.2f %10s %11s %14.6g\n", nRetargetWidth, "observed", observed.nBlocks + 1, observed.dSolveTimeSum / std::max(observed.nBlocks, 1), "-", "-",
+        observed.dDifficultySum / std::max(observed.nBlocks, 1));
+    for (const CReplayResult& result : vResults) {
+        const CSimStats& stats = result.stats;
+        fprintf(stdout, "%-*s %9d %12.2f %10.2f %11.4f %14.6g%s\n", nRetargetWidth, result.palgorithm->name.c_str(), (int)history.GetSeed().size() + stats.nBlocks,
+            stats.dMeanBlockTime, stats.dStdDevBlockTime, stats.dOscillation, stats.dMeanDifficulty, result.fTruncated ? "  (cut off: too many blocks)" : "");
+    }
+    fprintf(stdout, "\nread: %.3f s; replay: %.3f s on %d threads\n", nReadDuration * 0.000001, nDuration * 0.000001, std::min<int>(nThreads, vAlgorithms.size()));
+
+    if (IsArgSet("-csv"))
+        WriteReplayCSV(GetArg("-csv", ""), history, vResults);
+
+    CRunManifest manifest = StartManifest("replay", nSeed, vAlgorithms, params);
+    manifest.Set("replay", strPath);
+    manifest.Set("headers", (int64_t)history.Headers());
+    manifest.Set("replayhead", nHead);
+    manifest.Set("replaywindow", nWindow);
+    FinishManifest(manifest);
+}
+
+static int CommandLineSim(int argc, char* argv[])
+{
+    std::string strPrint;
+    int nRet = 0;
+    try {
+        if (IsArgSet("-exporttelemetry")) {
+            FILE* file = stdout;
+            if (IsArgSet("-csv") && !(file = fopen(GetArg("-csv", "").c_str(), "w")))
+                throw std::runtime_error(strprintf("Cannot open %s for writing", GetArg("-csv", "")));
+            uint64_t nRecords = CRetargetTelemetry::ExportCSV(GetArg("-exporttelemetry", ""), file);
+            if (file != stdout) {
+                fclose(file);
+                fprintf(stdout, "%llu records written to %s\n", (unsigned long long)nRecords, GetArg("-csv", "").c_str());
+            }
+            return nRet;
+        }
+
+        const Consensus::Params& params = Params().GetConsensus();
+        const bool fAttack = GetBoolArg("-attack", false);
+        int nBlocks = GetArg("-blocks", fAttack ? DEFAULT_ATTACK_BLOCKS : DEFAULT_SIM_BLOCKS);
+        if (nBlocks < 1)
+            throw std::runtime_error("-blocks must be positive");
+        double dHashrate = DEFAULT_SIM_HASHRATE;
+        if (IsArgSet("-hashrate") && (!ParseDouble(GetArg("-hashrate", ""), &dHashrate) || dHashrate <= 0))
+            throw std::runtime_error(strprintf("Invalid -hashrate: '%s'", GetArg("-hashrate", "")));
+        uint64_t nSeed;
+        if (!GetSeedArg(nSeed))
+            nSeed = GetRand(std::numeric_limits<uint64_t>::max());
+
+        if (fAttack) {
+            Attack(params, nBlocks, dHashrate, nSeed);
+            return nRet;
+        }
+        if (IsArgSet("-replay")) {
+            Replay(params, nSeed);
+            return nRet;
+        }
+        if (GetBoolArg("-sweep", false)) {
+            Sweep(params, nBlocks, dHashrate, nSeed);
+            return nRet;
+        }
+
+        CScenario scenario;
+        if (IsArgSet("-scenario"))
+            scenario = CScenario::Read(GetArg("-scenario", ""));
+        CScenarioHashrateModel hashrate(scenario, dHashrate);
+        std::string strRetarget = GetArg("-retarget", DEFAULT_RETARGET);
+        const CRetargetAlgorithm* palgorithm = RetargetTable()[strRetarget];
+        if (!palgorithm)
+            throw std::runtime_error(strprintf("Unknown retarget algorithm -retarget=%s (expected one of %s)", strRetarget, ListRetargetAlgorithms()));
+        std::vector<const CRetargetAlgorithm*> vAlgorithms;
+        AddAlgorithm(palgorithm, vAlgorithms);
+        if (vAlgorithms.size() > 1)
+            throw std::runtime_error("A single run takes one value per tunable; use -sweep to compare several");
+        palgorithm = vAlgorithms.front();
+        CSimulator sim(params, *palgorithm, hashrate, nSeed, nBlocks);
+        std::unique_ptr<CRetargetTelemetry> telemetry;
+        if (IsArgSet("-telemetry")) {
+            boost::filesystem::remove(GetArg("-telemetry", ""));
+            telemetry.reset(new CRetargetTelemetry(GetArg("-telemetry", "")));
+            sim.SetTelemetry(telemetry.get());
+        }
+        const CBlock& genesis = Params().GenesisBlock();
+        sim.Reset(genesis.nTime, genesis.nBits);
+
+        int64_t nStart = GetTimeMicros();
+        sim.Run(nBlocks);
+        int64_t nDuration = GetTimeMicros() - nStart;
+
+        const CSimChain& chain = sim.GetChain();
+        CSimStats stats = CSimStats::Compute(chain, params, hashrate);
+        fprintf(stdout, "retarget:        %s (%d)\n", palgorithm->name.c_str(), palgorithm->nId);
+        fprintf(stdout, "seed:            %llu\n", (unsigned long long)nSeed);
+        fprintf(stdout, "scenario:        %s\n", scenario.strName.c_str());
+        fprintf(stdout, "hashrate:        %g H/s\n", dHashrate);
+        fprintf(stdout, "blocks:          %d\n", stats.nBlocks);
+        fprintf(stdout, "target spacing:  %d\n", (int)params.nPowTargetSpacing);
+        fprintf(stdout, "mean block time: %.2f\n", stats.dMeanBlockTime);
+        fprintf(stdout, "stddev:          %.2f\n", stats.dStdDevBlockTime);
+        fprintf(stdout, "difficulty:      %.8f (min %.8f, max %.8f)\n", stats.dMeanDifficulty, stats.dMinDifficulty, stats.dMaxDifficulty);
+        fprintf(stdout, "chain time:      %lld s\n", (long long)stats.nElapsed);
+        fprintf(stdout, "wall time:       %.3f s (%.0f blocks/s)\n", nDuration * 0.000001, nBlocks / std::max(nDuration * 0.000001, 0.000001));
+
+        if (IsArgSet("-csv"))
+            WriteCSV(GetArg("-csv", ""), chain);
+
+        CRunManifest manifest = StartManifest("run", nSeed, vAlgorithms, params);
+        manifest.Set("blocks", nBlocks);
+        manifest.Set("hashrate", dHashrate);
+        manifest.Set("scenario", scenario.strName);
+        UniValue results(UniValue::VOBJ);
+        results.pushKV("meanblocktime", stats.dMeanBlockTime);
+        results.pushKV("stddevblocktime", stats.dStdDevBlockTime);
+        results.pushKV("meandifficulty", stats.dMeanDifficulty);
+        results.pushKV("mindifficulty", stats.dMinDifficulty);
+        results.pushKV("maxdifficulty", stats.dMaxDifficulty);
+        results.pushKV("chaintime", stats.nElapsed);
+        results.pushKV("height", chain.Height());
+        results.pushKV("tiptime", chain.Tip()->GetBlockTime());
+        results.pushKV("tipbits", strprintf("%08x", chain.Tip()->nBits));
+        manifest.Set("results", results);
+        if (telemetry) {
+            telemetry->Flush();
+            manifest.AddOutput("telemetry", GetArg("-telemetry", ""));
+        }
+        FinishManifest(manifest);
+    }
+    catch (const std::exception& e) {
+        strPrint = std::string("error: ") + e.what();
+        nRet = EXIT_FAILURE;
+    }
+    catch (...) {
+        PrintExceptionContinue(NULL, "CommandLineSim()");
+        throw;
+    }
+
+    if (strPrint != "") {
+        fprintf((nRet == 0 ? stdout : stderr), "%s\n", strPrint.c_str());
+    }
+    return nRet;
+}
+
+int main(int argc, char* argv[])
+{
+    SetupEnvironment();
+
+    // There is no datadir here; keep anything logged from piling up in memory.
+    fPrintToDebugLog = false;
+
+    try {
+        int ret = AppInitSim(argc, argv);
+        if (ret != CONTINUE_EXECUTION)
+            return ret;
+    }
+    catch (const std::exception& e) {
+        PrintExceptionContinue(&e, "AppInitSim()");
+        return EXIT_FAILURE;
+    } catch (...) {
+        PrintExceptionContinue(NULL, "AppInitSim()");
+        return EXIT_FAILURE;
+    }
+
+    int ret = EXIT_FAILURE;
+    try {
+        ret = CommandLineSim(argc, argv);
+    }
+    catch (const std::exception& e) {
+        PrintExceptionContinue(&e, "CommandLineSim()");
+    } catch (...) {
+        PrintExceptionContinue(NULL, "CommandLineSim()");
+    }
+    return ret;
+}
@@ -11,11 +11,20 @@
 void CChain::SetTip(CBlockIndex *pindex) {
     if (pindex == NULL) {
         vChain.clear();
+        vTime.clear();
+        vBits.clear();
+        vChainWork.clear();
         return;
     }
     vChain.resize(pindex->nHeight + 1);
+    vTime.resize(pindex->nHeight + 1);
+    vBits.resize(pindex->nHeight + 1);
+    vChainWork.resize(pindex->nHeight + 1);
     while (pindex && vChain[pindex->nHeight] != pindex) {
         vChain[pindex->nHeight] = pindex;
+        vTime[pindex->nHeight] = pindex->nTime;
+        vBits[pindex->nHeight] = pindex->nBits;
+        vChainWork[pindex->nHeight] = pindex->nChainWork;
         pindex = pindex->pprev;
     }
 }
@@ -125,6 +134,18 @@ arith_uint256 GetBlockProof(const CBlockIndex& block)
     bnTarget.SetCompact(block.nBits, &fNegative, &fOverflow);
     if (fNegative || fOverflow || bnTarget == 0)
         return 0;
+    // A compact target is a 23-bit mantissa m shifted left by s bits. For
+    // s >= 128 (compact size 19 and up, i.e. every realistic target) the
+    // proof 2**256 / (m*2**s + 1) is q or q-1, where q, r = divmod(2**(256-s), m):
+    // q*(m*2**s + 1) = 2**256 - r*2**s + q, which only exceeds 2**256 if q > r*2**s.
+    int nShift = 8 * ((int)(block.nBits >> 24) - 3);
+    if (nShift >= 128) {
+        arith_uint256 bnProof = arith_uint256(1) << (256 - nShift);
+        uint64_t nRem = bnProof.DivMod64(block.nBits & 0x007fffff);
+        if (bnProof > arith_uint256(nRem) << nShift)
+            --bnProof;
+        return bnProof;
+    }
     // We need to compute 2**256 / (bnTarget+1), but we can't represent 2**256
     // as it's too large for a arith_uint256. However, as 2**256 is at least as large
     // as bnTarget+1, it is equal to ((2**256 - bnTarget - 1) / (bnTarget+1)) + 1,
@@ -132,6 +153,15 @@ arith_uint256 GetBlockProof(const CBlockIndex& block)
     return (~bnTarget / (bnTarget + 1)) + 1;
 }
 
+int64_t GetMedianTimePast(const uint32_t* pTime, int nHeight)
+{
+    int64_t pmedian[CBlockIndex::nMedianTimeSpan];
+    const int nCount = std::min(nHeight + 1, (int)CBlockIndex::nMedianTimeSpan);
+    std::copy(pTime + nHeight + 1 - nCount, pTime + nHeight + 1, pmedian);
+    std::sort(pmedian, pmedian + nCount);
+    return pmedian[nCount / 2];
+}
+
 int64_t GetBlockProofEquivalentTime(const CBlockIndex& to, const CBlockIndex& from, const CBlockIndex& tip, const Consensus::Params& params)
 {
     arith_uint256 r;
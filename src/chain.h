@@ -14,6 +14,12 @@
 
 #include <vector>
 
+/**
+ * Maximum amount of time that a block timestamp is allowed to exceed the
+ * current network-adjusted time before the block will be accepted.
+ */
+static const int64_t MAX_FUTURE_BLOCK_TIME = 2 * 60 * 60;
+
 class CBlockFileInfo
 {
 public:
@@ -205,6 +211,9 @@ public:
     //! (memory only) Maximum nTime in the chain upto and including this block.
     unsigned int nTimeMax;
 
+    //! (memory only) What the retarget reported when it checked this header's nBits. Empty for genesis and for headers checked before this run.
+    CRetargetState retargetState;
+
     void SetNull()
     {
         phashBlock = NULL;
@@ -220,6 +229,7 @@ public:
         nStatus = 0;
         nSequenceId = 0;
         nTimeMax = 0;
+        retargetState = CRetargetState();
 
         nVersion       = 0;
         hashMerkleRoot = uint256();
@@ -353,6 +363,8 @@ public:
 arith_uint256 GetBlockProof(const CBlockIndex& block);
 /** Return the time it would take to redo the work difference between from and to, assuming the current hashrate corresponds to the difficulty at tip, in seconds. */
 int64_t GetBlockProofEquivalentTime(const CBlockIndex& to, const CBlockIndex& from, const CBlockIndex& tip, const Consensus::Params&);
+/** CBlockIndex::GetMedianTimePast of the block at nHeight, read from an array of block times indexed by height. */
+int64_t GetMedianTimePast(const uint32_t* pTime, int nHeight);
 
 /** Used to marshal pointers into hashes for db storage. */
 class CDiskBlockIndex : public CBlockIndex
@@ -423,6 +435,11 @@ public:
 class CChain {
 private:
     std::vector<CBlockIndex*> vChain;
+    //! Header fields of vChain by height, so that scans over a range of the
+    //! chain read contiguous arrays instead of chasing pprev through the index
+    std::vector<uint32_t> vTime;
+    std::vector<uint32_t> vBits;
+    std::vector<arith_uint256> vChainWork;
 
 public:
     /** Returns the index entry for the genesis block of this chain, or NULL if none. */
@@ -466,6 +483,17 @@ public:
         return vChain.size() - 1;
     }
 
+    /** Header fields of the block at a height in this chain, which must exist. */
+    int64_t GetBlockTime(int nHeight) const { return vTime[nHeight]; }
+    uint32_t GetBits(int nHeight) const { return vBits[nHeight]; }
+    const arith_uint256& GetChainWork(int nHeight) const { return vChainWork[nHeight]; }
+
+    /** Median time past of the block at a height in this chain, which must exist. */
+    int64_t GetMedianTimePast(int nHeight) const { return ::GetMedianTimePast(vTime.data(), nHeight); }
+
+    /** pindex->GetMedianTimePast(), without walking the index if pindex is in this chain. */
+    int64_t GetMedianTimePast(const CBlockIndex* pindex) const { return Contains(pindex) ? GetMedianTimePast(pindex->nHeight) : pindex->GetMedianTimePast(); }
+
     /** Set/initialize a chain with a given tip. */
     void SetTip(CBlockIndex *pindex);
 
@@ -6,14 +6,17 @@
 #include "arith_uint256.h"
 #include "chainparams.h"
 #include "consensus/merkle.h"
+#include "powminer.h"
 #include "tinyformat.h"
 #include "util.h"
 #include "utilstrencodings.h"
+#include "utiltime.h"
 
 #include <stdio.h>
 #include <assert.h>
 
 #include <boost/assign/list_of.hpp>
+#include <boost/filesystem/fstream.hpp>
 
 static CBlock CreateGenesisBlock(const char* pszTimestamp, const CScript& genesisOutputScript, uint32_t nTime, uint32_t nNonce, uint32_t nBits, int32_t nVersion, const CAmount& genesisReward)
 {
@@ -43,6 +46,32 @@ static CBlock CreateGenesisBlock(uint32_t nTime, uint32_t nNonce, uint32_t nBits
     return CreateGenesisBlock(pszTimestamp, genesisOutputScript, nTime, nNonce, nBits, nVersion, genesisReward);
 }
 
+static boost::filesystem::path GetGenesisCacheFile()
+{
+    return GetDataDir(false) / "genesis.cache";
+}
+
+/** Look up a cached nonce for (nTime, powLimit); each line is "<nTime> <powLimit> <nNonce>". */
+static bool ReadGenesisCache(uint32_t nTime, const uint256& powLimit, uint32_t& nNonceRet)
+{
+    boost::filesystem::ifstream file(GetGenesisCacheFile());
+    std::string strPowLimit;
+    uint32_t nCacheTime, nNonce;
+    while (file >> nCacheTime >> strPowLimit >> nNonce) {
+        if (nCacheTime == nTime && strPowLimit == powLimit.GetHex()) {
+            nNonceRet = nNonce;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void WriteGenesisCache(uint32_t nTime, const uint256& powLimit, uint32_t nNonce)
+{
+    boost::filesystem::ofstream file(GetGenesisCacheFile(), std::ios_base::app);
+    file << nTime << " " << powLimit.GetHex() << " " << nNonce << "\n";
+}
+
 class CMainParams : public CChainParams {
 public:
     CMainParams() {
@@ -55,6 +84,9 @@ public:
         consensus.powLimit = uint256S("0000fffff0000000000000000000000000000000000000000000000000000000");
         consensus.nPowTargetTimespan = 10 * 60;
         consensus.nPowTargetSpacing = 2.5 * 60;
+        consensus.nLWMAWindow = 72;
+        consensus.nASERTHalfLife = 12 * 60 * 60; // 288 blocks
+        consensus.nEMAWindow = 36;
         consensus.fPowAllowMinDifficultyBlocks = false;
         consensus.fPowNoRetargeting = false;
         consensus.nRuleChangeActivationThreshold = 6048;
@@ -78,18 +110,9 @@ public:
         nDefaultPort = 9333;
         nPruneAfterHeight = 100000;
 
-        // genesis generator
-        uint32_t nTime = time(NULL);
-        uint32_t nNonce = 0;
-        genesis = CreateGenesisBlock(nTime, nNonce, 0x1f00ffff, 1, 0);
-
-        while (UintToArith256(genesis.GetPoWHash()) >
-               UintToArith256(consensus.powLimit)) {
-           nNonce++;
-           if (nNonce % 128 == 0) printf("\rnonce %08x", nNonce);
-           genesis = CreateGenesisBlock(nTime, nNonce, 0x1f00ffff, 1, 0);
-        }
-        consensus.hashGenesisBlock = genesis.GetHash();
+        // The time and nonce are filled in by MineGenesisBlock when the
+        // params are selected; the coinbase, and so the merkle root, is fixed.
+        genesis = CreateGenesisBlock(0, 0, 0x1f00ffff, 1, 0);
 
         base58Prefixes[PUBKEY_ADDRESS] = std::vector<unsigned char>(1,48);
         base58Prefixes[SCRIPT_ADDRESS] = std::vector<unsigned char>(1,5);
@@ -109,6 +132,33 @@ public:
         chainTxData = {};
     }
 };
+
+void CChainParams::MineGenesisBlock(uint32_t nTime, bool fUseCache)
+{
+    if (!consensus.hashGenesisBlock.IsNull() && genesis.nTime == nTime)
+        return;
+
+    int64_t nStart = GetTimeMillis();
+    const CMiningTarget target(UintToArith256(consensus.powLimit));
+    genesis.nTime = nTime;
+
+    // A cached nonce is only trusted after checking it, which costs one hash.
+    bool fCached = fUseCache && ReadGenesisCache(nTime, consensus.powLimit, genesis.nNonce) &&
+                   target.Check(genesis.GetPoWHash());
+    if (!fCached) {
+        uint64_t nHashes;
+        if (!CPowMiner(GetArg("-minerthreads", DEFAULT_MINER_THREADS)).Search(genesis, target, 0, 1ULL << 32, nHashes, true))
+            throw std::runtime_error(strprintf("%s: no genesis nonce meets the proof-of-work limit at time %u", __func__, nTime));
+        if (GetTimeMillis() - nStart >= 250)
+            printf("\rnonce %08x\n", genesis.nNonce);
+        if (fUseCache)
+            WriteGenesisCache(nTime, consensus.powLimit, genesis.nNonce);
+    }
+    consensus.hashGenesisBlock = genesis.GetHash();
+    LogPrintf("Genesis block %s (time %u, nonce %08x) %s in %dms\n", consensus.hashGenesisBlock.ToString(), genesis.nTime, genesis.nNonce,
+              fCached ? "read from the genesis cache" : "mined", GetTimeMillis() - nStart);
+}
+
 static CMainParams mainParams;
 static CChainParams *pCurrentParams = 0;
 const CChainParams &Params() {
@@ -120,7 +170,20 @@ void SelectParams(const std::string& network)
 {
     SelectBaseParams(network);
     pCurrentParams = &Params(network);
+    pCurrentParams->MineGenesisBlock(GetArg("-genesistime", IsArgSet("-seed") ? SEED_GENESIS_TIME : GetTime()), GetBoolArg("-genesiscache", DEFAULT_GENESIS_CACHE));
 }
 void UpdateRegtestBIP9Parameters(Consensus::DeploymentPos d, int64_t nStartTime, int64_t nTimeout)
 {
 }
+
+void UpdateRetarget(CRetarget* retarget)
+{
+    assert(pCurrentParams);
+    pCurrentParams->UpdateRetarget(retarget);
+}
+
+void UpdateRetargetParameter(int64_t Consensus::Params::*pvalue, int64_t nValue)
+{
+    assert(pCurrentParams);
+    pCurrentParams->UpdateRetargetParameter(pvalue, nValue);
+}
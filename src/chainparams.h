@@ -78,6 +78,14 @@ public:
     const std::vector<SeedSpec6>& FixedSeeds() const { return vFixedSeeds; }
     const CCheckpointData& Checkpoints() const { return checkpointData; }
     const ChainTxData& TxData() const { return chainTxData; }
+    void UpdateRetarget(CRetarget* retarget) { consensus.retarget = retarget; }
+    void UpdateRetargetParameter(int64_t Consensus::Params::*pvalue, int64_t nValue) { consensus.*pvalue = nValue; }
+    /**
+     * Set the genesis block time to nTime and find a nonce that meets
+     * powLimit, searching on all cores unless fUseCache finds one in the
+     * genesis cache. Does nothing if the genesis block already has that time.
+     */
+    void MineGenesisBlock(uint32_t nTime, bool fUseCache);
 protected:
     CChainParams() {}
 
@@ -120,4 +128,15 @@ void SelectParams(const std::string& chain);
  */
 void UpdateRegtestBIP9Parameters(Consensus::DeploymentPos d, int64_t nStartTime, int64_t nTimeout);
 
+/**
+ * Binds a retarget algorithm instance to the currently selected parameters.
+ */
+void UpdateRetarget(CRetarget* retarget);
+
+/**
+ * Sets one retarget tunable (see CRetargetParam) of the currently selected
+ * parameters; takes effect for instances created afterwards.
+ */
+void UpdateRetargetParameter(int64_t Consensus::Params::*pvalue, int64_t nValue);
+
 #endif // BITCOIN_CHAINPARAMS_H
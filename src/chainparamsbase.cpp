@@ -17,6 +17,8 @@ const std::string CBaseChainParams::REGTEST = "regtest";
 void AppendParamsHelpMessages(std::string& strUsage, bool debugHelp)
 {
     strUsage += HelpMessageGroup(_("Chain selection options:"));
+    strUsage += HelpMessageOpt("-genesiscache", strprintf(_("Remember mined genesis nonces in genesis.cache in the data directory, keyed by genesis time and proof-of-work limit (default: %u)"), DEFAULT_GENESIS_CACHE));
+    strUsage += HelpMessageOpt("-genesistime=<n>", strprintf(_("Mine the genesis block with time <n> (seconds since epoch) instead of the current time, or %d with -seed"), SEED_GENESIS_TIME));
     strUsage += HelpMessageOpt("-testnet", _("Use the test chain"));
     if (debugHelp) {
         strUsage += HelpMessageOpt("-regtest", "Enter regression test mode, which uses a special chain in which blocks can be solved instantly. "
@@ -8,6 +8,11 @@
 #include <string>
 #include <vector>
 
+/** Default for -genesiscache */
+static const bool DEFAULT_GENESIS_CACHE = false;
+/** Genesis time of -seed runs that do not give -genesistime */
+static const int64_t SEED_GENESIS_TIME = 1500000000;
+
 /**
  * CBaseChainParams defines the base parameters (shared between bitcoin-cli and bitcoind)
  * of a given instance of the Bitcoin system.
@@ -10,6 +10,8 @@
 #include <map>
 #include <string>
 
+class CRetarget;
+
 namespace Consensus {
 
 enum DeploymentPos
@@ -61,6 +63,12 @@ struct Params {
     int64_t nPowTargetSpacing;
     int64_t nPowTargetTimespan;
     int64_t DifficultyAdjustmentInterval() const { return nPowTargetTimespan / nPowTargetSpacing; }
+    /** Tunables of the per-block retarget algorithms (-lwmawindow, -aserthalflife, -emawindow) */
+    int64_t nLWMAWindow;
+    int64_t nASERTHalfLife;
+    int64_t nEMAWindow;
+    /** Difficulty retarget algorithm bound to this chain (see retarget.h); not owned */
+    CRetarget* retarget = nullptr;
     uint256 nMinimumChainWork;
     uint256 defaultAssumeValid;
 };
@@ -0,0 +1,124 @@
+/*
+ * Copyright 2009 Colin Percival, 2011 ArtForz, 2012-2013 pooler
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file was originally written by Colin Percival as part of the Tarsnap
+ * online backup system.
+ */
+
+/*
+ * Eight-lane ROMix for scrypt_1024_1_1_256_multi. Only this file uses AVX2;
+ * its functions carry the target attribute instead of the whole build
+ * getting -mavx2, and are only called after the CPU has been checked.
+ */
+
+#include "crypto/scrypt.h"
+#include <stdlib.h>
+#include <stdint.h>
+
+#include <immintrin.h>
+
+#define ROTL_8WAY(a, b) _mm256_xor_si256(_mm256_slli_epi32((a), (b)), _mm256_srli_epi32((a), 32 - (b)))
+
+/* xor_salsa8 on eight independent hashes at once: vector k holds word k of each lane. */
+static inline __attribute__((target("avx2"))) void xor_salsa8_8way(__m256i B[16], const __m256i Bx[16])
+{
+	__m256i x[16];
+	int i;
+
+	for (i = 0; i < 16; i++)
+		x[i] = B[i] = _mm256_xor_si256(B[i], Bx[i]);
+
+	for (i = 0; i < 8; i += 2) {
+		/* Operate on columns. */
+		x[ 4] = _mm256_xor_si256(x[ 4], ROTL_8WAY(_mm256_add_epi32(x[ 0], x[12]),  7));
+		x[ 9] = _mm256_xor_si256(x[ 9], ROTL_8WAY(_mm256_add_epi32(x[ 5], x[ 1]),  7));
+		x[14] = _mm256_xor_si256(x[14], ROTL_8WAY(_mm256_add_epi32(x[10], x[ 6]),  7));
+		x[ 3] = _mm256_xor_si256(x[ 3], ROTL_8WAY(_mm256_add_epi32(x[15], x[11]),  7));
+
+		x[ 8] = _mm256_xor_si256(x[ 8], ROTL_8WAY(_mm256_add_epi32(x[ 4], x[ 0]),  9));
+		x[13] = _mm256_xor_si256(x[13], ROTL_8WAY(_mm256_add_epi32(x[ 9], x[ 5]),  9));
+		x[ 2] = _mm256_xor_si256(x[ 2], ROTL_8WAY(_mm256_add_epi32(x[14], x[10]),  9));
+		x[ 7] = _mm256_xor_si256(x[ 7], ROTL_8WAY(_mm256_add_epi32(x[ 3], x[15]),  9));
+
+		x[12] = _mm256_xor_si256(x[12], ROTL_8WAY(_mm256_add_epi32(x[ 8], x[ 4]), 13));
+		x[ 1] = _mm256_xor_si256(x[ 1], ROTL_8WAY(_mm256_add_epi32(x[13], x[ 9]), 13));
+		x[ 6] = _mm256_xor_si256(x[ 6], ROTL_8WAY(_mm256_add_epi32(x[ 2], x[14]), 13));
+		x[11] = _mm256_xor_si256(x[11], ROTL_8WAY(_mm256_add_epi32(x[ 7], x[ 3]), 13));
+
+		x[ 0] = _mm256_xor_si256(x[ 0], ROTL_8WAY(_mm256_add_epi32(x[12], x[ 8]), 18));
+		x[ 5] = _mm256_xor_si256(x[ 5], ROTL_8WAY(_mm256_add_epi32(x[ 1], x[13]), 18));
+		x[10] = _mm256_xor_si256(x[10], ROTL_8WAY(_mm256_add_epi32(x[ 6], x[ 2]), 18));
+		x[15] = _mm256_xor_si256(x[15], ROTL_8WAY(_mm256_add_epi32(x[11], x[ 7]), 18));
+
+		/* Operate on rows. */
+		x[ 1] = _mm256_xor_si256(x[ 1], ROTL_8WAY(_mm256_add_epi32(x[ 0], x[ 3]),  7));
+		x[ 6] = _mm256_xor_si256(x[ 6], ROTL_8WAY(_mm256_add_epi32(x[ 5], x[ 4]),  7));
+		x[11] = _mm256_xor_si256(x[11], ROTL_8WAY(_mm256_add_epi32(x[10], x[ 9]),  7));
+		x[12] = _mm256_xor_si256(x[12], ROTL_8WAY(_mm256_add_epi32(x[15], x[14]),  7));
+
+		x[ 2] = _mm256_xor_si256(x[ 2], ROTL_8WAY(_mm256_add_epi32(x[ 1], x[ 0]),  9));
+		x[ 7] = _mm256_xor_si256(x[ 7], ROTL_8WAY(_mm256_add_epi32(x[ 6], x[ 5]),  9));
+		x[ 8] = _mm256_xor_si256(x[ 8], ROTL_8WAY(_mm256_add_epi32(x[11], x[10]),  9));
+		x[13] = _mm256_xor_si256(x[13], ROTL_8WAY(_mm256_add_epi32(x[12], x[15]),  9));
+
+		x[ 3] = _mm256_xor_si256(x[ 3], ROTL_8WAY(_mm256_add_epi32(x[ 2], x[ 1]), 13));
+		x[ 4] = _mm256_xor_si256(x[ 4], ROTL_8WAY(_mm256_add_epi32(x[ 7], x[ 6]), 13));
+		x[ 9] = _mm256_xor_si256(x[ 9], ROTL_8WAY(_mm256_add_epi32(x[ 8], x[11]), 13));
+		x[14] = _mm256_xor_si256(x[14], ROTL_8WAY(_mm256_add_epi32(x[13], x[12]), 13));
+
+		x[ 0] = _mm256_xor_si256(x[ 0], ROTL_8WAY(_mm256_add_epi32(x[ 3], x[ 2]), 18));
+		x[ 5] = _mm256_xor_si256(x[ 5], ROTL_8WAY(_mm256_add_epi32(x[ 4], x[ 7]), 18));
+		x[10] = _mm256_xor_si256(x[10], ROTL_8WAY(_mm256_add_epi32(x[ 9], x[ 8]), 18));
+		x[15] = _mm256_xor_si256(x[15], ROTL_8WAY(_mm256_add_epi32(x[14], x[13]), 18));
+	}
+
+	for (i = 0; i < 16; i++)
+		B[i] = _mm256_add_epi32(B[i], x[i]);
+}
+
+__attribute__((target("avx2"))) void scrypt_romix_8way_avx2(uint32_t *X, uint32_t *V)
+{
+	__m256i *X8 = (__m256i *)X;
+	__m256i *V8 = (__m256i *)V;
+	__m256i J, L;
+	uint32_t i, k;
+
+	for (i = 0; i < 1024; i++) {
+		for (k = 0; k < 32; k++)
+			V8[i * 32 + k] = X8[k];
+		xor_salsa8_8way(&X8[0], &X8[16]);
+		xor_salsa8_8way(&X8[16], &X8[0]);
+	}
+	/* Word k of lane l in block j sits at V[(j * 32 + k) * 8 + l]. */
+	L = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	for (i = 0; i < 1024; i++) {
+		/* Each lane reads its own, data-dependent, block of V. */
+		J = _mm256_add_epi32(_mm256_slli_epi32(_mm256_and_si256(X8[16], _mm256_set1_epi32(1023)), 8), L);
+		for (k = 0; k < 32; k++)
+			X8[k] = _mm256_xor_si256(X8[k], _mm256_i32gather_epi32((const int *)V, _mm256_add_epi32(J, _mm256_set1_epi32(k * 8)), 4));
+		xor_salsa8_8way(&X8[0], &X8[16]);
+		xor_salsa8_8way(&X8[16], &X8[0]);
+	}
+}
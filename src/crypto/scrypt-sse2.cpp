@@ -134,3 +134,86 @@ void scrypt_1024_1_1_256_sp_sse2(const char *input, char *output, char *scratchp
 
 	PBKDF2_SHA256((const uint8_t *)input, 80, B, 128, 1, (uint8_t *)output, 32);
 }
+
+#define ROTL_4WAY(a, b) _mm_xor_si128(_mm_slli_epi32((a), (b)), _mm_srli_epi32((a), 32 - (b)))
+
+/* xor_salsa8 on four independent hashes at once: vector k holds word k of each lane. */
+static inline void xor_salsa8_4way(__m128i B[16], const __m128i Bx[16])
+{
+	__m128i x[16];
+	int i;
+
+	for (i = 0; i < 16; i++)
+		x[i] = B[i] = _mm_xor_si128(B[i], Bx[i]);
+
+	for (i = 0; i < 8; i += 2) {
+		/* Operate on columns. */
+		x[ 4] = _mm_xor_si128(x[ 4], ROTL_4WAY(_mm_add_epi32(x[ 0], x[12]),  7));
+		x[ 9] = _mm_xor_si128(x[ 9], ROTL_4WAY(_mm_add_epi32(x[ 5], x[ 1]),  7));
+		x[14] = _mm_xor_si128(x[14], ROTL_4WAY(_mm_add_epi32(x[10], x[ 6]),  7));
+		x[ 3] = _mm_xor_si128(x[ 3], ROTL_4WAY(_mm_add_epi32(x[15], x[11]),  7));
+
+		x[ 8] = _mm_xor_si128(x[ 8], ROTL_4WAY(_mm_add_epi32(x[ 4], x[ 0]),  9));
+		x[13] = _mm_xor_si128(x[13], ROTL_4WAY(_mm_add_epi32(x[ 9], x[ 5]),  9));
+		x[ 2] = _mm_xor_si128(x[ 2], ROTL_4WAY(_mm_add_epi32(x[14], x[10]),  9));
+		x[ 7] = _mm_xor_si128(x[ 7], ROTL_4WAY(_mm_add_epi32(x[ 3], x[15]),  9));
+
+		x[12] = _mm_xor_si128(x[12], ROTL_4WAY(_mm_add_epi32(x[ 8], x[ 4]), 13));
+		x[ 1] = _mm_xor_si128(x[ 1], ROTL_4WAY(_mm_add_epi32(x[13], x[ 9]), 13));
+		x[ 6] = _mm_xor_si128(x[ 6], ROTL_4WAY(_mm_add_epi32(x[ 2], x[14]), 13));
+		x[11] = _mm_xor_si128(x[11], ROTL_4WAY(_mm_add_epi32(x[ 7], x[ 3]), 13));
+
+		x[ 0] = _mm_xor_si128(x[ 0], ROTL_4WAY(_mm_add_epi32(x[12], x[ 8]), 18));
+		x[ 5] = _mm_xor_si128(x[ 5], ROTL_4WAY(_mm_add_epi32(x[ 1], x[13]), 18));
+		x[10] = _mm_xor_si128(x[10], ROTL_4WAY(_mm_add_epi32(x[ 6], x[ 2]), 18));
+		x[15] = _mm_xor_si128(x[15], ROTL_4WAY(_mm_add_epi32(x[11], x[ 7]), 18));
+
+		/* Operate on rows. */
+		x[ 1] = _mm_xor_si128(x[ 1], ROTL_4WAY(_mm_add_epi32(x[ 0], x[ 3]),  7));
+		x[ 6] = _mm_xor_si128(x[ 6], ROTL_4WAY(_mm_add_epi32(x[ 5], x[ 4]),  7));
+		x[11] = _mm_xor_si128(x[11], ROTL_4WAY(_mm_add_epi32(x[10], x[ 9]),  7));
+		x[12] = _mm_xor_si128(x[12], ROTL_4WAY(_mm_add_epi32(x[15], x[14]),  7));
+
+		x[ 2] = _mm_xor_si128(x[ 2], ROTL_4WAY(_mm_add_epi32(x[ 1], x[ 0]),  9));
+		x[ 7] = _mm_xor_si128(x[ 7], ROTL_4WAY(_mm_add_epi32(x[ 6], x[ 5]),  9));
+		x[ 8] = _mm_xor_si128(x[ 8], ROTL_4WAY(_mm_add_epi32(x[11], x[10]),  9));
+		x[13] = _mm_xor_si128(x[13], ROTL_4WAY(_mm_add_epi32(x[12], x[15]),  9));
+
+		x[ 3] = _mm_xor_si128(x[ 3], ROTL_4WAY(_mm_add_epi32(x[ 2], x[ 1]), 13));
+		x[ 4] = _mm_xor_si128(x[ 4], ROTL_4WAY(_mm_add_epi32(x[ 7], x[ 6]), 13));
+		x[ 9] = _mm_xor_si128(x[ 9], ROTL_4WAY(_mm_add_epi32(x[ 8], x[11]), 13));
+		x[14] = _mm_xor_si128(x[14], ROTL_4WAY(_mm_add_epi32(x[13], x[12]), 13));
+
+		x[ 0] = _mm_xor_si128(x[ 0], ROTL_4WAY(_mm_add_epi32(x[ 3], x[ 2]), 18));
+		x[ 5] = _mm_xor_si128(x[ 5], ROTL_4WAY(_mm_add_epi32(x[ 4], x[ 7]), 18));
+		x[10] = _mm_xor_si128(x[10], ROTL_4WAY(_mm_add_epi32(x[ 9], x[ 8]), 18));
+		x[15] = _mm_xor_si128(x[15], ROTL_4WAY(_mm_add_epi32(x[14], x[13]), 18));
+	}
+
+	for (i = 0; i < 16; i++)
+		B[i] = _mm_add_epi32(B[i], x[i]);
+}
+
+void scrypt_romix_4way_sse2(uint32_t *X, uint32_t *V)
+{
+	__m128i *X4 = (__m128i *)X;
+	__m128i *V4 = (__m128i *)V;
+	uint32_t i, j, k, l;
+
+	for (i = 0; i < 1024; i++) {
+		for (k = 0; k < 32; k++)
+			V4[i * 32 + k] = X4[k];
+		xor_salsa8_4way(&X4[0], &X4[16]);
+		xor_salsa8_4way(&X4[16], &X4[0]);
+	}
+	for (i = 0; i < 1024; i++) {
+		/* Each lane reads its own, data-dependent, block of V. */
+		for (l = 0; l < 4; l++) {
+			j = 32 * 4 * (X[16 * 4 + l] & 1023) + l;
+			for (k = 0; k < 32; k++)
+				X[k * 4 + l] ^= V[j + k * 4];
+		}
+		xor_salsa8_4way(&X4[0], &X4[16]);
+		xor_salsa8_4way(&X4[16], &X4[0]);
+	}
+}
@@ -29,12 +29,13 @@
 
 #include "crypto/scrypt.h"
 //#include "util.h"
+#include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
 #include <openssl/sha.h>
 
-#if defined(USE_SSE2) && !defined(USE_SSE2_ALWAYS)
+#if (defined(USE_SSE2) && !defined(USE_SSE2_ALWAYS)) || defined(USE_AVX2)
 #ifdef _MSC_VER
 // MSVC 64bit is unable to use inline asm
 #include <intrin.h>
@@ -185,6 +186,39 @@ PBKDF2_SHA256(const uint8_t *passwd, size_t passwdlen, const uint8_t *salt,
 	memset(&PShctx, 0, sizeof(HMAC_SHA256_CTX));
 }
 
+/**
+ * PBKDF2_SHA256 with c = 1 and an already keyed HMAC context: the key setup,
+ * which hashes the 80-byte password, is the same at both ends of a scrypt
+ * hash, so scrypt_1024_1_1_256_multi does it once per lane.
+ */
+static void
+PBKDF2_SHA256_keyed(const HMAC_SHA256_CTX *keyctx, const uint8_t *salt,
+    size_t saltlen, uint8_t *buf, size_t dkLen)
+{
+	HMAC_SHA256_CTX PShctx, hctx;
+	size_t i;
+	uint8_t ivec[4];
+	uint8_t U[32];
+	size_t clen;
+
+	memcpy(&PShctx, keyctx, sizeof(HMAC_SHA256_CTX));
+	HMAC_SHA256_Update(&PShctx, salt, saltlen);
+
+	for (i = 0; i * 32 < dkLen; i++) {
+		be32enc(ivec, (uint32_t)(i + 1));
+		memcpy(&hctx, &PShctx, sizeof(HMAC_SHA256_CTX));
+		HMAC_SHA256_Update(&hctx, ivec, 4);
+		HMAC_SHA256_Final(U, &hctx);
+
+		clen = dkLen - i * 32;
+		if (clen > 32)
+			clen = 32;
+		memcpy(&buf[i * 32], U, clen);
+	}
+
+	memset(&PShctx, 0, sizeof(HMAC_SHA256_CTX));
+}
+
 #define ROTL(a, b) (((a) << (b)) | ((a) >> (32 - (b))))
 
 static inline void xor_salsa8(uint32_t B[16], const uint32_t Bx[16])
@@ -322,6 +356,104 @@ void scrypt_detect_sse2()
 }
 #endif
 
+typedef void (*scrypt_romix_fn)(uint32_t *X, uint32_t *V);
+
+struct scrypt_multi_kernel {
+	int ways;
+	scrypt_romix_fn romix;
+};
+
+static scrypt_multi_kernel scrypt_detect_multi()
+{
+	scrypt_multi_kernel kernel = { 1, NULL };
+#if !defined(_MSC_VER)
+#if defined(USE_AVX2)
+	unsigned int eax, ebx, ecx, edx;
+	unsigned int xcr0_lo, xcr0_hi;
+	/* AVX2 needs the CPU feature and the OS saving the ymm registers. */
+	if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & (1 << 27)) && (ecx & (1 << 28)) &&
+	    __get_cpuid_max(0, NULL) >= 7) {
+		__asm__("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+		__cpuid_count(7, 0, eax, ebx, ecx, edx);
+		if ((xcr0_lo & 6) == 6 && (ebx & (1 << 5))) {
+			kernel.ways = 8;
+			kernel.romix = &scrypt_romix_8way_avx2;
+			return kernel;
+		}
+	}
+#endif
+#if defined(USE_SSE2_ALWAYS)
+	kernel.ways = 4;
+	kernel.romix = &scrypt_romix_4way_sse2;
+#elif defined(USE_SSE2)
+	unsigned int cpuid_eax, cpuid_ebx, cpuid_ecx, cpuid_edx = 0;
+	if (__get_cpuid(1, &cpuid_eax, &cpuid_ebx, &cpuid_ecx, &cpuid_edx) && (cpuid_edx & (1 << 26))) {
+		kernel.ways = 4;
+		kernel.romix = &scrypt_romix_4way_sse2;
+	}
+#endif
+#endif // _MSC_VER
+	return kernel;
+}
+
+static const scrypt_multi_kernel& scrypt_get_multi()
+{
+	/* Checked once, on first use, by whichever thread gets there first. */
+	static const scrypt_multi_kernel kernel = scrypt_detect_multi();
+	return kernel;
+}
+
+int scrypt_multi_ways()
+{
+	return scrypt_get_multi().ways;
+}
+
+void scrypt_1024_1_1_256_multi(const char *input, uint32_t nNonce, char *output, char *scratchpad)
+{
+	const scrypt_multi_kernel& kernel = scrypt_get_multi();
+	uint8_t header[80];
+	uint8_t B[128];
+	int l, k;
+
+	memcpy(header, input, 76);
+	if (kernel.ways == 1) {
+		le32enc(&header[76], nNonce);
+		scrypt_1024_1_1_256_sp((const char *)header, output, scratchpad);
+		return;
+	}
+
+	HMAC_SHA256_CTX keyctx[SCRYPT_MAX_WAYS];
+	SHA256_CTX prefix, kctx;
+	uint8_t khash[32];
+	alignas(32) uint32_t X[32 * SCRYPT_MAX_WAYS];
+	uint32_t *V = (uint32_t *)(((uintptr_t)(scratchpad) + 63) & ~ (uintptr_t)(63));
+
+	/* The password is longer than a SHA256 block, so HMAC keys with its
+	 * hash; the first 64 bytes, all but the nonce, are hashed only once. */
+	SHA256_Init(&prefix);
+	SHA256_Update(&prefix, header, 64);
+
+	for (l = 0; l < kernel.ways; l++) {
+		le32enc(&header[76], nNonce + l);
+		memcpy(&kctx, &prefix, sizeof(SHA256_CTX));
+		SHA256_Update(&kctx, &header[64], 16);
+		SHA256_Final(khash, &kctx);
+		HMAC_SHA256_Init(&keyctx[l], khash, 32);
+
+		PBKDF2_SHA256_keyed(&keyctx[l], header, 80, B, 128);
+		for (k = 0; k < 32; k++)
+			X[k * kernel.ways + l] = le32dec(&B[4 * k]);
+	}
+
+	kernel.romix(X, V);
+
+	for (l = 0; l < kernel.ways; l++) {
+		for (k = 0; k < 32; k++)
+			le32enc(&B[4 * k], X[k * kernel.ways + l]);
+		PBKDF2_SHA256_keyed(&keyctx[l], B, 128, (uint8_t *)&output[32 * l], 32);
+	}
+}
+
 void scrypt_1024_1_1_256(const char *input, char *output)
 {
 	char scratchpad[SCRYPT_SCRATCHPAD_SIZE];
@@ -1,5 +1,10 @@
 #ifndef SCRYPT_H
 #define SCRYPT_H
+
+#if defined(HAVE_CONFIG_H)
+#include "bitcoin-config.h"
+#endif
+
 #include <stdlib.h>
 #include <stdint.h>
 
@@ -23,6 +28,30 @@ extern void (*scrypt_1024_1_1_256_sp_detected)(const char *input, char *output,
 #define scrypt_1024_1_1_256_sp(input, output, scratchpad) scrypt_1024_1_1_256_sp_generic((input), (output), (scratchpad))
 #endif
 
+/** Most nonces scrypt_1024_1_1_256_multi hashes in one call */
+static const int SCRYPT_MAX_WAYS = 8;
+static const int SCRYPT_MULTI_SCRATCHPAD_SIZE = SCRYPT_MAX_WAYS * 131072 + 63;
+
+/**
+ * Number of nonces scrypt_1024_1_1_256_multi hashes per call on this CPU:
+ * 8 with AVX2, 4 with SSE2, otherwise 1. The CPU is checked on first use.
+ */
+int scrypt_multi_ways();
+
+/**
+ * Hash scrypt_multi_ways() consecutive nonces of one 80-byte block header:
+ * the first 76 bytes of input with nonces nNonce, nNonce + 1, ... Writes 32
+ * bytes per nonce to output. scratchpad must hold SCRYPT_MULTI_SCRATCHPAD_SIZE.
+ */
+void scrypt_1024_1_1_256_multi(const char *input, uint32_t nNonce, char *output, char *scratchpad);
+
+#if defined(USE_SSE2)
+void scrypt_romix_4way_sse2(uint32_t *X, uint32_t *V);
+#endif
+#if defined(USE_AVX2)
+void scrypt_romix_8way_avx2(uint32_t *X, uint32_t *V);
+#endif
+
 void
 PBKDF2_SHA256(const uint8_t *passwd, size_t passwdlen, const uint8_t *salt,
     size_t saltlen, uint64_t c, uint8_t *buf, size_t dkLen);
@@ -11,25 +11,32 @@
 
 #include "addrman.h"
 #include "amount.h"
+#include "base58.h"
 #include "chain.h"
 #include "chainparams.h"
 #include "checkpoints.h"
 #include "compat/sanity.h"
 #include "consensus/validation.h"
+#include "crypto/scrypt.h"
 #include "httpserver.h"
 #include "httprpc.h"
 #include "key.h"
+#include "manifest.h"
 #include "validation.h"
 #include "miner.h"
 #include "netbase.h"
 #include "net.h"
 #include "net_processing.h"
 #include "policy/policy.h"
+#include "powminer.h"
+#include "retarget.h"
 #include "rpc/server.h"
 #include "rpc/register.h"
 #include "script/standard.h"
 #include "script/sigcache.h"
 #include "scheduler.h"
+#include "sim/scenario.h"
+#include "telemetry.h"
 #include "timedata.h"
 #include "txdb.h"
 #include "txmempool.h"
@@ -38,6 +45,7 @@
 #include "util.h"
 #include "utilmoneystr.h"
 #include "validationinterface.h"
+#include "virtualclock.h"
 #ifdef ENABLE_WALLET
 #include "wallet/wallet.h"
 #endif
@@ -148,9 +156,9 @@ class CCoinsViewErrorCatcher : public CCoinsViewBacked
 {
 public:
     CCoinsViewErrorCatcher(CCoinsView* view) : CCoinsViewBacked(view) {}
-    bool GetCoins(const uint256 &txid, CCoins &coins) const {
+    bool GetCoin(const COutPoint &outpoint, Coin &coin) const {
         try {
-            return CCoinsViewBacked::GetCoins(txid, coins);
+            return CCoinsViewBacked::GetCoin(outpoint, coin);
         } catch(const std::runtime_error& e) {
             uiInterface.ThreadSafeMessageBox(_("Error reading from database, shutting down."), "", CClientUIInterface::MSG_ERROR);
             LogPrintf("Error reading from database: %s\n", e.what());
@@ -231,12 +239,17 @@ void Shutdown()
         }
         delete pcoinsTip;
         pcoinsTip = NULL;
+        delete pcoinsPrefetch;
+        pcoinsPrefetch = NULL;
         delete pcoinscatcher;
         pcoinscatcher = NULL;
+        delete pcoinsWriteBehind;
+        pcoinsWriteBehind = NULL;
         delete pcoinsdbview;
         pcoinsdbview = NULL;
         delete pblocktree;
         pblocktree = NULL;
+        pretargetTelemetry.reset();
     }
 #ifdef ENABLE_WALLET
     if (pwalletMain)
@@ -337,6 +350,7 @@ std::string HelpMessage(HelpMessageMode mode)
     }
     strUsage += HelpMessageOpt("-datadir=<dir>", _("Specify data directory"));
     strUsage += HelpMessageOpt("-dbcache=<n>", strprintf(_("Set database cache size in megabytes (%d to %d, default: %d)"), nMinDbCache, nMaxDbCache, nDefaultDbCache));
+    strUsage += HelpMessageOpt("-dbwritebehind", strprintf(_("Write the coins cache to disk on a background thread while blocks keep connecting (default: %u)"), DEFAULT_DB_WRITE_BEHIND));
     if (showDebug)
         strUsage += HelpMessageOpt("-feefilter", strprintf("Tell other nodes to filter invs to us by our mempool min fee (default: %u)", DEFAULT_FEEFILTER));
     strUsage += HelpMessageOpt("-loadblock=<file>", _("Imports blocks from external blk000??.dat file on startup"));
@@ -346,6 +360,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-blockreconstructionextratxn=<n>", strprintf(_("Extra transactions to keep in memory for compact block reconstructions (default: %u)"), DEFAULT_BLOCK_RECONSTRUCTION_EXTRA_TXN));
     strUsage += HelpMessageOpt("-par=<n>", strprintf(_("Set the number of script verification threads (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)"),
         -GetNumCores(), MAX_SCRIPTCHECK_THREADS, DEFAULT_SCRIPTCHECK_THREADS));
+    strUsage += HelpMessageOpt("-prefetchthreads=<n>", strprintf(_("Number of threads reading a new block's inputs from the coins database ahead of validation (0 to disable, default: %d)"), DEFAULT_PREFETCH_THREADS));
 #ifndef WIN32
     strUsage += HelpMessageOpt("-pid=<file>", strprintf(_("Specify pid file (default: %s)"), BITCOIN_PID_FILENAME));
 #endif
@@ -484,6 +499,16 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-blockmintxfee=<amt>", strprintf(_("Set lowest fee rate (in %s/kB) for transactions to be included in block creation. (default: %s)"), CURRENCY_UNIT, FormatMoney(DEFAULT_BLOCK_MIN_TX_FEE)));
     if (showDebug)
         strUsage += HelpMessageOpt("-blockversion=<n>", "Override block version to test forking scenarios");
+    strUsage += HelpMessageOpt("-minerthreads=<n>", strprintf(_("Number of threads generate and generatetoaddress search nonces on, and the genesis block is mined on (default: %u, 0 = one per core)"), DEFAULT_MINER_THREADS));
+    strUsage += HelpMessageOpt("-retarget=<name>", strprintf(_("Difficulty retarget algorithm, by name or number: %s (default: %s)"), ListRetargetAlgorithms(), DEFAULT_RETARGET));
+    for (const CRetargetParam* pparam : RetargetTable().listParams())
+        strUsage += HelpMessageOpt(strprintf("-%s=<n>", pparam->name), strprintf(_("%s, %d to %d (default: %d)"), _(pparam->description.c_str()), pparam->nMin, pparam->nMax,
+            Params(CBaseChainParams::MAIN).GetConsensus().*(pparam->pvalue)));
+    strUsage += HelpMessageOpt("-manifest=<file>", _("Write what this run is (build, seed, retarget algorithm and parameters, genesis block, virtual miner) to <file> as JSON at startup (relative to the data directory)"));
+    strUsage += HelpMessageOpt("-seed=<n>", strprintf(_("Make the run reproducible: mine the genesis block at time %d unless -genesistime is given, draw the virtual clock's solve times from <n>, and have generate pay to a key derived from <n>. Requires -virtualhashrate"), SEED_GENESIS_TIME));
+    strUsage += HelpMessageOpt("-telemetry=<file>", _("Append the retarget state of every new tip to <file>, a memory-mapped columnar file readable with litebench-sim -exporttelemetry (relative to the data directory; default: off)"));
+    strUsage += HelpMessageOpt("-virtualhashrate=<n>", _("Run node time on a virtual clock that only moves when generate mines a block, by a solve time sampled for a miner of <n> hashes per second at the block's target (default: 0, use the system clock)"));
+    strUsage += HelpMessageOpt("-virtualscenario=<file>", _("Vary the -virtualhashrate miner over virtual time, and skew block timestamps, as the given litebench-sim scenario file says"));
 
     strUsage += HelpMessageGroup(_("RPC server options:"));
     strUsage += HelpMessageOpt("-server", _("Accept command line and JSON-RPC commands"));
@@ -798,6 +823,11 @@ int nMaxConnections;
 int nUserMaxConnections;
 int nFD;
 ServiceFlags nLocalServices = NODE_NETWORK;
+double dVirtualHashrate = DEFAULT_VIRTUAL_HASHRATE;
+CScenario virtualScenario;
+//! -seed, if given
+bool fRunSeeded = false;
+uint64_t nRunSeed = 0;
 
 }
 
@@ -1071,6 +1101,42 @@ bool AppInitParameterInteraction()
         fEnableReplacement = (std::find(vstrReplacementModes.begin(), vstrReplacementModes.end(), "fee") != vstrReplacementModes.end());
     }
 
+    for (const CRetargetParam* pparam : RetargetTable().listParams()) {
+        std::string strArg = "-" + pparam->name;
+        if (!IsArgSet(strArg))
+            continue;
+        int64_t nValue;
+        if (!ParseRetargetParam(*pparam, GetArg(strArg, ""), nValue))
+            return InitError(strprintf(_("Invalid %s: '%s' (expected %d to %d)"), strArg, GetArg(strArg, ""), pparam->nMin, pparam->nMax));
+        UpdateRetargetParameter(pparam->pvalue, nValue);
+    }
+    std::string strRetarget = GetArg("-retarget", DEFAULT_RETARGET);
+    if (!SelectRetarget(strRetarget))
+        return InitError(strprintf(_("Unknown retarget algorithm -retarget=%s (expected one of %s)"), strRetarget, ListRetargetAlgorithms()));
+    const CRetargetAlgorithm* palgorithm = RetargetTable()[strRetarget];
+    LogPrintf("Using %s algorithm (-retarget=%s)\n", palgorithm->description, palgorithm->name);
+    for (const CRetargetParam* pparam : RetargetTable().listParams(palgorithm->name))
+        LogPrintf("Retarget tunable -%s=%d\n", pparam->name, chainparams.GetConsensus().*(pparam->pvalue));
+
+    if (IsArgSet("-virtualhashrate") && (!ParseDouble(GetArg("-virtualhashrate", ""), &dVirtualHashrate) || dVirtualHashrate < 0))
+        return InitError(strprintf(_("Invalid -virtualhashrate: '%s'"), GetArg("-virtualhashrate", "")));
+    if (IsArgSet("-virtualscenario")) {
+        if (dVirtualHashrate <= 0)
+            return InitError(_("-virtualscenario requires -virtualhashrate"));
+        try {
+            virtualScenario = CScenario::Read(GetArg("-virtualscenario", ""));
+        } catch (const std::runtime_error& e) {
+            return InitError(strprintf(_("Invalid -virtualscenario: %s"), e.what()));
+        }
+    }
+    try {
+        fRunSeeded = GetSeedArg(nRunSeed);
+    } catch (const std::runtime_error& e) {
+        return InitError(e.what());
+    }
+    if (fRunSeeded && dVirtualHashrate <= 0)
+        return InitError(_("-seed requires -virtualhashrate: block times read from the system clock cannot be reproduced"));
+
     if (mapMultiArgs.count("-bip9params")) {
         // Allow overriding BIP9 parameters for testing
         if (!chainparams.MineBlocksOnDemand()) {
@@ -1370,6 +1436,16 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
 
     // ********************************************************* Step 7: load block chain
 
+    if (IsArgSet("-telemetry")) {
+        boost::filesystem::path pathTelemetry = boost::filesystem::absolute(GetArg("-telemetry", ""), GetDataDir());
+        try {
+            pretargetTelemetry.reset(new CRetargetTelemetry(pathTelemetry.string()));
+        } catch (const std::runtime_error& e) {
+            return InitError(e.what());
+        }
+        LogPrintf("Writing retarget telemetry to %s (%u records so far)\n", pathTelemetry.string(), pretargetTelemetry->Count());
+    }
+
     fReindex = GetBoolArg("-reindex", false);
     bool fReindexChainState = GetBoolArg("-reindex-chainstate", false);
 
@@ -1429,14 +1505,22 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
             try {
                 UnloadBlockIndex();
                 delete pcoinsTip;
-                delete pcoinsdbview;
+                delete pcoinsPrefetch;
+                pcoinsPrefetch = NULL;
                 delete pcoinscatcher;
+                delete pcoinsWriteBehind;
+                pcoinsWriteBehind = NULL;
+                delete pcoinsdbview;
                 delete pblocktree;
 
                 pblocktree = new CBlockTreeDB(nBlockTreeDBCache, false, fReindex);
                 pcoinsdbview = new CCoinsViewDB(nCoinDBCache, false, fReindex || fReindexChainState);
-                pcoinscatcher = new CCoinsViewErrorCatcher(pcoinsdbview);
-                pcoinsTip = new CCoinsViewCache(pcoinscatcher);
+                if (GetBoolArg("-dbwritebehind", DEFAULT_DB_WRITE_BEHIND))
+                    pcoinsWriteBehind = new CCoinsViewWriteBehind(pcoinsdbview);
+                pcoinscatcher = new CCoinsViewErrorCatcher(pcoinsWriteBehind ? static_cast<CCoinsView*>(pcoinsWriteBehind) : pcoinsdbview);
+                if (GetArg("-prefetchthreads", DEFAULT_PREFETCH_THREADS) > 0)
+                    pcoinsPrefetch = new CCoinsViewPrefetch(pcoinscatcher, GetArg("-prefetchthreads", DEFAULT_PREFETCH_THREADS));
+                pcoinsTip = new CCoinsViewCache(pcoinsPrefetch ? static_cast<CCoinsView*>(pcoinsPrefetch) : pcoinscatcher);
 
                 if (fReindex) {
                     pblocktree->WriteReindexing(true);
@@ -1455,6 +1539,12 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
                 if (!mapBlockIndex.empty() && mapBlockIndex.count(chainparams.GetConsensus().hashGenesisBlock) == 0)
                     return InitError(_("Incorrect or no genesis block found. Wrong datadir for network?"));
 
+                // Rewrite a chainstate from before per-output coins (no-op if there is nothing to upgrade)
+                if (!pcoinsdbview->Upgrade()) {
+                    strLoadError = _("Error upgrading chainstate database");
+                    break;
+                }
+
                 // Initialize the block index (no-op if non-empty database was already loaded)
                 if (!InitBlockIndex(chainparams)) {
                     strLoadError = _("Error initializing block database");
@@ -1618,6 +1708,36 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
         uiInterface.NotifyBlockTip.disconnect(BlockNotifyGenesisWait);
     }
 
+    if (dVirtualHashrate > 0) {
+        int64_t nStartTime;
+        {
+            LOCK(cs_main);
+            nStartTime = chainActive.Tip()->GetBlockTime();
+        }
+        EnableVirtualClock(dVirtualHashrate, nStartTime, virtualScenario, fRunSeeded ? nRunSeed : GetRand(std::numeric_limits<uint64_t>::max()));
+        LogPrintf("Virtual clock started at %s for %g H/s, scenario %s (-virtualhashrate)\n", DateTimeStrFormat("%Y-%m-%d %H:%M:%S", nStartTime), dVirtualHashrate, virtualScenario.strName);
+    }
+
+    if (IsArgSet("-manifest")) {
+        boost::filesystem::path pathManifest = boost::filesystem::absolute(GetArg("-manifest", ""), GetDataDir());
+        CRunManifest manifest("litebenchd");
+        if (fRunSeeded) {
+            manifest.SetSeed(nRunSeed);
+            CTxDestination dest;
+            ExtractDestination(GetSeedCoinbaseScript(nRunSeed), dest);
+            manifest.Set("coinbaseaddress", CBitcoinAddress(dest).ToString());
+        }
+        manifest.SetRetarget(std::vector<const CRetargetAlgorithm*>(1, SelectedRetargetAlgorithm()), chainparams.GetConsensus());
+        manifest.Set("virtualhashrate", dVirtualHashrate);
+        manifest.Set("scenario", virtualScenario.strName);
+        try {
+            manifest.Write(pathManifest.string());
+        } catch (const std::runtime_error& e) {
+            return InitError(e.what());
+        }
+        LogPrintf("Run manifest written to %s\n", pathManifest.string());
+    }
+
     // ********************************************************* Step 11: start node
 
     //// debug print
@@ -0,0 +1,120 @@
+// Copyright (c) 2017 The Litebench developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "manifest.h"
+
+#include "chainparams.h"
+#include "clientversion.h"
+#include "crypto/sha256.h"
+#include "hash.h"
+#include "key.h"
+#include "retarget.h"
+#include "script/standard.h"
+#include "tinyformat.h"
+#include "util.h"
+#include "utilstrencodings.h"
+
+#include <stdexcept>
+#include <stdio.h>
+
+bool GetSeedArg(uint64_t& nSeedRet)
+{
+    if (!IsArgSet("-seed"))
+        return false;
+    if (!ParseUInt64(GetArg("-seed", ""), &nSeedRet))
+        throw std::runtime_error(strprintf("Invalid -seed: '%s'", GetArg("-seed", "")));
+    return true;
+}
+
+CScript GetSeedCoinbaseScript(uint64_t nSeed)
+{
+    static const std::string strTag = "litebench coinbase key";
+    CHashWriter ss(SER_GETHASH, 0);
+    ss << strTag << nSeed;
+    uint256 hash = ss.GetHash();
+    CKey key;
+    // All but a negligible share of hashes are valid secret keys; hash again otherwise.
+    for (key.Set(hash.begin(), hash.end(), true); !key.IsValid(); key.Set(hash.begin(), hash.end(), true))
+        hash = Hash(hash.begin(), hash.end());
+    return GetScriptForDestination(key.GetPubKey().GetID());
+}
+
+CRunManifest::CRunManifest(const std::string& strProgram) : manifest(UniValue::VOBJ), outputs(UniValue::VOBJ)
+{
+    manifest.pushKV("program", strProgram);
+    manifest.pushKV("version", FormatFullVersion());
+    manifest.pushKV("clientversion", CLIENT_VERSION);
+
+    const CBlock& genesis = Params().GenesisBlock();
+    UniValue genesisObj(UniValue::VOBJ);
+    genesisObj.pushKV("hash", genesis.GetHash().GetHex());
+    genesisObj.pushKV("time", (int64_t)genesis.nTime);
+    genesisObj.pushKV("nonce", (int64_t)genesis.nNonce);
+    genesisObj.pushKV("bits", strprintf("%08x", genesis.nBits));
+    manifest.pushKV("chain", Params().NetworkIDString());
+    manifest.pushKV("genesis", genesisObj);
+}
+
+void CRunManifest::SetSeed(uint64_t nSeed)
+{
+    manifest.pushKV("seed", strprintf("%llu", (unsigned long long)nSeed));
+}
+
+void CRunManifest::SetRetarget(const std::vector<const CRetargetAlgorithm*>& vAlgorithms, const Consensus::Params& params)
+{
+    UniValue algorithms(UniValue::VARR);
+    for (const CRetargetAlgorithm* palgorithm : vAlgorithms) {
+        UniValue algorithm(UniValue::VOBJ);
+        algorithm.pushKV("name", palgorithm->name);
+        algorithm.pushKV("id", palgorithm->nId);
+        algorithms.push_back(algorithm);
+    }
+    manifest.pushKV("retarget", algorithms);
+
+    UniValue consensus(UniValue::VOBJ);
+    consensus.pushKV("powlimit", params.powLimit.GetHex());
+    consensus.pushKV("targetspacing", params.nPowTargetSpacing);
+    consensus.pushKV("targettimespan", params.nPowTargetTimespan);
+    for (const CRetargetParam* pparam : RetargetTable().listParams())
+        consensus.pushKV(pparam->name, params.*(pparam->pvalue));
+    manifest.pushKV("consensus", consensus);
+}
+
+void CRunManifest::AddOutput(const std::string& strName, const std::string& strPath)
+{
+    FILE* file = fopen(strPath.c_str(), "rb");
+    if (!file)
+        throw std::runtime_error(strprintf("Cannot open %s for reading", strPath));
+    CSHA256 hasher;
+    unsigned char buf[65536];
+    size_t nRead;
+    while ((nRead = fread(buf, 1, sizeof(buf), file)) > 0)
+        hasher.Write(buf, nRead);
+    bool fError = ferror(file);
+    fclose(file);
+    if (fError)
+        throw std::runtime_error(strprintf("Cannot read %s", strPath));
+    unsigned char hash[CSHA256::OUTPUT_SIZE];
+    hasher.Finalize(hash);
+
+    UniValue output(UniValue::VOBJ);
+    output.pushKV("path", strPath);
+    output.pushKV("sha256", HexStr(hash, hash + sizeof(hash)));
+    outputs.pushKV(strName, output);
+}
+
+void CRunManifest::Write(const std::string& strPath) const
+{
+    FILE* file = fopen(strPath.c_str(), "w");
+    if (!file)
+        throw std::runtime_error(strprintf("Cannot open %s for writing", strPath));
+    UniValue result = manifest;
+    if (!outputs.empty())
+        result.pushKV("outputs", outputs);
+    std::string strJSON = result.write(2) + "\n";
+    bool fError = fwrite(strJSON.data(), 1, strJSON.size(), file) != strJSON.size();
+    fError |= fclose(file) != 0;
+    if (fError)
+        throw std::runtime_error(strprintf("Cannot write %s", strPath));
+}
@@ -0,0 +1,68 @@
+// Copyright (c) 2017 The Litebench developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_MANIFEST_H
+#define BITCOIN_MANIFEST_H
+
+#include "script/script.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <univalue.h>
+
+class CRetargetAlgorithm;
+
+namespace Consensus { struct Params; }
+
+/** Read -seed into nSeedRet; false if it is not given. Throws std::runtime_error if it is not a 64-bit unsigned number. */
+bool GetSeedArg(uint64_t& nSeedRet);
+
+/**
+ * Script the coinbases of generate pay to in a -seed run, instead of a fresh
+ * wallet key: P2PKH to a key derived from the seed, so that the blocks, and
+ * everything that depends on their hashes, are the same on every run.
+ */
+CScript GetSeedCoinbaseScript(uint64_t nSeed);
+
+/**
+ * What one testbench run was, as JSON: the build, the seed, the retarget
+ * algorithms and the parameters they ran with, the genesis block, and the
+ * result files written, with their SHA256. Nothing that varies between runs
+ * of the same thing (wall time, thread counts) goes in, so two runs with
+ * equal manifests should have produced equal results, and a corpus of
+ * manifests and outputs from a known-good build can be checked against the
+ * next build by rerunning and diffing.
+ */
+class CRunManifest
+{
+private:
+    UniValue manifest;
+    UniValue outputs;
+
+public:
+    /** Start a manifest for strProgram, recording its version and the genesis block of the selected chain. */
+    explicit CRunManifest(const std::string& strProgram);
+
+    void Set(const std::string& strKey, const UniValue& value) { manifest.pushKV(strKey, value); }
+
+    /** Record the seed, as a decimal string: JSON numbers lose 64-bit precision in many readers. */
+    void SetSeed(uint64_t nSeed);
+
+    /**
+     * Record the algorithms, by name (which carries any tunable values of a
+     * parameter grid variant) and number, and the chain's target spacing,
+     * retarget timespan and default tunables.
+     */
+    void SetRetarget(const std::vector<const CRetargetAlgorithm*>& vAlgorithms, const Consensus::Params& params);
+
+    /** Record a result file under strName, with the SHA256 of what it holds now; throws std::runtime_error. */
+    void AddOutput(const std::string& strName, const std::string& strPath);
+
+    /** Write the manifest to strPath; throws std::runtime_error. */
+    void Write(const std::string& strPath) const;
+};
+
+#endif // BITCOIN_MANIFEST_H
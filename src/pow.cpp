@@ -7,19 +7,32 @@
 #include "arith_uint256.h"
 #include "chain.h"
 #include "primitives/block.h"
+#include "retarget.h"
 #include "uint256.h"
 #include "util.h"
+#include "utilstrencodings.h"
 
-bool haveAnnounced = false;
+#include <math.h>
+
+#include <algorithm>
 
 ///////////////////////////////////////////////////////////////////////////////////////////
 // #1 standard bitcoin/litecoin retarget
 ///////////////////////////////////////////////////////////////////////////////////////////
 
-unsigned int testcase1(const CBlockIndex* pindexLast, const CBlockHeader *pblock, const Consensus::Params& params)
+class CBitcoinRetarget : public CWindowRetarget
+{
+public:
+    unsigned int GetNextWorkRequired(const CBlockIndex* pindexLast, const CBlockHeader *pblock, const Consensus::Params& params) override;
+
+    static std::unique_ptr<CRetarget> Create(const Consensus::Params& params) { return std::unique_ptr<CRetarget>(new CBitcoinRetarget()); }
+};
+
+unsigned int CBitcoinRetarget::GetNextWorkRequired(const CBlockIndex* pindexLast, const CBlockHeader *pblock, const Consensus::Params& params)
 {
     assert(pindexLast != nullptr);
     unsigned int nProofOfWorkLimit = UintToArith256(params.powLimit).GetCompact();
+    lastState = CRetargetState();
 
     // Only change once per difficulty adjustment interval
     if ((pindexLast->nHeight+1) % params.DifficultyAdjustmentInterval() != 0)
@@ -29,8 +42,10 @@ unsigned int testcase1(const CBlockIndex* pindexLast, const CBlockHeader *pblock
             // Special difficulty rule for testnet:
             // If the new block's timestamp is more than 2* 10 minutes
             // then allow mining of a min-difficulty block.
-            if (pblock->GetBlockTime() > pindexLast->GetBlockTime() + params.nPowTargetSpacing*2)
+            if (pblock->GetBlockTime() > pindexLast->GetBlockTime() + params.nPowTargetSpacing*2) {
+                lastState.nFlags |= RETARGET_RULE_SLOW;
                 return nProofOfWorkLimit;
+            }
             else
             {
                 // Return the last non-special-min-difficulty-rules-block
@@ -51,26 +66,24 @@ unsigned int testcase1(const CBlockIndex* pindexLast, const CBlockHeader *pblock
         blockstogoback = params.DifficultyAdjustmentInterval();
 
     // Go back by what we want to be 14 days worth of blocks
-    const CBlockIndex* pindexFirst = pindexLast;
-    for (int i = 0; pindexFirst && i < blockstogoback; i++)
-        pindexFirst = pindexFirst->pprev;
-
-    assert(pindexFirst);
+    assert(pindexLast->nHeight >= blockstogoback);
+    const CRetargetCache& window = GetWindow(pindexLast, blockstogoback + 1);
 
-    return testcase1_ext(pindexLast, pindexFirst->GetBlockTime(), params);
+    unsigned int nBits = testcase1_ext(pindexLast, window.GetBlockTime(pindexLast->nHeight - blockstogoback), params, &lastState);
+    lastState.nWindow = blockstogoback + 1;
+    return nBits;
 }
 
-unsigned int testcase1_ext(const CBlockIndex* pindexLast, int64_t nFirstBlockTime, const Consensus::Params& params)
+unsigned int testcase1_ext(const CBlockIndex* pindexLast, int64_t nFirstBlockTime, const Consensus::Params& params, CRetargetState* pstate)
 {
     if (params.fPowNoRetargeting)
         return pindexLast->nBits;
 
     // Limit adjustment step
-    int64_t nActualTimespan = pindexLast->GetBlockTime() - nFirstBlockTime;
-    if (nActualTimespan < params.nPowTargetTimespan/4)
-        nActualTimespan = params.nPowTargetTimespan/4;
-    if (nActualTimespan > params.nPowTargetTimespan*4)
-        nActualTimespan = params.nPowTargetTimespan*4;
+    CRetargetState state;
+    state.nActualTimespan = pindexLast->GetBlockTime() - nFirstBlockTime;
+    state.nTargetTimespan = params.nPowTargetTimespan;
+    int64_t nActualTimespan = state.Clamp(state.nActualTimespan, params.nPowTargetTimespan/4, params.nPowTargetTimespan*4);
 
     // Retarget
     arith_uint256 bnNew;
@@ -82,14 +95,17 @@ unsigned int testcase1_ext(const CBlockIndex* pindexLast, int64_t nFirstBlockTim
     bool fShift = bnNew.bits() > bnPowLimit.bits() - 1;
     if (fShift)
         bnNew >>= 1;
-    bnNew *= nActualTimespan;
-    bnNew /= params.nPowTargetTimespan;
+    bnNew.MulDiv(nActualTimespan, params.nPowTargetTimespan);
     if (fShift)
         bnNew <<= 1;
 
-    if (bnNew > bnPowLimit)
+    if (bnNew > bnPowLimit) {
         bnNew = bnPowLimit;
+        state.nFlags |= RETARGET_POW_LIMIT;
+    }
 
+    if (pstate)
+        *pstate = state;
     return bnNew.GetCompact();
 }
 
@@ -97,10 +113,19 @@ unsigned int testcase1_ext(const CBlockIndex* pindexLast, int64_t nFirstBlockTim
 // #2 darkgravity wave v3 retarget
 ///////////////////////////////////////////////////////////////////////////////////////////
 
-unsigned int static testcase2(const CBlockIndex* pindexLast, const CBlockHeader *pblock, const Consensus::Params& params) {
+class CDarkGravityWaveRetarget : public CWindowRetarget
+{
+public:
+    unsigned int GetNextWorkRequired(const CBlockIndex* pindexLast, const CBlockHeader *pblock, const Consensus::Params& params) override;
+
+    static std::unique_ptr<CRetarget> Create(const Consensus::Params& params) { return std::unique_ptr<CRetarget>(new CDarkGravityWaveRetarget()); }
+};
+
+unsigned int CDarkGravityWaveRetarget::GetNextWorkRequired(const CBlockIndex* pindexLast, const CBlockHeader *pblock, const Consensus::Params& params) {
     /* current difficulty formula, dash - DarkGravity v3, written by Evan Duffield - evan@dash.org */
     const arith_uint256 bnPowLimit = UintToArith256(params.powLimit);
     int64_t nPastBlocks = 24;
+    lastState = CRetargetState();
 
     // make sure we have at least (nPastBlocks + 1) blocks, otherwise just return powLimit
     if (!pindexLast || pindexLast->nHeight < nPastBlocks) {
@@ -110,10 +135,12 @@ unsigned int static testcase2(const CBlockIndex* pindexLast, const CBlockHeader
     if (params.fPowAllowMinDifficultyBlocks) {
         // recent block is more than 2 hours old
         if (pblock->GetBlockTime() > pindexLast->GetBlockTime() + 2 * 60 * 60) {
+            lastState.nFlags |= RETARGET_RULE_SLOW;
             return bnPowLimit.GetCompact();
         }
         // recent block is more than 10 minutes old
         if (pblock->GetBlockTime() > pindexLast->GetBlockTime() + params.nPowTargetSpacing * 4) {
+            lastState.nFlags |= RETARGET_RULE_SLOW;
             arith_uint256 bnNew = arith_uint256().SetCompact(pindexLast->nBits) * 10;
             if (bnNew > bnPowLimit) {
                 bnNew = bnPowLimit;
@@ -122,41 +149,34 @@ unsigned int static testcase2(const CBlockIndex* pindexLast, const CBlockHeader
         }
     }
 
-    const CBlockIndex *pindex = pindexLast;
-    arith_uint256 bnPastTargetAvg;
+    const CRetargetCache& window = GetWindow(pindexLast, nPastBlocks);
+    const int nFirstHeight = pindexLast->nHeight - nPastBlocks + 1;
 
-    for (unsigned int nCountBlocks = 1; nCountBlocks <= nPastBlocks; nCountBlocks++) {
-        arith_uint256 bnTarget = arith_uint256().SetCompact(pindex->nBits);
-        if (nCountBlocks == 1) {
-            bnPastTargetAvg = bnTarget;
-        } else {
-            // NOTE: that's not an average really...
-            bnPastTargetAvg = (bnPastTargetAvg * nCountBlocks + bnTarget) / (nCountBlocks + 1);
-        }
-
-        if(nCountBlocks != nPastBlocks) {
-            assert(pindex->pprev); // should never fail
-            pindex = pindex->pprev;
-        }
+    arith_uint256 bnPastTargetAvg = window.GetTarget(pindexLast->nHeight);
+    for (unsigned int nCountBlocks = 2; nCountBlocks <= nPastBlocks; nCountBlocks++) {
+        // NOTE: that's not an average really...
+        bnPastTargetAvg *= nCountBlocks;
+        bnPastTargetAvg += window.GetTarget(pindexLast->nHeight - nCountBlocks + 1);
+        bnPastTargetAvg.DivMod64(nCountBlocks + 1);
     }
 
     arith_uint256 bnNew(bnPastTargetAvg);
 
-    int64_t nActualTimespan = pindexLast->GetBlockTime() - pindex->GetBlockTime();
+    int64_t nActualTimespan = pindexLast->GetBlockTime() - window.GetBlockTime(nFirstHeight);
     // NOTE: is this accurate? nActualTimespan counts it for (nPastBlocks - 1) blocks only...
     int64_t nTargetTimespan = nPastBlocks * params.nPowTargetSpacing;
 
-    if (nActualTimespan < nTargetTimespan/3)
-        nActualTimespan = nTargetTimespan/3;
-    if (nActualTimespan > nTargetTimespan*3)
-        nActualTimespan = nTargetTimespan*3;
+    lastState.nWindow = nPastBlocks;
+    lastState.nActualTimespan = nActualTimespan;
+    lastState.nTargetTimespan = nTargetTimespan;
+    nActualTimespan = lastState.Clamp(nActualTimespan, nTargetTimespan/3, nTargetTimespan*3);
 
-    // Retarget
-    bnNew *= nActualTimespan;
-    bnNew /= nTargetTimespan;
+    // Retarget; if the product doesn't fit, bnNew saturates and is clamped below
+    bnNew.MulDiv(nActualTimespan, nTargetTimespan);
 
     if (bnNew > bnPowLimit) {
         bnNew = bnPowLimit;
+        lastState.nFlags |= RETARGET_POW_LIMIT;
     }
 
     return bnNew.GetCompact();
@@ -166,85 +186,156 @@ unsigned int static testcase2(const CBlockIndex* pindexLast, const CBlockHeader
 // #3 kimotogravitywell retarget
 ///////////////////////////////////////////////////////////////////////////////////////////
 
-unsigned int static testcase3(const CBlockIndex* pindexLast, const Consensus::Params& params) {
-    const CBlockIndex *BlockLastSolved = pindexLast;
-    const CBlockIndex *BlockReading = pindexLast;
-    uint64_t PastBlocksMass = 0;
-    int64_t PastRateActualSeconds = 0;
-    int64_t PastRateTargetSeconds = 0;
-    double PastRateAdjustmentRatio = double(1);
+/** KGW window found by CKimotoGravityWell::Scan */
+struct KGWWindow
+{
+    uint64_t PastBlocksMass;
+    int64_t PastRateActualSeconds;
+    int64_t PastRateTargetSeconds;
     arith_uint256 PastDifficultyAverage;
-    arith_uint256 PastDifficultyAveragePrev;
-    double EventHorizonDeviation;
-    double EventHorizonDeviationFast;
-    double EventHorizonDeviationSlow;
-
-    uint64_t pastSecondsMin = params.nPowTargetTimespan * 0.025;
-    uint64_t pastSecondsMax = params.nPowTargetTimespan * 7;
-    uint64_t PastBlocksMin = pastSecondsMin / params.nPowTargetSpacing;
-    uint64_t PastBlocksMax = pastSecondsMax / params.nPowTargetSpacing;
-
-    if (BlockLastSolved == NULL || BlockLastSolved->nHeight == 0 || (uint64_t)BlockLastSolved->nHeight < PastBlocksMin) { return UintToArith256(params.powLimit).GetCompact(); }
-
-    for (unsigned int i = 1; BlockReading && BlockReading->nHeight > 0; i++) {
-        if (PastBlocksMax > 0 && i > PastBlocksMax) { break; }
-        PastBlocksMass++;
-
-        PastDifficultyAverage.SetCompact(BlockReading->nBits);
-        if (i > 1) {
-            // handle negative arith_uint256
-            if(PastDifficultyAverage >= PastDifficultyAveragePrev)
-                PastDifficultyAverage = ((PastDifficultyAverage - PastDifficultyAveragePrev) / i) + PastDifficultyAveragePrev;
-            else
-                PastDifficultyAverage = PastDifficultyAveragePrev - ((PastDifficultyAveragePrev - PastDifficultyAverage) / i);
+};
+
+/**
+ * The Kimoto Gravity Well window search shared by KGW and DualKGW3: the window
+ * grows back from the tip, one block at a time, until the observed block rate
+ * leaves the event horizon, and the average target over it is taken.
+ *
+ * Block times and targets come from the window cache, and EventHorizonDeviation
+ * is tabulated by PastBlocksMass up front, so the search is a scan over arrays
+ * rather than a pprev walk. It still costs up to PastBlocksMax steps a call:
+ * the horizon is measured from the tip, so a new block moves every ratio and
+ * the window cannot be carried over from the last call. The average truncates
+ * at each step, as the walk always did.
+ */
+class CKimotoGravityWell : public CWindowRetarget
+{
+private:
+    const uint64_t Blocktime;
+    const uint64_t PastBlocksMax;
+    //! EventHorizonDeviationFast and EventHorizonDeviationSlow, indexed by PastBlocksMass
+    std::vector<double> vEventHorizonFast;
+    std::vector<double> vEventHorizonSlow;
+
+protected:
+    const uint64_t PastBlocksMin;
+
+    CKimotoGravityWell(uint64_t BlocktimeIn, uint64_t PastBlocksMinIn, uint64_t PastBlocksMaxIn, double EventHorizonMass)
+        : Blocktime(BlocktimeIn), PastBlocksMax(PastBlocksMaxIn), vEventHorizonFast(PastBlocksMaxIn + 1), vEventHorizonSlow(PastBlocksMaxIn + 1), PastBlocksMin(PastBlocksMinIn)
+    {
+        for (uint64_t PastBlocksMass = 1; PastBlocksMass <= PastBlocksMax; PastBlocksMass++) {
+            double EventHorizonDeviation = 1 + (0.7084 * pow((double(PastBlocksMass)/EventHorizonMass), -1.228));
+            vEventHorizonFast[PastBlocksMass] = EventHorizonDeviation;
+            vEventHorizonSlow[PastBlocksMass] = 1 / EventHorizonDeviation;
         }
-        PastDifficultyAveragePrev = PastDifficultyAverage;
-
-        PastRateActualSeconds = BlockLastSolved->GetBlockTime() - BlockReading->GetBlockTime();
-        PastRateTargetSeconds = params.nPowTargetSpacing * PastBlocksMass;
-        PastRateAdjustmentRatio = double(1);
-        if (PastRateActualSeconds < 0) { PastRateActualSeconds = 0; }
-        if (PastRateActualSeconds != 0 && PastRateTargetSeconds != 0) {
-            PastRateAdjustmentRatio = double(PastRateTargetSeconds) / double(PastRateActualSeconds);
+    }
+
+    KGWWindow Scan(const CBlockIndex* pindexLast);
+};
+
+KGWWindow CKimotoGravityWell::Scan(const CBlockIndex* pindexLast)
+{
+    const CRetargetCache& cache = GetWindow(pindexLast, PastBlocksMax);
+
+    KGWWindow result;
+    result.PastBlocksMass = 0;
+    result.PastRateActualSeconds = 0;
+    result.PastRateTargetSeconds = 0;
+
+    const int nLastHeight = pindexLast->nHeight;
+    const int64_t nLastTime = pindexLast->GetBlockTime();
+    for (int nHeight = nLastHeight; nHeight > 0; nHeight--) {
+        if (PastBlocksMax > 0 && result.PastBlocksMass >= PastBlocksMax) { break; }
+        result.PastBlocksMass++;
+
+        // handle negative arith_uint256
+        arith_uint256 bnTarget = cache.GetTarget(nHeight);
+        if (result.PastBlocksMass == 1) {
+            result.PastDifficultyAverage = bnTarget;
+        } else if (bnTarget >= result.PastDifficultyAverage) {
+            bnTarget -= result.PastDifficultyAverage;
+            bnTarget.DivMod64(result.PastBlocksMass);
+            result.PastDifficultyAverage += bnTarget;
+        } else {
+            arith_uint256 bnStep = result.PastDifficultyAverage - bnTarget;
+            bnStep.DivMod64(result.PastBlocksMass);
+            result.PastDifficultyAverage -= bnStep;
         }
-        EventHorizonDeviation = 1 + (0.7084 * pow((double(PastBlocksMass)/double(28.2)), -1.228));
-        EventHorizonDeviationFast = EventHorizonDeviation;
-        EventHorizonDeviationSlow = 1 / EventHorizonDeviation;
 
-        if (PastBlocksMass >= PastBlocksMin) {
-                if ((PastRateAdjustmentRatio <= EventHorizonDeviationSlow) || (PastRateAdjustmentRatio >= EventHorizonDeviationFast))
-                { assert(BlockReading); break; }
+        result.PastRateActualSeconds = nLastTime - cache.GetBlockTime(nHeight);
+        result.PastRateTargetSeconds = Blocktime * result.PastBlocksMass;
+        double PastRateAdjustmentRatio = double(1);
+        if (result.PastRateActualSeconds < 0) { result.PastRateActualSeconds = 0; }
+        if (result.PastRateActualSeconds != 0 && result.PastRateTargetSeconds != 0) {
+            PastRateAdjustmentRatio = double(result.PastRateTargetSeconds) / double(result.PastRateActualSeconds);
         }
-        if (BlockReading->pprev == NULL) { assert(BlockReading); break; }
-        BlockReading = BlockReading->pprev;
-    }
 
-    arith_uint256 bnNew(PastDifficultyAverage);
-    if (PastRateActualSeconds != 0 && PastRateTargetSeconds != 0) {
-        bnNew *= PastRateActualSeconds;
-        bnNew /= PastRateTargetSeconds;
+        if (result.PastBlocksMass >= PastBlocksMin) {
+            if ((PastRateAdjustmentRatio <= vEventHorizonSlow[result.PastBlocksMass]) || (PastRateAdjustmentRatio >= vEventHorizonFast[result.PastBlocksMass]))
+                break;
+        }
     }
 
-    if (bnNew > UintToArith256(params.powLimit)) {
-        bnNew = UintToArith256(params.powLimit);
+    return result;
+}
+
+class CKGWRetarget : public CKimotoGravityWell
+{
+public:
+    explicit CKGWRetarget(const Consensus::Params& params)
+        : CKimotoGravityWell(params.nPowTargetSpacing,
+                             (uint64_t)(params.nPowTargetTimespan * 0.025) / params.nPowTargetSpacing,
+                             (uint64_t)(params.nPowTargetTimespan * 7) / params.nPowTargetSpacing,
+                             28.2) {}
+
+    unsigned int GetNextWorkRequired(const CBlockIndex* pindexLast, const CBlockHeader *pblock, const Consensus::Params& params) override
+    {
+        lastState = CRetargetState();
+        if (pindexLast == NULL || pindexLast->nHeight == 0 || (uint64_t)pindexLast->nHeight < PastBlocksMin) { return UintToArith256(params.powLimit).GetCompact(); }
+
+        KGWWindow window = Scan(pindexLast);
+        lastState.nWindow = window.PastBlocksMass;
+        lastState.nActualTimespan = window.PastRateActualSeconds;
+        lastState.nTargetTimespan = window.PastRateTargetSeconds;
+
+        arith_uint256 bnNew(window.PastDifficultyAverage);
+        if (window.PastRateActualSeconds != 0 && window.PastRateTargetSeconds != 0) {
+            bnNew.MulDiv(window.PastRateActualSeconds, window.PastRateTargetSeconds);
+        }
+
+        if (bnNew > UintToArith256(params.powLimit)) {
+            bnNew = UintToArith256(params.powLimit);
+            lastState.nFlags |= RETARGET_POW_LIMIT;
+        }
+
+        return bnNew.GetCompact();
     }
 
-    return bnNew.GetCompact();
-}
+    static std::unique_ptr<CRetarget> Create(const Consensus::Params& params) { return std::unique_ptr<CRetarget>(new CKGWRetarget(params)); }
+};
 
 ///////////////////////////////////////////////////////////////////////////////////////////
 // #4 digishield retarget
 ///////////////////////////////////////////////////////////////////////////////////////////
 
-unsigned int static testcase4(const CBlockIndex* pindexLast, const CBlockHeader *pblock, const Consensus::Params& params)
+class CDigiShieldRetarget : public CWindowRetarget
 {
-    unsigned int bnProofOfWorkLimit = UintToArith256(params.powLimit).GetCompact();
+public:
+    unsigned int GetNextWorkRequired(const CBlockIndex* pindexLast, const CBlockHeader *pblock, const Consensus::Params& params) override;
+
+    static std::unique_ptr<CRetarget> Create(const Consensus::Params& params) { return std::unique_ptr<CRetarget>(new CDigiShieldRetarget()); }
+};
+
+unsigned int CDigiShieldRetarget::GetNextWorkRequired(const CBlockIndex* pindexLast, const CBlockHeader *pblock, const Consensus::Params& params)
+{
+    const arith_uint256 bnPowLimit = UintToArith256(params.powLimit);
+    unsigned int bnProofOfWorkLimit = bnPowLimit.GetCompact();
 
     bool fTestNet = false;
     int blockstogoback = 0;
     int64_t retargetTimespan = params.nPowTargetTimespan;
     int64_t retargetSpacing = params.nPowTargetSpacing;
     int64_t retargetInterval = retargetTimespan / retargetSpacing;
+    lastState = CRetargetState();
 	
     // Genesis block
     if (pindexLast == NULL) return bnProofOfWorkLimit;
@@ -274,31 +365,27 @@ unsigned int static testcase4(const CBlockIndex* pindexLast, const CBlockHeader
     if ((pindexLast->nHeight+1) != retargetInterval) blockstogoback = retargetInterval;
 
     // Go back by what we want to be 14 days worth of blocks
-    const CBlockIndex* pindexFirst = pindexLast;
-    for (int i = 0; pindexFirst && i < blockstogoback; i++)
-        pindexFirst = pindexFirst->pprev;
-    assert(pindexFirst);
+    assert(pindexLast->nHeight >= blockstogoback);
+    const CRetargetCache& window = GetWindow(pindexLast, blockstogoback + 1);
 
     // Limit adjustment step
-    int64_t nActualTimespan = pindexLast->GetBlockTime() - pindexFirst->GetBlockTime();
-    LogPrintf("  nActualTimespan = %g before bounds\n", nActualTimespan);
+    int64_t nActualTimespan = pindexLast->GetBlockTime() - window.GetBlockTime(pindexLast->nHeight - blockstogoback);
 
     arith_uint256 bnNew;
     bnNew.SetCompact(pindexLast->nBits);
 
-    if (nActualTimespan < (retargetTimespan - (retargetTimespan/4)) ) nActualTimespan = (retargetTimespan - (retargetTimespan/4));
-    if (nActualTimespan > (retargetTimespan + (retargetTimespan/2)) ) nActualTimespan = (retargetTimespan + (retargetTimespan/2));
+    lastState.nWindow = blockstogoback + 1;
+    lastState.nActualTimespan = nActualTimespan;
+    lastState.nTargetTimespan = retargetTimespan;
+    nActualTimespan = lastState.Clamp(nActualTimespan, retargetTimespan - (retargetTimespan/4), retargetTimespan + (retargetTimespan/2));
 
     // Retarget
-    bnNew *= nActualTimespan;
-    bnNew /= retargetTimespan;
-
-    /// debug print
-    LogPrintf("DigiShield RETARGET \n");
-    LogPrintf("RetargetTimespan = %g    nActualTimespan = %g \n", retargetTimespan, nActualTimespan);
+    bnNew.MulDiv(nActualTimespan, retargetTimespan);
 
-    if (bnNew > bnProofOfWorkLimit)
-        bnNew = bnProofOfWorkLimit;
+    if (bnNew > bnPowLimit) {
+        bnNew = bnPowLimit;
+        lastState.nFlags |= RETARGET_POW_LIMIT;
+    }
 
     return bnNew.GetCompact();
 }
@@ -307,101 +394,70 @@ unsigned int static testcase4(const CBlockIndex* pindexLast, const CBlockHeader
 // #5 dualkgw3 retarget
 ///////////////////////////////////////////////////////////////////////////////////////////
 
-unsigned int static testcase5(const CBlockIndex* pindexLast, const CBlockHeader *pblock, const Consensus::Params& params)
+//DUAL_KGW3 SETUP
+static const unsigned int timeDaySeconds = 60 * 60 * 24;
+
+class CDualKGW3Retarget : public CKimotoGravityWell
+{
+public:
+    explicit CDualKGW3Retarget(const Consensus::Params& params)
+        : CKimotoGravityWell(params.nPowTargetSpacing,
+                             (uint64_t)(timeDaySeconds * 0.025) / params.nPowTargetSpacing,
+                             (uint64_t)(timeDaySeconds * 7) / params.nPowTargetSpacing,
+                             72) {} //28.2 and 144 possible
+
+    unsigned int GetNextWorkRequired(const CBlockIndex* pindexLast, const CBlockHeader *pblock, const Consensus::Params& params) override;
+
+    static std::unique_ptr<CRetarget> Create(const Consensus::Params& params) { return std::unique_ptr<CRetarget>(new CDualKGW3Retarget(params)); }
+};
+
+unsigned int CDualKGW3Retarget::GetNextWorkRequired(const CBlockIndex* pindexLast, const CBlockHeader *pblock, const Consensus::Params& params)
 {
     // current difficulty formula, ERC3 - DUAL_KGW3, written by Bitcoin Talk Limx Dev
-    const CBlockIndex *BlockLastSolved = pindexLast;
-    const CBlockIndex *BlockReading = pindexLast;
-    bool kgwdebug=false;
-    uint64_t PastBlocksMass = 0;
-    int64_t PastRateActualSeconds = 0;
-    int64_t PastRateTargetSeconds = 0;
-    double PastRateAdjustmentRatio = double(1);
-    arith_uint256 PastDifficultyAverage;
-    arith_uint256 PastDifficultyAveragePrev;
-    double EventHorizonDeviation;
-    double EventHorizonDeviationFast;
-    double EventHorizonDeviationSlow;
-    //DUAL_KGW3 SETUP
-    static const uint64_t Blocktime = params.nPowTargetSpacing;
-    static const unsigned int timeDaySeconds = 60 * 60 * 24;
-    uint64_t pastSecondsMin = timeDaySeconds * 0.025;
-    uint64_t pastSecondsMax = timeDaySeconds * 7;
-    uint64_t PastBlocksMin = pastSecondsMin / Blocktime;
-    uint64_t PastBlocksMax = pastSecondsMax / Blocktime;
+    const uint64_t Blocktime = params.nPowTargetSpacing;
 
     const arith_uint256 bnPowLimit = UintToArith256(params.powLimit);
+    lastState = CRetargetState();
 
-    if (BlockLastSolved == NULL || BlockLastSolved->nHeight == 0 || (uint64_t)BlockLastSolved->nHeight < PastBlocksMin) {  return bnPowLimit.GetCompact(); }
-
-    for (unsigned int i = 1; BlockReading && BlockReading->nHeight > 0; i++) {
-        if (PastBlocksMax > 0 && i > PastBlocksMax) { break; }
-        PastBlocksMass++;
-        PastDifficultyAverage.SetCompact(BlockReading->nBits);
-        if (i > 1) {
-            if(PastDifficultyAverage >= PastDifficultyAveragePrev)
-                PastDifficultyAverage = ((PastDifficultyAverage - PastDifficultyAveragePrev) / i) + PastDifficultyAveragePrev;
-            else
-                PastDifficultyAverage = PastDifficultyAveragePrev - ((PastDifficultyAveragePrev - PastDifficultyAverage) / i);
-        }
-        PastDifficultyAveragePrev = PastDifficultyAverage;
-        PastRateActualSeconds = BlockLastSolved->GetBlockTime() - BlockReading->GetBlockTime();
-        PastRateTargetSeconds = Blocktime * PastBlocksMass;
-        PastRateAdjustmentRatio = double(1);
-        if (PastRateActualSeconds < 0) { PastRateActualSeconds = 0; }
-        if (PastRateActualSeconds != 0 && PastRateTargetSeconds != 0) {
-            PastRateAdjustmentRatio = double(PastRateTargetSeconds) / double(PastRateActualSeconds);
-        }
-        EventHorizonDeviation = 1 + (0.7084 * pow((double(PastBlocksMass)/double(72)), -1.228));  //28.2 and 144 possible
-        EventHorizonDeviationFast = EventHorizonDeviation;
-        EventHorizonDeviationSlow = 1 / EventHorizonDeviation;
+    if (pindexLast == NULL || pindexLast->nHeight == 0 || (uint64_t)pindexLast->nHeight < PastBlocksMin) {  return bnPowLimit.GetCompact(); }
 
-        if (PastBlocksMass >= PastBlocksMin) {
-                if ((PastRateAdjustmentRatio <= EventHorizonDeviationSlow) || (PastRateAdjustmentRatio >= EventHorizonDeviationFast))
-                { assert(BlockReading); break; }
-        }
-        if (BlockReading->pprev == NULL) { assert(BlockReading); break; }
-        BlockReading = BlockReading->pprev;
-    }
+    KGWWindow window = Scan(pindexLast);
+    lastState.nWindow = window.PastBlocksMass;
 
     //KGW Original
-    arith_uint256 kgw_dual1(PastDifficultyAverage);
+    arith_uint256 kgw_dual1(window.PastDifficultyAverage);
     arith_uint256 kgw_dual2;
     kgw_dual2.SetCompact(pindexLast->nBits);
-    if (PastRateActualSeconds != 0 && PastRateTargetSeconds != 0) {
-         kgw_dual1 *= PastRateActualSeconds;
-         kgw_dual1 /= PastRateTargetSeconds;
+    if (window.PastRateActualSeconds != 0 && window.PastRateTargetSeconds != 0) {
+         kgw_dual1.MulDiv(window.PastRateActualSeconds, window.PastRateTargetSeconds);
     }
 
     int64_t nActualTime1 = pindexLast->GetBlockTime() - pindexLast->pprev->GetBlockTime();
     int64_t nActualTimespanshort = nActualTime1;
+    lastState.nActualTimespan = nActualTime1;
+    lastState.nTargetTimespan = Blocktime;
 
     // Retarget BTC Original ...not exactly
     // Small Fix
 
     if(nActualTime1 < 0) nActualTime1 = Blocktime;
 
-    if (nActualTime1 < Blocktime / 3)
-        nActualTime1 = Blocktime / 3;
-    if (nActualTime1 > Blocktime * 3)
-        nActualTime1 = Blocktime * 3;
+    nActualTime1 = lastState.Clamp(nActualTime1, Blocktime / 3, Blocktime * 3);
 
-    kgw_dual2 *= nActualTime1;
-    kgw_dual2 /= Blocktime;
+    kgw_dual2.MulDiv(nActualTime1, Blocktime);
 
     //Fusion from Retarget and Classic KGW3 (BitSend=)
 
     arith_uint256 bnNew;
-    bnNew = ((kgw_dual2 + kgw_dual1)/2);
+    bnNew = ((kgw_dual2 + kgw_dual1) >> 1);
     // DUAL KGW3 increased rapidly the Diff if Blocktime to last block under Blocktime/6 sec.
+    // NOTE: the comparison is unsigned, so a negative solve time does not count as fast.
 
-    if(kgwdebug)LogPrintf("nActualTimespanshort = %d \n", nActualTimespanshort );
     if( nActualTimespanshort < Blocktime/6 )
         {
-        if(kgwdebug)LogPrintf("Vordiff:%08x %s bnNew first  \n", bnNew.GetCompact(), bnNew.ToString().c_str());
         const int nLongShortNew1   = 85; const int nLongShortNew2   = 100;
-        bnNew = bnNew * nLongShortNew1;    bnNew = bnNew / nLongShortNew2;
-        if(kgwdebug)LogPrintf("Erhöhte Diff:\n %08x %s bnNew second \n", bnNew.GetCompact(), bnNew.ToString().c_str() );
+        bnNew.MulDiv(nLongShortNew1, nLongShortNew2);
+        lastState.nFlags |= RETARGET_RULE_FAST;
         }
 
 
@@ -409,21 +465,16 @@ unsigned int static testcase5(const CBlockIndex* pindexLast, const CBlockHeader
     // Reduce difficulty if current block generation time has already exceeded maximum time limit.
     // Diffbreak 12 Hours
     const int nLongTimeLimit   = 12 * 60 * 60;
-    if(kgwdebug)
-    {
-    LogPrintf("Prediff %08x %s\n", bnNew.GetCompact(), bnNew.ToString().c_str());
-    LogPrintf("Vordiff %d \n", nLongTimeLimit);
-    LogPrintf(" %d Block", BlockReading->nHeight );
-    }
 
     if ((pblock-> nTime - pindexLast->GetBlockTime()) > nLongTimeLimit)  //block.nTime
     {
         bnNew = bnPowLimit;
-           if(kgwdebug)LogPrintf("<BSD> Maximum block time hit - cute diff %08x %s\n", bnNew.GetCompact(), bnNew.ToString().c_str());
+        lastState.nFlags |= RETARGET_RULE_SLOW;
     }
 
     if (bnNew > bnPowLimit) {
         bnNew = bnPowLimit;
+        lastState.nFlags |= RETARGET_POW_LIMIT;
     }
     return bnNew.GetCompact();
 }
@@ -432,7 +483,15 @@ unsigned int static testcase5(const CBlockIndex* pindexLast, const CBlockHeader
 // #6 orbitcoin super shield retarget
 ///////////////////////////////////////////////////////////////////////////////////////////
 
-unsigned int static testcase6(const CBlockIndex* pindexLast, const Consensus::Params& params)
+class COrbitcoinSuperShieldRetarget : public CWindowRetarget
+{
+public:
+    unsigned int GetNextWorkRequired(const CBlockIndex* pindexLast, const CBlockHeader *pblock, const Consensus::Params& params) override;
+
+    static std::unique_ptr<CRetarget> Create(const Consensus::Params& params) { return std::unique_ptr<CRetarget>(new COrbitcoinSuperShieldRetarget()); }
+};
+
+unsigned int COrbitcoinSuperShieldRetarget::GetNextWorkRequired(const CBlockIndex* pindexLast, const CBlockHeader *pblock, const Consensus::Params& params)
 {
     /* Orbitcoin Super Shield (OSS);
      * retargets every block using two averaging windows of 5 and 20 blocks,
@@ -446,19 +505,22 @@ unsigned int static testcase6(const CBlockIndex* pindexLast, const Consensus::Pa
 
     nTargetSpacing = params.nPowTargetSpacing;
     nTargetTimespan = nTargetSpacing * nIntervalLong;
+    lastState = CRetargetState();
+
+    const CRetargetCache& window = GetWindow(pindexLast, nIntervalLong - nIntervalShort + 2);
 
     /* The short averaging window */
-    const CBlockIndex* pindexShort = pindexLast;
-    for(int i = 0; pindexShort && (i < nIntervalShort); i++) {
-      pindexShort = pindexLast->pprev;
-    }
-    nActualTimespanShort = (int64_t)pindexLast->pprev->nTime - (int64_t)pindexShort->nTime;
+    /* NOTE: the walk this replaces stepped to pindexLast->pprev every time
+     * round, so the short window starts (and ends) at the previous block */
+    int nHeightShort = pindexLast->nHeight - 1;
+    nActualTimespanShort = window.GetBlockTime(pindexLast->nHeight - 1) - window.GetBlockTime(nHeightShort);
 
     /* The long averaging window */
-    const CBlockIndex* pindexLong = pindexShort;
-    for(int i = 0; pindexLong && (i < (nIntervalLong - nIntervalShort)); i++)
-      pindexLong = pindexLong->pprev;
-    nActualTimespanLong = (int64_t)pindexLast->nTime - (int64_t)pindexLong->nTime;
+    int nHeightLong = nHeightShort - (nIntervalLong - nIntervalShort);
+    nActualTimespanLong = (int64_t)pindexLast->nTime - window.GetBlockTime(nHeightLong);
+    lastState.nWindow = nIntervalLong - nIntervalShort + 2;
+    lastState.nActualTimespan = nActualTimespanLong;
+    lastState.nTargetTimespan = nTargetTimespan;
 
     /* Time warp protection */
     {
@@ -481,22 +543,295 @@ unsigned int static testcase6(const CBlockIndex* pindexLast, const Consensus::Pa
             nActualTimespanMin = nTargetTimespan * 100 / 105;
             nActualTimespanMax = nTargetTimespan * 110 / 100;
     }
-    if(nActualTimespan < nActualTimespanMin) nActualTimespan = nActualTimespanMin;
-    if(nActualTimespan > nActualTimespanMax) nActualTimespan = nActualTimespanMax;
+    nActualTimespan = lastState.Clamp(nActualTimespan, nActualTimespanMin, nActualTimespanMax);
 
     /* Retarget */
     arith_uint256 bnNew;
     bnNew.SetCompact(pindexLast->nBits);
-    bnNew *= nActualTimespan;
-    bnNew /= nTargetTimespan;
+    bnNew.MulDiv(nActualTimespan, nTargetTimespan);
+
+    if(bnNew > bnPowLimit) {
+        bnNew = bnPowLimit;
+        lastState.nFlags |= RETARGET_POW_LIMIT;
+    }
+
+    return bnNew.GetCompact();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////
+// #7 linearly weighted moving average retarget
+///////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Zawy's LWMA: the average target of the last N blocks, scaled by their solve
+ * times weighted linearly by age, so that the newest counts N times as much
+ * as the oldest:
+ *
+ *   next = avg(target) * sum(i * st_i) / (T * N * (N+1) / 2)
+ *
+ * Solve times are bounded to [-6T, 6T]. Negative ones are kept, so that a
+ * block stamped ahead of time is undone by the next honest one.
+ *
+ * Both sums are kept in the instance and moved along with the tip: when the
+ * window slides by one block every weight drops by one, which takes off the
+ * plain sum, and the new solve time comes in at weight N. Calls for any other
+ * block rebuild them from the window. Until the chain is N blocks high the
+ * window is all of it.
+ */
+class CLWMARetarget : public CWindowRetarget
+{
+private:
+    const int64_t N;
+    //! Block whose window the sums below are over
+    const CBlockIndex* pindexState;
+    int64_t nSolveTimeSum;
+    int64_t nWeightedSum;
+
+    static int64_t GetSolveTime(const CRetargetCache& window, int nHeight, int64_t T)
+    {
+        return std::max(-6 * T, std::min(6 * T, window.GetBlockTime(nHeight) - window.GetBlockTime(nHeight - 1)));
+    }
+
+public:
+    explicit CLWMARetarget(const Consensus::Params& params) : N(params.nLWMAWindow), pindexState(NULL), nSolveTimeSum(0), nWeightedSum(0) {}
+
+    unsigned int GetNextWorkRequired(const CBlockIndex* pindexLast, const CBlockHeader *pblock, const Consensus::Params& params) override;
+
+    static std::unique_ptr<CRetarget> Create(const Consensus::Params& params) { return std::unique_ptr<CRetarget>(new CLWMARetarget(params)); }
+};
+
+unsigned int CLWMARetarget::GetNextWorkRequired(const CBlockIndex* pindexLast, const CBlockHeader *pblock, const Consensus::Params& params)
+{
+    const arith_uint256 bnPowLimit = UintToArith256(params.powLimit);
+    const int64_t T = params.nPowTargetSpacing;
+    const int nLastHeight = pindexLast->nHeight;
+    const int64_t nBlocks = std::min<int64_t>(N, nLastHeight);
+    lastState = CRetargetState();
+
+    // One block more than the window, for the solve time that leaves it
+    const CRetargetCache& window = GetWindow(pindexLast, nBlocks + 2);
+    if (pindexLast != pindexState) {
+        if (pindexState && pindexLast->pprev == pindexState) {
+            int64_t nSolveTime = GetSolveTime(window, nLastHeight, T);
+            if (nBlocks == std::min<int64_t>(N, nLastHeight - 1)) {
+                nWeightedSum += N * nSolveTime - nSolveTimeSum;
+                nSolveTimeSum += nSolveTime - GetSolveTime(window, nLastHeight - N, T);
+            } else {
+                nWeightedSum += nBlocks * nSolveTime;
+                nSolveTimeSum += nSolveTime;
+            }
+        } else {
+            nSolveTimeSum = nWeightedSum = 0;
+            for (int64_t i = 1; i <= nBlocks; i++) {
+                int64_t nSolveTime = GetSolveTime(window, nLastHeight - nBlocks + i, T);
+                nSolveTimeSum += nSolveTime;
+                nWeightedSum += i * nSolveTime;
+            }
+        }
+        pindexState = pindexLast;
+    }
+
+    const int64_t k = nBlocks * (nBlocks + 1) / 2 * T;
+    lastState.nWindow = nBlocks + 1;
+    lastState.nActualTimespan = pindexLast->GetBlockTime() - window.GetBlockTime(nLastHeight - nBlocks);
+    lastState.nTargetTimespan = nBlocks * T;
+
+    // Solve times that are negative on balance must not make the target zero or negative
+    int64_t nWeighted = nWeightedSum;
+    if (nWeighted < k / 10) {
+        nWeighted = k / 10;
+        lastState.nFlags |= RETARGET_CLAMP_LOW;
+    }
+
+    arith_uint256 bnNew = window.GetTargetSum(nLastHeight - nBlocks + 1, nLastHeight);
+    bnNew.MulDiv(nWeighted, nBlocks * k);
+
+    if (bnNew > bnPowLimit) {
+        bnNew = bnPowLimit;
+        lastState.nFlags |= RETARGET_POW_LIMIT;
+    }
+
+    return bnNew.GetCompact();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////
+// #8 aserti3-2d retarget
+///////////////////////////////////////////////////////////////////////////////////////////
+
+/** Last block GetNextWorkRequired below sets to powLimit whatever the algorithm; asert's anchor */
+static const int ASERT_ANCHOR_HEIGHT = 99;
+
+/**
+ * Absolutely scheduled exponentially rising targets, as Bitcoin Cash's
+ * aserti3-2d: the target of a fixed anchor block, doubled for every half-life
+ * the chain has fallen behind the ideal schedule since then, and halved for
+ * every half-life it has got ahead:
+ *
+ *   next = anchor * 2^((t - t_anchorparent - T * (h - h_anchor + 1)) / halflife)
+ *
+ * The exponent is in 16.16 fixed point, and 2^x for its fraction comes from
+ * the reference cubic, so every node gets the same bits. Only the anchor and
+ * the tip are looked at; the anchor is found once, and kept for as long as
+ * calls move along one chain.
+ */
+class CASERTRetarget : public CRetarget
+{
+private:
+    const int64_t nHalfLife;
+    //! Block asked about last, and the anchor below it
+    const CBlockIndex* pindexState;
+    const CBlockIndex* pindexAnchor;
+
+public:
+    explicit CASERTRetarget(const Consensus::Params& params) : nHalfLife(params.nASERTHalfLife), pindexState(NULL), pindexAnchor(NULL) {}
+
+    unsigned int GetNextWorkRequired(const CBlockIndex* pindexLast, const CBlockHeader *pblock, const Consensus::Params& params) override;
+
+    static std::unique_ptr<CRetarget> Create(const Consensus::Params& params) { return std::unique_ptr<CRetarget>(new CASERTRetarget(params)); }
+};
+
+unsigned int CASERTRetarget::GetNextWorkRequired(const CBlockIndex* pindexLast, const CBlockHeader *pblock, const Consensus::Params& params)
+{
+    const arith_uint256 bnPowLimit = UintToArith256(params.powLimit);
+    const int64_t T = params.nPowTargetSpacing;
+    lastState = CRetargetState();
+
+    if (pindexLast->nHeight < ASERT_ANCHOR_HEIGHT)
+        return bnPowLimit.GetCompact();
+    if (!pindexAnchor || (pindexLast != pindexState && pindexLast->pprev != pindexState))
+        pindexAnchor = pindexLast->GetAncestor(ASERT_ANCHOR_HEIGHT);
+    pindexState = pindexLast;
+
+    const int64_t nTimeDelta = pindexLast->GetBlockTime() - pindexAnchor->pprev->GetBlockTime();
+    const int64_t nHeightDelta = pindexLast->nHeight - pindexAnchor->nHeight;
+    lastState.nWindow = nHeightDelta + 2;
+    lastState.nActualTimespan = nTimeDelta;
+    lastState.nTargetTimespan = T * (nHeightDelta + 1);
+
+    // The division truncates towards zero and the shift rounds down, as in the reference
+    const int64_t nExponent = ((nTimeDelta - T * (nHeightDelta + 1)) * 65536) / nHalfLife;
+    const int64_t nShifts = nExponent >> 16;
+    const uint64_t nFrac = (uint16_t)nExponent;
+    const uint32_t nFactor = 65536 + ((195766423245049ull * nFrac + 971821376ull * nFrac * nFrac + 5127ull * nFrac * nFrac * nFrac + (1ull << 47)) >> 48);
+
+    // anchor * nFactor * 2^(nShifts - 16), exactly. Targets here reach 2^240,
+    // so the product cannot be formed first and shifted after, as the
+    // reference does: the division by what is left of 2^16 goes into MulDiv.
+    arith_uint256 bnNew;
+    bnNew.SetCompact(pindexAnchor->nBits);
+    bool fOverflow;
+    if (nShifts >= 16) {
+        fOverflow = !bnNew.MulDiv(nFactor, 1) || (int64_t)bnNew.bits() + nShifts - 16 > 256;
+        if (!fOverflow)
+            bnNew <<= nShifts - 16;
+    } else if (nShifts >= 0) {
+        fOverflow = !bnNew.MulDiv(nFactor, 1 << (16 - nShifts));
+    } else {
+        fOverflow = !bnNew.MulDiv(nFactor, 65536);
+        if (nShifts > -256)
+            bnNew >>= -nShifts;
+        else
+            bnNew = 0;
+    }
+
+    if (fOverflow || bnNew > bnPowLimit) {
+        bnNew = bnPowLimit;
+        lastState.nFlags |= RETARGET_POW_LIMIT;
+    }
+    if (bnNew == 0)
+        bnNew = 1;
+
+    return bnNew.GetCompact();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////
+// #9 exponential moving average retarget
+///////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Simple EMA: each block moves the previous target 1/N of the way towards
+ * what the last solve time says it should have been,
+ *
+ *   next = prev * (1 + (st/T - 1) / N) = prev * (N*T + st - T) / (N*T)
+ *
+ * a ratio of integers, applied with one MulDiv. The previous target carries
+ * all the history there is, so only two blocks are looked at. The solve time
+ * is bounded to [-6T, 6T], which keeps the ratio positive for N above 7, and,
+ * as in LWMA, negative ones are kept to undo forward-dated blocks.
+ */
+class CEMARetarget : public CRetarget
+{
+private:
+    const int64_t N;
+
+public:
+    explicit CEMARetarget(const Consensus::Params& params) : N(params.nEMAWindow) {}
+
+    unsigned int GetNextWorkRequired(const CBlockIndex* pindexLast, const CBlockHeader *pblock, const Consensus::Params& params) override;
+
+    static std::unique_ptr<CRetarget> Create(const Consensus::Params& params) { return std::unique_ptr<CRetarget>(new CEMARetarget(params)); }
+};
+
+unsigned int CEMARetarget::GetNextWorkRequired(const CBlockIndex* pindexLast, const CBlockHeader *pblock, const Consensus::Params& params)
+{
+    const arith_uint256 bnPowLimit = UintToArith256(params.powLimit);
+    const int64_t T = params.nPowTargetSpacing;
+    lastState = CRetargetState();
+
+    if (pindexLast->pprev == NULL)
+        return bnPowLimit.GetCompact();
+
+    lastState.nWindow = 2;
+    lastState.nActualTimespan = pindexLast->GetBlockTime() - pindexLast->pprev->GetBlockTime();
+    lastState.nTargetTimespan = T;
+    int64_t nSolveTime = lastState.Clamp(lastState.nActualTimespan, -6 * T, 6 * T);
+
+    arith_uint256 bnNew;
+    bnNew.SetCompact(pindexLast->nBits);
+    bnNew.MulDiv(N * T + nSolveTime - T, N * T);
 
-    if(bnNew > bnPowLimit) bnNew = bnPowLimit;
+    if (bnNew > bnPowLimit) {
+        bnNew = bnPowLimit;
+        lastState.nFlags |= RETARGET_POW_LIMIT;
+    }
 
     return bnNew.GetCompact();
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////
 
+static const CRetargetAlgorithm retargetAlgorithms[] =
+{ //  id  name          description                                  factory
+  //  --  ------------  -------------------------------------------  ------------------------------
+    { 1, "bitcoin",     "standard bitcoin/litecoin retarget",        &CBitcoinRetarget::Create },
+    { 2, "dgw3",        "darkgravitywave v3 retarget",               &CDarkGravityWaveRetarget::Create },
+    { 3, "kgw",         "kimotogravitywell retarget",                &CKGWRetarget::Create },
+    { 4, "digishield",  "digishield retarget",                       &CDigiShieldRetarget::Create },
+    { 5, "dualkgw3",    "dualkgw3 retarget",                         &CDualKGW3Retarget::Create },
+    { 6, "oss",         "orbitcoin super shield retarget",           &COrbitcoinSuperShieldRetarget::Create },
+    { 7, "lwma",        "linearly weighted moving average retarget", &CLWMARetarget::Create },
+    { 8, "asert",       "aserti3-2d exponential retarget",           &CASERTRetarget::Create },
+    { 9, "ema",         "exponential moving average retarget",       &CEMARetarget::Create },
+};
+
+static const CRetargetParam retargetParams[] =
+{ //  name              algorithm  description                                                      value                               min  max
+  //  ----------------  ---------  ---------------------------------------------------------------  ----------------------------------  ---  -------------
+    { "lwmawindow",     "lwma",    "Number of blocks the lwma retarget averages over",              &Consensus::Params::nLWMAWindow,    2,   10000 },
+    { "aserthalflife",  "asert",   "Seconds of schedule drift that double or halve asert's target", &Consensus::Params::nASERTHalfLife, 60,  365 * 86400 },
+    { "emawindow",      "ema",     "Number of blocks the ema retarget smooths over",                &Consensus::Params::nEMAWindow,     8,   100000 },
+};
+
+void RegisterPowRetargets(CRetargetTable& table)
+{
+    for (unsigned int vcidx = 0; vcidx < ARRAYLEN(retargetAlgorithms); vcidx++)
+        table.appendAlgorithm(&retargetAlgorithms[vcidx]);
+    for (unsigned int vcidx = 0; vcidx < ARRAYLEN(retargetParams); vcidx++)
+        table.appendParam(&retargetParams[vcidx]);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////
+
 double GetDifficulty(unsigned int nBits)
 {
     int nShift = (nBits >> 24) & 0xff;
@@ -512,47 +847,28 @@ double GetDifficulty(unsigned int nBits)
     return dDiff;
 }
 
-unsigned int GetNextWorkRequired(const CBlockIndex* pindexLast, const CBlockHeader *pblock, const Consensus::Params& params)
+double GetBlockWork(unsigned int nBits)
 {
-    int nHeight = pindexLast->nHeight+1;
-    int retargetRoutine = GetArg("-retarget", 1);
-    unsigned int nProofOfWorkLimit = UintToArith256(params.powLimit).GetCompact();
-
-    if (nHeight < 100)
-       return nProofOfWorkLimit;
-
-    switch (retargetRoutine) {
-
-       case 1 :  if(!haveAnnounced) LogPrintf("* Using standard bitcoin/litecoin retarget algorithm..\n"); haveAnnounced = true;
-                 nProofOfWorkLimit = testcase1(pindexLast, pblock, params);
-                 LogPrintf("* next block difficulty is %0.4f (%08x)\n", GetDifficulty(nProofOfWorkLimit), nProofOfWorkLimit);
-                 return nProofOfWorkLimit;
-
-       case 2 :  if(!haveAnnounced) LogPrintf("* Using darkgravitywave v3 retarget algorithm..\n"); haveAnnounced = true;
-                 nProofOfWorkLimit = testcase2(pindexLast, pblock, params);
-                 LogPrintf("* next block difficulty is %0.4f (%08x)\n", GetDifficulty(nProofOfWorkLimit), nProofOfWorkLimit);
-                 return nProofOfWorkLimit;
-
-       case 3 :  if(!haveAnnounced) LogPrintf("* Using kimotogravitywell retarget algorithm..\n"); haveAnnounced = true;
-                 nProofOfWorkLimit = testcase3(pindexLast, params);
-                 LogPrintf("* next block difficulty is %0.4f (%08x)\n", GetDifficulty(nProofOfWorkLimit), nProofOfWorkLimit);
-                 return nProofOfWorkLimit;
-
-       case 4 :  if(!haveAnnounced) LogPrintf("* Using digishield retarget algorithm..\n"); haveAnnounced = true;
-                 nProofOfWorkLimit = testcase4(pindexLast, pblock, params);
-                 LogPrintf("* next block difficulty is %0.4f (%08x)\n", GetDifficulty(nProofOfWorkLimit), nProofOfWorkLimit);
-                 return nProofOfWorkLimit;
-
-       case 5 :  if(!haveAnnounced) LogPrintf("* Using dualkgw3 retarget algorithm..\n"); haveAnnounced = true;
-                 nProofOfWorkLimit = testcase5(pindexLast, pblock, params);
-                 LogPrintf("* next block difficulty is %0.4f (%08x)\n", GetDifficulty(nProofOfWorkLimit), nProofOfWorkLimit);
-                 return nProofOfWorkLimit;
+    arith_uint256 bnTarget;
+    bool fNegative;
+    bool fOverflow;
+    bnTarget.SetCompact(nBits, &fNegative, &fOverflow);
+    if (fNegative || fOverflow || bnTarget == 0)
+        return 0;
+    // Same quantity as GetBlockProof (2**256 / (bnTarget+1)), but in floating
+    // point: the exact 256-bit division is not worth it for a sampling rate.
+    return ldexp(1.0, 256) / (bnTarget.getdouble() + 1.0);
+}
 
-       case 6 :  if(!haveAnnounced) LogPrintf("* Using orbitcoin retarget algorithm..\n"); haveAnnounced = true;
-                 nProofOfWorkLimit = testcase6(pindexLast, params);
-                 LogPrintf("* next block difficulty is %0.4f (%08x)\n", GetDifficulty(nProofOfWorkLimit), nProofOfWorkLimit);
-                 return nProofOfWorkLimit;
+unsigned int GetNextWorkRequired(const CBlockIndex* pindexLast, const CBlockHeader *pblock, const Consensus::Params& params)
+{
+    if (pindexLast->nHeight+1 < 100) {
+        if (params.retarget)
+            params.retarget->ClearLastState();
+        return UintToArith256(params.powLimit).GetCompact();
     }
+
+    return params.retarget->GetNextWorkRequired(pindexLast, pblock, params);
 }
 
 bool CheckProofOfWork(uint256 hash, unsigned int nBits, const Consensus::Params& params)
@@ -14,8 +14,64 @@ class CBlockHeader;
 class CBlockIndex;
 class uint256;
 
+/** Flags of CRetargetState */
+enum
+{
+    //! The observed timespan was raised to the algorithm's lower bound
+    RETARGET_CLAMP_LOW = (1 << 0),
+    //! The observed timespan was cut to the algorithm's upper bound
+    RETARGET_CLAMP_HIGH = (1 << 1),
+    //! The new target was capped at powLimit
+    RETARGET_POW_LIMIT = (1 << 2),
+    //! A special rule for fast blocks raised the difficulty
+    RETARGET_RULE_FAST = (1 << 3),
+    //! A special rule for slow blocks (e.g. testnet's min-difficulty rule) lowered it
+    RETARGET_RULE_SLOW = (1 << 4),
+};
+
+/**
+ * What one GetNextWorkRequired call looked at and did, beyond its result:
+ * the raw material for retarget telemetry. A call that keeps the previous
+ * target, or never gets to look at a window, leaves nWindow at 0. The node
+ * keeps the state of the call that checked each header in its CBlockIndex.
+ */
+struct CRetargetState
+{
+    //! Observed timespan of the window, before any clamping
+    int64_t nActualTimespan;
+    //! Timespan the window should have taken
+    int64_t nTargetTimespan;
+    //! Blocks the algorithm looked back over
+    uint32_t nWindow;
+    //! RETARGET_* flags
+    uint8_t nFlags;
+
+    CRetargetState() : nActualTimespan(0), nTargetTimespan(0), nWindow(0), nFlags(0) {}
+
+    /** Clamp nTimespan to [nMin, nMax], flagging which bound was hit. */
+    int64_t Clamp(int64_t nTimespan, int64_t nMin, int64_t nMax)
+    {
+        if (nTimespan < nMin) {
+            nFlags |= RETARGET_CLAMP_LOW;
+            return nMin;
+        }
+        if (nTimespan > nMax) {
+            nFlags |= RETARGET_CLAMP_HIGH;
+            return nMax;
+        }
+        return nTimespan;
+    }
+};
+
+/** Compact target the block after pindexLast must meet, from the retarget algorithm bound to the params */
 unsigned int GetNextWorkRequired(const CBlockIndex* pindexLast, const CBlockHeader *pblock, const Consensus::Params&);
-unsigned int testcase1_ext(const CBlockIndex* pindexLast, int64_t nFirstBlockTime, const Consensus::Params&);
+unsigned int testcase1_ext(const CBlockIndex* pindexLast, int64_t nFirstBlockTime, const Consensus::Params&, CRetargetState* pstate = NULL);
+
+/** Floating point multiple of the minimum difficulty represented by a compact target */
+double GetDifficulty(unsigned int nBits);
+
+/** Expected number of hashes needed to find a block at nBits, as a double. */
+double GetBlockWork(unsigned int nBits);
 
 /** Check whether a block hash satisfies the proof-of-work requirement specified by nBits */
 bool CheckProofOfWork(uint256 hash, unsigned int nBits, const Consensus::Params&);
@@ -0,0 +1,123 @@
+// Copyright (c) 2017 The Litebench developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "powminer.h"
+
+#include "crypto/common.h"
+#include "crypto/scrypt.h"
+#include "primitives/block.h"
+#include "streams.h"
+#include "uint256.h"
+#include "util.h"
+#include "utiltime.h"
+#include "version.h"
+
+#include <algorithm>
+#include <atomic>
+#include <stdio.h>
+
+#include <boost/thread.hpp>
+
+CMiningTarget::CMiningTarget(const arith_uint256& bnTargetIn) : bnTarget(bnTargetIn)
+{
+    nTargetHigh = (bnTarget >> 192).GetLow64();
+}
+
+bool CMiningTarget::SetCompact(uint32_t nBits, const uint256& powLimit)
+{
+    bool fNegative, fOverflow;
+    arith_uint256 bnNew;
+    bnNew.SetCompact(nBits, &fNegative, &fOverflow);
+    if (fNegative || fOverflow || bnNew == 0 || bnNew > UintToArith256(powLimit))
+        return false;
+    *this = CMiningTarget(bnNew);
+    return true;
+}
+
+bool CMiningTarget::Check(const uint256& hash) const
+{
+    // uint256 is little-endian: the top 64 bits are its last eight bytes.
+    uint64_t nHashHigh = ReadLE64(hash.begin() + 24);
+    if (nHashHigh != nTargetHigh)
+        return nHashHigh < nTargetHigh;
+    return UintToArith256(hash) <= bnTarget;
+}
+
+int CMiningTarget::FindFirst(const uint256* phashes, int nHashes) const
+{
+    for (int i = 0; i < nHashes; i++) {
+        if (Check(phashes[i]))
+            return i;
+    }
+    return -1;
+}
+
+/**
+ * Hash the nonces below nEnd in runs of scrypt_multi_ways(), starting at
+ * nFirst and skipping nStride runs between them, stopping at the first
+ * solution or once past the lowest solution found so far by any worker.
+ */
+static void SearchNonces(const unsigned char* pheader, const CMiningTarget& target, uint64_t nFirst, uint64_t nEnd, int nStride,
+                         char* scratchpad, std::atomic<uint64_t>& nFound, uint64_t& nHashes, bool fReport)
+{
+    const int nWays = scrypt_multi_ways();
+    uint256 hashes[SCRYPT_MAX_WAYS];
+    int64_t nLastReport = GetTimeMillis();
+
+    nHashes = 0;
+    for (uint64_t n = nFirst; n < nEnd && n < nFound.load(std::memory_order_relaxed); n += (uint64_t)nStride * nWays) {
+        scrypt_1024_1_1_256_multi((const char*)pheader, (uint32_t)n, (char*)hashes, scratchpad);
+        int nLanes = (int)std::min<uint64_t>(nWays, nEnd - n);
+        int nHit = target.FindFirst(hashes, nLanes);
+        if (nHit >= 0) {
+            nHashes += nHit + 1;
+            uint64_t nPrev = nFound.load();
+            while (n + nHit < nPrev && !nFound.compare_exchange_weak(nPrev, n + nHit)) {}
+            return;
+        }
+        nHashes += nLanes;
+        if (fReport && GetTimeMillis() - nLastReport >= 250) {
+            printf("\rnonce %08x", (uint32_t)n);
+            fflush(stdout);
+            nLastReport = GetTimeMillis();
+        }
+    }
+}
+
+CPowMiner::CPowMiner(int nThreadsIn)
+{
+    nThreads = nThreadsIn > 0 ? nThreadsIn : std::max(GetNumCores(), 1);
+    vScratchpad.resize(nThreads, std::vector<char>(SCRYPT_MULTI_SCRATCHPAD_SIZE));
+}
+
+bool CPowMiner::Search(CBlockHeader& header, const CMiningTarget& target, uint32_t nFirst, uint64_t nCount, uint64_t& nHashesRet, bool fReport)
+{
+    LOCK(cs);
+
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << header;
+    assert(ss.size() == 80);
+    const unsigned char* pheader = (const unsigned char*)&ss[0];
+
+    const uint64_t nEnd = std::min<uint64_t>((uint64_t)nFirst + nCount, 1ULL << 32);
+    std::atomic<uint64_t> nFound(nEnd);
+    std::vector<uint64_t> vHashes(nThreads);
+    if (nThreads == 1) {
+        SearchNonces(pheader, target, nFirst, nEnd, 1, vScratchpad[0].data(), nFound, vHashes[0], fReport);
+    } else {
+        boost::thread_group threads;
+        for (int i = 0; i < nThreads; i++)
+            threads.create_thread(boost::bind(&SearchNonces, pheader, boost::cref(target), (uint64_t)nFirst + i * scrypt_multi_ways(), nEnd, nThreads,
+                                              vScratchpad[i].data(), boost::ref(nFound), boost::ref(vHashes[i]), fReport && i == 0));
+        threads.join_all();
+    }
+
+    nHashesRet = 0;
+    for (uint64_t nHashes : vHashes)
+        nHashesRet += nHashes;
+    if (nFound.load() >= nEnd)
+        return false;
+    header.nNonce = nFound.load();
+    return true;
+}
@@ -0,0 +1,84 @@
+// Copyright (c) 2017 The Litebench developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_POWMINER_H
+#define BITCOIN_POWMINER_H
+
+#include "arith_uint256.h"
+#include "sync.h"
+
+#include <stdint.h>
+#include <vector>
+
+class CBlockHeader;
+class uint256;
+
+/** Default for -minerthreads: 0 means one thread per core */
+static const int DEFAULT_MINER_THREADS = 0;
+
+/**
+ * A proof-of-work target decoded once, for testing many hashes against.
+ * A hash's most significant 64 bits decide all but a 2**-64 sliver of cases;
+ * only a tie falls back to the full 256-bit compare.
+ */
+class CMiningTarget
+{
+private:
+    arith_uint256 bnTarget;
+    //! The most significant 64 bits of bnTarget
+    uint64_t nTargetHigh;
+
+public:
+    CMiningTarget() : nTargetHigh(0) {}
+    explicit CMiningTarget(const arith_uint256& bnTargetIn);
+
+    /**
+     * Decode nBits, rejecting the same out-of-range values CheckProofOfWork
+     * does (negative, zero, overflowing or easier than powLimit).
+     */
+    bool SetCompact(uint32_t nBits, const uint256& powLimit);
+
+    const arith_uint256& GetTarget() const { return bnTarget; }
+
+    /** Whether hash meets the target, i.e. is at most it. */
+    bool Check(const uint256& hash) const;
+
+    /** Index of the first of nHashes consecutive hashes that meets the target, or -1. */
+    int FindFirst(const uint256* phashes, int nHashes) const;
+};
+
+/**
+ * Multi-threaded scrypt nonce search over a block header. The header is
+ * serialized once; each worker hashes runs of consecutive nonces with the
+ * multi-lane scrypt kernel (see scrypt_multi_ways), in its own scratchpad,
+ * which the miner keeps across searches.
+ *
+ * Workers take interleaved runs and stop as soon as they pass the lowest
+ * solution any of them has found, so a search returns the same nonce a
+ * sequential scan would, however many threads it ran on.
+ */
+class CPowMiner
+{
+private:
+    CCriticalSection cs;
+    int nThreads;
+    //! One scrypt scratchpad per worker, guarded by cs
+    std::vector<std::vector<char> > vScratchpad;
+
+public:
+    /** nThreadsIn <= 0 means one thread per core. */
+    explicit CPowMiner(int nThreadsIn);
+
+    int GetThreads() const { return nThreads; }
+
+    /**
+     * Look for the lowest nonce in [nFirst, nFirst + nCount) for which the
+     * scrypt hash of header meets target, and store it in header.nNonce.
+     * nHashesRet is set to the number of hashes computed across all threads.
+     * With fReport, progress is printed to stdout a few times a second.
+     */
+    bool Search(CBlockHeader& header, const CMiningTarget& target, uint32_t nFirst, uint64_t nCount, uint64_t& nHashesRet, bool fReport = false);
+};
+
+#endif // BITCOIN_POWMINER_H
@@ -195,3 +195,25 @@ FastRandomContext::FastRandomContext(bool fDeterministic)
     }
 }
 
+
+uint64_t MixSeed(uint64_t n)
+{
+    n += 0x9e3779b97f4a7c15ULL;
+    n = (n ^ (n >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    n = (n ^ (n >> 27)) * 0x94d049bb133111ebULL;
+    return n ^ (n >> 31);
+}
+
+void FastRandomContext::Seed(uint64_t nSeed)
+{
+    // Spread every seed bit over both halves first, so that nearby seeds give
+    // unrelated sequences.
+    nSeed = MixSeed(nSeed);
+    // Neither half may be zero, or sit on the fixed points avoided above.
+    Rz = (uint32_t)nSeed;
+    if (Rz == 0 || Rz == 0x9068ffffU)
+        Rz = 11;
+    Rw = (uint32_t)(nSeed >> 32);
+    if (Rw == 0 || Rw == 0x464fffffU)
+        Rw = 11;
+}
@@ -27,6 +27,9 @@ uint256 GetRandHash();
  */
 void GetStrongRandBytes(unsigned char* buf, int num);
 
+/** SplitMix64 finalizer: spreads every bit of n over the result, so nearby inputs give unrelated outputs. */
+uint64_t MixSeed(uint64_t n);
+
 /**
  * Fast randomness source. This is seeded once with secure random data, but
  * is completely deterministic and insecure after that.
@@ -36,12 +39,21 @@ class FastRandomContext {
 public:
     explicit FastRandomContext(bool fDeterministic=false);
 
+    /** Restart the sequence from a 64-bit seed: equal seeds give equal sequences. */
+    void Seed(uint64_t nSeed);
+
     uint32_t rand32() {
         Rz = 36969 * (Rz & 65535) + (Rz >> 16);
         Rw = 18000 * (Rw & 65535) + (Rw >> 16);
         return (Rw << 16) + Rz;
     }
 
+    /** Uniform double in (0, 1), from 53 random bits: never exactly 0 or 1. */
+    double randdouble() {
+        uint64_t nBits = ((uint64_t)rand32() << 21) ^ rand32();
+        return ((nBits & ((1ULL << 53) - 1)) + 0.5) / (double)(1ULL << 53);
+    }
+
     uint32_t Rz;
     uint32_t Rw;
 };
@@ -0,0 +1,185 @@
+// Copyright (c) 2017 The Litebench developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "retarget.h"
+
+#include "chainparams.h"
+#include "tinyformat.h"
+#include "utilstrencodings.h"
+
+#include <algorithm>
+
+void CRetargetCache::Push(const CBlockIndex* pindex)
+{
+    assert(pindex->nHeight == Height() + 1);
+    arith_uint256 bnTarget;
+    bnTarget.SetCompact(pindex->nBits);
+    if (!vTargetSum.empty())
+        bnTarget += vTargetSum.back();
+    vIndex.push_back(pindex);
+    vTime.push_back(pindex->GetBlockTime());
+    vTargetSum.push_back(bnTarget);
+}
+
+bool CRetargetCache::Sync(const CBlockIndex* pindexLast, int nMaxReorg)
+{
+    assert(nBase == 0);
+    if (Contains(pindexLast))
+        return true;
+
+    // Walk back to the fork point (the whole chain, on first use).
+    vConnect.clear();
+    const CBlockIndex* pindexFork = pindexLast;
+    while (pindexFork && !Contains(pindexFork)) {
+        if (pindexFork->nHeight < Height() - nMaxReorg)
+            return false;
+        vConnect.push_back(pindexFork);
+        pindexFork = pindexFork->pprev;
+    }
+
+    size_t nKeep = pindexFork ? pindexFork->nHeight + 1 : 0;
+    vIndex.resize(nKeep);
+    vTime.resize(nKeep);
+    vTargetSum.resize(nKeep);
+    for (std::vector<const CBlockIndex*>::reverse_iterator it = vConnect.rbegin(); it != vConnect.rend(); ++it)
+        Push(*it);
+    return true;
+}
+
+void CRetargetCache::Load(const CBlockIndex* pindexLast, int nBlocks)
+{
+    vConnect.clear();
+    for (const CBlockIndex* pindex = pindexLast; pindex && (int)vConnect.size() < nBlocks; pindex = pindex->pprev)
+        vConnect.push_back(pindex);
+
+    vIndex.clear();
+    vTime.clear();
+    vTargetSum.clear();
+    nBase = vConnect.empty() ? 0 : vConnect.back()->nHeight;
+    for (std::vector<const CBlockIndex*>::reverse_iterator it = vConnect.rbegin(); it != vConnect.rend(); ++it)
+        Push(*it);
+}
+
+const CRetargetAlgorithm* CRetargetTable::operator[](const std::string& strName) const
+{
+    std::map<std::string, const CRetargetAlgorithm*>::const_iterator it = mapAlgorithms.find(strName);
+    if (it == mapAlgorithms.end())
+        return NULL;
+    return it->second;
+}
+
+bool CRetargetTable::appendAlgorithm(const CRetargetAlgorithm* palgorithm)
+{
+    std::string strId = strprintf("%d", palgorithm->nId);
+    if (mapAlgorithms.count(palgorithm->name) || mapAlgorithms.count(strId))
+        return false;
+
+    mapAlgorithms[palgorithm->name] = palgorithm;
+    mapAlgorithms[strId] = palgorithm;
+    vAlgorithms.push_back(palgorithm);
+    return true;
+}
+
+std::vector<const CRetargetParam*> CRetargetTable::listParams(const std::string& strAlgorithm) const
+{
+    std::vector<const CRetargetParam*> vRet;
+    for (const CRetargetParam* pparam : vParams) {
+        if (pparam->algorithm == strAlgorithm)
+            vRet.push_back(pparam);
+    }
+    return vRet;
+}
+
+bool CRetargetTable::appendParam(const CRetargetParam* pparam)
+{
+    for (const CRetargetParam* pother : vParams) {
+        if (pother->name == pparam->name)
+            return false;
+    }
+    vParams.push_back(pparam);
+    return true;
+}
+
+namespace {
+/** Registry that registers the built-in algorithms as it is constructed. */
+class CBuiltinRetargetTable : public CRetargetTable
+{
+public:
+    CBuiltinRetargetTable() { RegisterPowRetargets(*this); }
+};
+} // namespace
+
+CRetargetTable& RetargetTable()
+{
+    static CBuiltinRetargetTable table;
+    return table;
+}
+
+std::string ListRetargetAlgorithms()
+{
+    std::string strList;
+    for (const CRetargetAlgorithm* palgorithm : RetargetTable().listAlgorithms()) {
+        if (!strList.empty())
+            strList += ", ";
+        strList += strprintf("%s (%d)", palgorithm->name, palgorithm->nId);
+    }
+    return strList;
+}
+
+bool ParseRetargetParam(const CRetargetParam& param, const std::string& strValue, int64_t& nValueRet)
+{
+    int64_t nValue;
+    if (!ParseInt64(strValue, &nValue) || nValue < param.nMin || nValue > param.nMax)
+        return false;
+    nValueRet = nValue;
+    return true;
+}
+
+CRetargetAlgorithm MakeRetargetVariant(const CRetargetAlgorithm& algorithm, const RetargetParamValues& vValues)
+{
+    CRetargetAlgorithm variant = algorithm;
+    std::string strValues;
+    for (const auto& value : vValues) {
+        if (!strValues.empty())
+            strValues += ";";
+        strValues += strprintf("%s=%d", value.first->name, value.second);
+    }
+    if (!strValues.empty())
+        variant.name += "(" + strValues + ")";
+    retargetfactory_fn factory = algorithm.factory;
+    variant.factory = [factory, vValues](const Consensus::Params& params) {
+        Consensus::Params paramsVariant = params;
+        for (const auto& value : vValues)
+            paramsVariant.*(value.first->pvalue) = value.second;
+        return factory(paramsVariant);
+    };
+    return variant;
+}
+
+std::unique_ptr<CRetarget> CreateRetarget(const std::string& strName, const Consensus::Params& params)
+{
+    const CRetargetAlgorithm* palgorithm = RetargetTable()[strName];
+    if (!palgorithm)
+        return std::unique_ptr<CRetarget>();
+    return palgorithm->factory(params);
+}
+
+static std::unique_ptr<CRetarget> retargetSelected;
+static const CRetargetAlgorithm* palgorithmSelected = NULL;
+
+bool SelectRetarget(const std::string& strName)
+{
+    std::unique_ptr<CRetarget> retarget = CreateRetarget(strName, Params().GetConsensus());
+    if (!retarget)
+        return false;
+    UpdateRetarget(retarget.get());
+    retargetSelected = std::move(retarget);
+    palgorithmSelected = RetargetTable()[strName];
+    return true;
+}
+
+const CRetargetAlgorithm* SelectedRetargetAlgorithm()
+{
+    return palgorithmSelected;
+}
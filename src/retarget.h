@@ -0,0 +1,234 @@
+// Copyright (c) 2017 The Litebench developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_RETARGET_H
+#define BITCOIN_RETARGET_H
+
+#include "arith_uint256.h"
+#include "chain.h"
+#include "consensus/params.h"
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+/** Retarget algorithm used when -retarget is not given */
+static const char* const DEFAULT_RETARGET = "bitcoin";
+
+/**
+ * A difficulty retarget algorithm bound to one chain. Instances are created
+ * from the registry below for a given set of params and hung off
+ * Consensus::Params::retarget, so that GetNextWorkRequired is a single virtual
+ * call, and chains running different algorithms can live side by side in one
+ * process. An instance may keep state about the chain it serves; calls on one
+ * instance must not overlap (in the node they are serialized by cs_main).
+ */
+class CRetarget
+{
+protected:
+    //! Filled in by every GetNextWorkRequired call
+    CRetargetState lastState;
+
+public:
+    virtual ~CRetarget() {}
+
+    /** Internals of the last GetNextWorkRequired call. */
+    const CRetargetState& GetLastState() const { return lastState; }
+
+    /** Forget them, for callers that decide the target without asking the algorithm. */
+    void ClearLastState() { lastState = CRetargetState(); }
+
+    /**
+     * Compact target the block after pindexLast must meet. pblock is the header
+     * being built or checked; params are those the instance was created for.
+     */
+    virtual unsigned int GetNextWorkRequired(const CBlockIndex* pindexLast, const CBlockHeader* pblock, const Consensus::Params& params) = 0;
+};
+
+typedef std::function<std::unique_ptr<CRetarget>(const Consensus::Params& params)> retargetfactory_fn;
+
+/** A registered retarget algorithm: how to name it and how to make an instance of it. */
+class CRetargetAlgorithm
+{
+public:
+    int nId;
+    std::string name;
+    std::string description;
+    retargetfactory_fn factory;
+};
+
+/**
+ * A tunable of a retarget algorithm: a field of Consensus::Params that its
+ * factory reads once, when it creates an instance. Set with -<name>=<n> in the
+ * node; litebench-sim takes a list of values and sweeps them all.
+ */
+class CRetargetParam
+{
+public:
+    std::string name;
+    //! Name of the algorithm it tunes
+    std::string algorithm;
+    std::string description;
+    int64_t Consensus::Params::*pvalue;
+    int64_t nMin;
+    int64_t nMax;
+};
+
+/** One point of a parameter grid: a tunable and the value it is set to. */
+typedef std::vector<std::pair<const CRetargetParam*, int64_t> > RetargetParamValues;
+
+/**
+ * Block times and decoded targets of one chain, indexed by height in
+ * contiguous arrays. Targets are kept as running sums modulo 2**256, so the
+ * sum of the targets over any window is a single subtraction (exact as long as
+ * the window's true sum fits in 256 bits, which it does for any window of
+ * retarget size below powLimit).
+ *
+ * The cache follows whatever chain it is synced to: Sync rewinds to the fork
+ * point and appends the new branch, so extending the tip is O(1) and a reorg
+ * costs its depth.
+ */
+class CRetargetCache
+{
+private:
+    //! Height of the first entry
+    int nBase;
+    std::vector<const CBlockIndex*> vIndex;
+    std::vector<int64_t> vTime;
+    //! vTargetSum[i] is the sum of the targets at heights nBase..nBase+i
+    std::vector<arith_uint256> vTargetSum;
+    //! Blocks Sync and Load are about to push, newest first; kept to reuse its memory
+    std::vector<const CBlockIndex*> vConnect;
+
+    void Push(const CBlockIndex* pindex);
+
+public:
+    CRetargetCache() : nBase(0) {}
+
+    /** Height of the last entry, or nBase-1 if empty. */
+    int Height() const { return nBase + (int)vIndex.size() - 1; }
+
+    /** Whether pindex is in the cache at its height. */
+    bool Contains(const CBlockIndex* pindex) const
+    {
+        int i = pindex->nHeight - nBase;
+        return i >= 0 && i < (int)vIndex.size() && vIndex[i] == pindex;
+    }
+
+    /**
+     * Make the cache cover the chain ending at pindexLast. A branch that forks
+     * off more than nMaxReorg blocks below the cached tip is left alone, and
+     * false is returned: a fresh Load over the window needed is cheaper than
+     * switching there and back.
+     */
+    bool Sync(const CBlockIndex* pindexLast, int nMaxReorg);
+
+    /** Replace the contents by the last nBlocks blocks of the chain ending at pindexLast. */
+    void Load(const CBlockIndex* pindexLast, int nBlocks);
+
+    int64_t GetBlockTime(int nHeight) const { return vTime[nHeight - nBase]; }
+
+    /** Target of the block at nHeight. */
+    arith_uint256 GetTarget(int nHeight) const { return GetTargetSum(nHeight, nHeight); }
+
+    /** Sum of the targets of the blocks at heights nFirst through nLast. */
+    arith_uint256 GetTargetSum(int nFirst, int nLast) const
+    {
+        return nFirst > nBase ? vTargetSum[nLast - nBase] - vTargetSum[nFirst - 1 - nBase] : vTargetSum[nLast - nBase];
+    }
+};
+
+/**
+ * Base for algorithms that look back over a window of recent blocks: keeps a
+ * CRetargetCache in step with the chain it is asked about.
+ */
+class CWindowRetarget : public CRetarget
+{
+private:
+    CRetargetCache cache;
+    //! Scratch space for windows on branches the cache does not follow
+    CRetargetCache scratch;
+
+protected:
+    /** A cache that covers at least the nBlocks blocks ending at pindexLast. */
+    const CRetargetCache& GetWindow(const CBlockIndex* pindexLast, int nBlocks)
+    {
+        if (cache.Sync(pindexLast, nBlocks))
+            return cache;
+        scratch.Load(pindexLast, nBlocks);
+        return scratch;
+    }
+};
+
+/**
+ * Retarget algorithm registry, looked up by name or by number.
+ */
+class CRetargetTable
+{
+private:
+    std::map<std::string, const CRetargetAlgorithm*> mapAlgorithms;
+    std::vector<const CRetargetAlgorithm*> vAlgorithms;
+    std::vector<const CRetargetParam*> vParams;
+
+public:
+    /** Find an algorithm by name or by its number; NULL if there is none. */
+    const CRetargetAlgorithm* operator[](const std::string& strName) const;
+
+    /** Registered algorithms, in order of registration. */
+    const std::vector<const CRetargetAlgorithm*>& listAlgorithms() const { return vAlgorithms; }
+
+    /**
+     * Appends an algorithm to the table.
+     * Neither names nor numbers can be reused (returns false).
+     */
+    bool appendAlgorithm(const CRetargetAlgorithm* palgorithm);
+
+    /** Registered tunables, in order of registration. */
+    const std::vector<const CRetargetParam*>& listParams() const { return vParams; }
+
+    /** Tunables of the algorithm with the given name. */
+    std::vector<const CRetargetParam*> listParams(const std::string& strAlgorithm) const;
+
+    /**
+     * Appends a tunable to the table.
+     * Names cannot be reused (returns false).
+     */
+    bool appendParam(const CRetargetParam* pparam);
+};
+
+/** The registry, with the built-in algorithms of pow.cpp registered on first use. */
+CRetargetTable& RetargetTable();
+
+/** Register the retarget algorithms of pow.cpp, and their tunables */
+void RegisterPowRetargets(CRetargetTable& table);
+
+/** Registered algorithm names, comma separated, for help and error messages. */
+std::string ListRetargetAlgorithms();
+
+/** Parse a value of param, checking it against the param's bounds. */
+bool ParseRetargetParam(const CRetargetParam& param, const std::string& strValue, int64_t& nValueRet);
+
+/**
+ * A copy of algorithm whose instances are created with the given tunables
+ * set, whatever the params passed to its factory say. Its name lists the
+ * values, e.g. "lwma(lwmawindow=45)", separated by semicolons if there are
+ * several, so that it can go in a CSV field as is.
+ */
+CRetargetAlgorithm MakeRetargetVariant(const CRetargetAlgorithm& algorithm, const RetargetParamValues& vValues);
+
+/** Create a new instance of the algorithm with the given name or number for params; empty if there is none. */
+std::unique_ptr<CRetarget> CreateRetarget(const std::string& strName, const Consensus::Params& params);
+
+/**
+ * Create the algorithm with the given name or number and bind it to the
+ * currently selected chain parameters. Returns false if there is no such algorithm.
+ */
+bool SelectRetarget(const std::string& strName);
+
+/** The algorithm SelectRetarget last bound, or NULL. */
+const CRetargetAlgorithm* SelectedRetargetAlgorithm();
+
+#endif // BITCOIN_RETARGET_H
@@ -0,0 +1,147 @@
+// Copyright (c) 2017 The Litebench developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "retargetstats.h"
+
+#include "chain.h"
+#include "pow.h"
+#include "retarget.h"
+#include "validation.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <cmath>
+
+CRetargetStats retargetStats;
+
+namespace {
+
+/** Subsidy paid by nCount blocks from nHeight on, one halving era at a time. */
+CAmount GetSubsidySum(int nHeight, int64_t nCount, const Consensus::Params& params)
+{
+    CAmount nSum = 0;
+    while (nCount > 0) {
+        CAmount nSubsidy = GetBlockSubsidy(nHeight, params);
+        if (nSubsidy == 0)
+            break;
+        int64_t nEraEnd = ((int64_t)nHeight / params.nSubsidyHalvingInterval + 1) * params.nSubsidyHalvingInterval;
+        int64_t nTake = std::min(nCount, nEraEnd - nHeight);
+        nSum += nTake * nSubsidy;
+        nHeight += nTake;
+        nCount -= nTake;
+    }
+    return nSum;
+}
+
+/** Nearest-rank percentile of v, which is reordered. */
+int64_t GetPercentile(std::vector<int64_t>& v, double dPercentile)
+{
+    size_t n = std::min(v.size() - 1, (size_t)std::max(std::ceil(dPercentile * v.size()) - 1, 0.0));
+    std::nth_element(v.begin(), v.begin() + n, v.end());
+    return v[n];
+}
+
+} // namespace
+
+void CRetargetStats::Push(const CBlockIndex* pindex)
+{
+    const CRetargetAlgorithm* palgorithm = SelectedRetargetAlgorithm();
+    vIndex.push_back(pindex);
+    vTime.push_back(pindex->GetBlockTime());
+    vDifficulty.push_back(GetDifficulty(pindex->nBits));
+    vAlgorithm.push_back(palgorithm ? palgorithm->nId : 0);
+    vFlags.push_back(pindex->retargetState.nFlags);
+}
+
+void CRetargetStats::Sync(const CBlockIndex* pindexTip)
+{
+    int nFork = -1;
+    if (pindexTip) {
+        nFork = std::min(Height(), pindexTip->nHeight);
+        const CBlockIndex* pindex = pindexTip->GetAncestor(nFork);
+        while (nFork >= 0 && vIndex[nFork] != pindex) {
+            pindex = pindex->pprev;
+            nFork--;
+        }
+    }
+    vIndex.resize(nFork + 1);
+    vTime.resize(nFork + 1);
+    vDifficulty.resize(nFork + 1);
+    vAlgorithm.resize(nFork + 1);
+    vFlags.resize(nFork + 1);
+    if (!pindexTip || nFork == pindexTip->nHeight)
+        return;
+
+    std::vector<const CBlockIndex*> vNew;
+    for (const CBlockIndex* pindex = pindexTip; pindex && pindex->nHeight > nFork; pindex = pindex->pprev)
+        vNew.push_back(pindex);
+    vIndex.reserve(pindexTip->nHeight + 1);
+    vTime.reserve(pindexTip->nHeight + 1);
+    vDifficulty.reserve(pindexTip->nHeight + 1);
+    vAlgorithm.reserve(pindexTip->nHeight + 1);
+    vFlags.reserve(pindexTip->nHeight + 1);
+    for (auto it = vNew.rbegin(); it != vNew.rend(); ++it)
+        Push(*it);
+}
+
+CRetargetSummary CRetargetStats::Summarize(int nFirst, int nLast, double dSlowFactor, const Consensus::Params& params) const
+{
+    assert(nFirst >= 1 && nFirst <= nLast && nLast <= Height());
+    CRetargetSummary summary;
+    summary.nFirst = nFirst;
+    summary.nLast = nLast;
+    const int nBlocks = summary.Blocks();
+
+    std::vector<int64_t> vInterval;
+    vInterval.reserve(nBlocks);
+    const double dSlow = dSlowFactor * params.nPowTargetSpacing;
+    int nSlowRun = 0;
+    double dSum = 0;
+    summary.dMinDifficulty = summary.dMaxDifficulty = vDifficulty[nFirst];
+    for (int nHeight = nFirst; nHeight <= nLast; nHeight++) {
+        int64_t nInterval = vTime[nHeight] - vTime[nHeight - 1];
+        vInterval.push_back(nInterval);
+        if (nInterval > dSlow) {
+            if (++nSlowRun > summary.nLongestSlowRun) {
+                summary.nLongestSlowRun = nSlowRun;
+                summary.nLongestSlowRunStart = nHeight - nSlowRun + 1;
+            }
+        } else {
+            nSlowRun = 0;
+        }
+
+        double dDifficulty = vDifficulty[nHeight];
+        dSum += dDifficulty;
+        summary.dMinDifficulty = std::min(summary.dMinDifficulty, dDifficulty);
+        summary.dMaxDifficulty = std::max(summary.dMaxDifficulty, dDifficulty);
+
+        CRetargetClampCount& count = summary.mapClamps[vAlgorithm[nHeight]];
+        const uint8_t nFlags = vFlags[nHeight];
+        count.nBlocks++;
+        count.nClampLow += (nFlags & RETARGET_CLAMP_LOW) != 0;
+        count.nClampHigh += (nFlags & RETARGET_CLAMP_HIGH) != 0;
+        count.nPowLimit += (nFlags & RETARGET_POW_LIMIT) != 0;
+        count.nRuleFast += (nFlags & RETARGET_RULE_FAST) != 0;
+        count.nRuleSlow += (nFlags & RETARGET_RULE_SLOW) != 0;
+    }
+
+    summary.nElapsed = vTime[nLast] - vTime[nFirst - 1];
+    summary.dMeanInterval = (double)summary.nElapsed / nBlocks;
+    summary.nMinInterval = *std::min_element(vInterval.begin(), vInterval.end());
+    summary.nMaxInterval = *std::max_element(vInterval.begin(), vInterval.end());
+    summary.nMedianInterval = GetPercentile(vInterval, 0.5);
+    summary.nP95Interval = GetPercentile(vInterval, 0.95);
+    summary.nP99Interval = GetPercentile(vInterval, 0.99);
+
+    summary.dMeanDifficulty = dSum / nBlocks;
+    double dSumSq = 0;
+    for (int nHeight = nFirst; nHeight <= nLast; nHeight++)
+        dSumSq += (vDifficulty[nHeight] - summary.dMeanDifficulty) * (vDifficulty[nHeight] - summary.dMeanDifficulty);
+    summary.dDifficultyVariance = dSumSq / nBlocks;
+
+    summary.dExpectedBlocks = std::max<double>(summary.nElapsed, 0) / params.nPowTargetSpacing;
+    summary.nEmitted = GetSubsidySum(nFirst, nBlocks, params);
+    summary.nScheduledEmission = GetSubsidySum(nFirst, (int64_t)summary.dExpectedBlocks, params);
+    return summary;
+}
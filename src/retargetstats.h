@@ -0,0 +1,109 @@
+// Copyright (c) 2017 The Litebench developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_RETARGETSTATS_H
+#define BITCOIN_RETARGETSTATS_H
+
+#include "amount.h"
+
+#include <stdint.h>
+#include <map>
+#include <vector>
+
+class CBlockIndex;
+
+namespace Consensus { struct Params; }
+
+/** How often one algorithm clamped or overrode its retarget over a height range. */
+struct CRetargetClampCount
+{
+    int nBlocks;
+    int nClampLow;
+    int nClampHigh;
+    int nPowLimit;
+    int nRuleFast;
+    int nRuleSlow;
+
+    CRetargetClampCount() : nBlocks(0), nClampLow(0), nClampHigh(0), nPowLimit(0), nRuleFast(0), nRuleSlow(0) {}
+};
+
+/** Aggregate retarget behaviour over a height range, as getretargetstats reports it. */
+struct CRetargetSummary
+{
+    int nFirst;
+    int nLast;
+    //! Block intervals (nTime minus the previous block's), in seconds
+    double dMeanInterval;
+    int64_t nMedianInterval;
+    int64_t nP95Interval;
+    int64_t nP99Interval;
+    int64_t nMinInterval;
+    int64_t nMaxInterval;
+    double dMeanDifficulty;
+    double dDifficultyVariance;
+    double dMinDifficulty;
+    double dMaxDifficulty;
+    //! Keyed by CRetargetAlgorithm::nId
+    std::map<int, CRetargetClampCount> mapClamps;
+    //! Longest run of consecutive intervals above the slow threshold, and the height it started at
+    int nLongestSlowRun;
+    int nLongestSlowRunStart;
+    //! Seconds the range took, and the blocks the target spacing would have produced in that time
+    int64_t nElapsed;
+    double dExpectedBlocks;
+    //! Subsidy the range paid out, and what the expected number of blocks would have paid
+    CAmount nEmitted;
+    CAmount nScheduledEmission;
+
+    CRetargetSummary() : nFirst(0), nLast(-1), dMeanInterval(0), nMedianInterval(0), nP95Interval(0), nP99Interval(0), nMinInterval(0), nMaxInterval(0),
+                         dMeanDifficulty(0), dDifficultyVariance(0), dMinDifficulty(0), dMaxDifficulty(0), nLongestSlowRun(0), nLongestSlowRunStart(-1),
+                         nElapsed(0), dExpectedBlocks(0), nEmitted(0), nScheduledEmission(0) {}
+
+    int Blocks() const { return nLast - nFirst + 1; }
+};
+
+/**
+ * Per-height retarget data of a chain in contiguous arrays: block times,
+ * difficulties, and the algorithm and RETARGET_* flags of the retarget that
+ * produced each block's nBits. The arrays follow whatever tip they are synced
+ * to: Sync rewinds to the fork point and appends the new blocks, so keeping
+ * up with a chain costs what it grew by, and aggregates over a range never
+ * walk the block index.
+ *
+ * Flags are the CBlockIndex::retargetState recorded when each header was
+ * checked; nothing here runs a retarget.
+ */
+class CRetargetStats
+{
+private:
+    std::vector<const CBlockIndex*> vIndex;
+    std::vector<int64_t> vTime;
+    std::vector<double> vDifficulty;
+    std::vector<uint8_t> vAlgorithm;
+    std::vector<uint8_t> vFlags;
+
+    void Push(const CBlockIndex* pindex);
+
+public:
+    /** Height of the last entry, or -1 if empty. */
+    int Height() const { return (int)vIndex.size() - 1; }
+
+    /** Make the arrays cover the chain ending at pindexTip. */
+    void Sync(const CBlockIndex* pindexTip);
+
+    /**
+     * Aggregates over heights nFirst through nLast (1 <= nFirst <= nLast <=
+     * Height()). An interval counts as slow when it is above dSlowFactor
+     * times the target spacing.
+     */
+    CRetargetSummary Summarize(int nFirst, int nLast, double dSlowFactor, const Consensus::Params& params) const;
+};
+
+/** Default multiple of the target spacing above which getretargetstats counts an interval as slow */
+static const double DEFAULT_RETARGETSTATS_SLOW_FACTOR = 2.0;
+
+/** Retarget data of chainActive, synced by UpdateTip as blocks connect and disconnect. Guarded by cs_main. */
+extern CRetargetStats retargetStats;
+
+#endif // BITCOIN_RETARGETSTATS_H
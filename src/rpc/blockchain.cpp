@@ -12,6 +12,8 @@
 #include "validation.h"
 #include "policy/policy.h"
 #include "primitives/transaction.h"
+#include "retarget.h"
+#include "retargetstats.h"
 #include "rpc/server.h"
 #include "streams.h"
 #include "sync.h"
@@ -88,7 +90,7 @@ UniValue blockheaderToJSON(const CBlockIndex* blockindex)
     result.push_back(Pair("versionHex", strprintf("%08x", blockindex->nVersion)));
     result.push_back(Pair("merkleroot", blockindex->hashMerkleRoot.GetHex()));
     result.push_back(Pair("time", (int64_t)blockindex->nTime));
-    result.push_back(Pair("mediantime", (int64_t)blockindex->GetMedianTimePast()));
+    result.push_back(Pair("mediantime", chainActive.GetMedianTimePast(blockindex)));
     result.push_back(Pair("nonce", (uint64_t)blockindex->nNonce));
     result.push_back(Pair("bits", strprintf("%08x", blockindex->nBits)));
     result.push_back(Pair("difficulty", GetDifficulty(blockindex)));
@@ -132,7 +134,7 @@ UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool tx
     }
     result.push_back(Pair("tx", txs));
     result.push_back(Pair("time", block.GetBlockTime()));
-    result.push_back(Pair("mediantime", (int64_t)blockindex->GetMedianTimePast()));
+    result.push_back(Pair("mediantime", chainActive.GetMedianTimePast(blockindex)));
     result.push_back(Pair("nonce", (uint64_t)block.nNonce));
     result.push_back(Pair("bits", strprintf("%08x", block.nBits)));
     result.push_back(Pair("difficulty", GetDifficulty(blockindex)));
@@ -329,6 +331,138 @@ UniValue getdifficulty(const JSONRPCRequest& request)
     return GetDifficulty();
 }
 
+UniValue getretargetstats(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 3)
+        throw runtime_error(
+            "getretargetstats ( startheight endheight slowfactor )\n"
+            "\nReturns aggregate retarget behaviour of the active chain over a height range.\n"
+            "Clamp counts are the flags recorded when each header was checked; blocks whose headers\n"
+            "were checked before the node last started count none.\n"
+            "\nArguments:\n"
+            "1. startheight   (numeric, optional, default=1) First block of the range, at least 1.\n"
+            "2. endheight     (numeric, optional, default=-1) Last block of the range, or -1 for the tip.\n"
+            + strprintf("3. slowfactor    (numeric, optional, default=%g) An interval above slowfactor times the target spacing counts as slow.\n", DEFAULT_RETARGETSTATS_SLOW_FACTOR) +
+            "\nResult:\n"
+            "{\n"
+            "  \"startheight\": n,          (numeric) first block of the range\n"
+            "  \"endheight\": n,            (numeric) last block of the range\n"
+            "  \"blocks\": n,               (numeric) number of blocks in the range\n"
+            "  \"targetspacing\": n,        (numeric) target block interval in seconds\n"
+            "  \"interval\": {              (json object) block intervals in seconds\n"
+            "    \"mean\": x.xxx,\n"
+            "    \"median\": n,\n"
+            "    \"p95\": n,\n"
+            "    \"p99\": n,\n"
+            "    \"min\": n,\n"
+            "    \"max\": n\n"
+            "  },\n"
+            "  \"difficulty\": {            (json object) block difficulties\n"
+            "    \"mean\": x.xxx,\n"
+            "    \"variance\": x.xxx,\n"
+            "    \"min\": x.xxx,\n"
+            "    \"max\": x.xxx\n"
+            "  },\n"
+            "  \"clamps\": [                (json array) per retarget algorithm\n"
+            "    {\n"
+            "      \"algorithm\": \"name\",   (string) retarget algorithm\n"
+            "      \"blocks\": n,           (numeric) blocks it retargeted\n"
+            "      \"clamplow\": n,         (numeric) blocks whose timespan was raised to its lower bound\n"
+            "      \"clamphigh\": n,        (numeric) blocks whose timespan was cut to its upper bound\n"
+            "      \"powlimit\": n,         (numeric) blocks whose target was capped at powLimit\n"
+            "      \"rulefast\": n,         (numeric) blocks a fast-block rule raised the difficulty of\n"
+            "      \"ruleslow\": n          (numeric) blocks a slow-block rule lowered the difficulty of\n"
+            "    }, ...\n"
+            "  ],\n"
+            "  \"longestslowrun\": {        (json object) longest run of consecutive slow intervals\n"
+            "    \"blocks\": n,\n"
+            "    \"startheight\": n       (numeric) first block of the run, or -1 if there is none\n"
+            "  },\n"
+            "  \"emission\": {              (json object) progress against the target spacing\n"
+            "    \"elapsed\": n,            (numeric) seconds the range took\n"
+            "    \"expectedblocks\": x.xxx, (numeric) blocks the target spacing would have produced in that time\n"
+            "    \"deviation\": x.xxx,      (numeric) blocks ahead (positive) or behind (negative) schedule\n"
+            "    \"deviationpct\": x.xxx,   (numeric) deviation as a percentage of expectedblocks\n"
+            "    \"emitted\": x.xxx,        (numeric) subsidy paid by the range, in " + CURRENCY_UNIT + "\n"
+            "    \"scheduled\": x.xxx       (numeric) subsidy expectedblocks would have paid, in " + CURRENCY_UNIT + "\n"
+            "  }\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getretargetstats", "")
+            + HelpExampleCli("getretargetstats", "1000 2000 3")
+            + HelpExampleRpc("getretargetstats", "1000, 2000")
+        );
+
+    LOCK(cs_main);
+    const Consensus::Params& params = Params().GetConsensus();
+
+    int nFirst = request.params.size() > 0 ? request.params[0].get_int() : 1;
+    int nLast = request.params.size() > 1 ? request.params[1].get_int() : -1;
+    if (nLast < 0)
+        nLast = chainActive.Height();
+    double dSlowFactor = request.params.size() > 2 ? request.params[2].get_real() : DEFAULT_RETARGETSTATS_SLOW_FACTOR;
+    if (nFirst < 1 || nLast > chainActive.Height() || nFirst > nLast)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Invalid height range %d-%d (chain height %d)", nFirst, nLast, chainActive.Height()));
+    if (dSlowFactor <= 0)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "slowfactor must be positive");
+
+    CRetargetSummary summary = retargetStats.Summarize(nFirst, nLast, dSlowFactor, params);
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("startheight", summary.nFirst));
+    ret.push_back(Pair("endheight", summary.nLast));
+    ret.push_back(Pair("blocks", summary.Blocks()));
+    ret.push_back(Pair("targetspacing", params.nPowTargetSpacing));
+
+    UniValue interval(UniValue::VOBJ);
+    interval.push_back(Pair("mean", summary.dMeanInterval));
+    interval.push_back(Pair("median", summary.nMedianInterval));
+    interval.push_back(Pair("p95", summary.nP95Interval));
+    interval.push_back(Pair("p99", summary.nP99Interval));
+    interval.push_back(Pair("min", summary.nMinInterval));
+    interval.push_back(Pair("max", summary.nMaxInterval));
+    ret.push_back(Pair("interval", interval));
+
+    UniValue difficulty(UniValue::VOBJ);
+    difficulty.push_back(Pair("mean", summary.dMeanDifficulty));
+    difficulty.push_back(Pair("variance", summary.dDifficultyVariance));
+    difficulty.push_back(Pair("min", summary.dMinDifficulty));
+    difficulty.push_back(Pair("max", summary.dMaxDifficulty));
+    ret.push_back(Pair("difficulty", difficulty));
+
+    UniValue clamps(UniValue::VARR);
+    for (const auto& entry : summary.mapClamps) {
+        const CRetargetAlgorithm* palgorithm = RetargetTable()[strprintf("%d", entry.first)];
+        const CRetargetClampCount& count = entry.second;
+        UniValue clamp(UniValue::VOBJ);
+        clamp.push_back(Pair("algorithm", palgorithm ? palgorithm->name : strprintf("%d", entry.first)));
+        clamp.push_back(Pair("blocks", count.nBlocks));
+        clamp.push_back(Pair("clamplow", count.nClampLow));
+        clamp.push_back(Pair("clamphigh", count.nClampHigh));
+        clamp.push_back(Pair("powlimit", count.nPowLimit));
+        clamp.push_back(Pair("rulefast", count.nRuleFast));
+        clamp.push_back(Pair("ruleslow", count.nRuleSlow));
+        clamps.push_back(clamp);
+    }
+    ret.push_back(Pair("clamps", clamps));
+
+    UniValue slowrun(UniValue::VOBJ);
+    slowrun.push_back(Pair("blocks", summary.nLongestSlowRun));
+    slowrun.push_back(Pair("startheight", summary.nLongestSlowRunStart));
+    ret.push_back(Pair("longestslowrun", slowrun));
+
+    UniValue emission(UniValue::VOBJ);
+    double dDeviation = summary.Blocks() - summary.dExpectedBlocks;
+    emission.push_back(Pair("elapsed", summary.nElapsed));
+    emission.push_back(Pair("expectedblocks", summary.dExpectedBlocks));
+    emission.push_back(Pair("deviation", dDeviation));
+    emission.push_back(Pair("deviationpct", summary.dExpectedBlocks > 0 ? 100 * dDeviation / summary.dExpectedBlocks : 0.0));
+    emission.push_back(Pair("emitted", ValueFromAmount(summary.nEmitted)));
+    emission.push_back(Pair("scheduled", ValueFromAmount(summary.nScheduledEmission)));
+    ret.push_back(Pair("emission", emission));
+    return ret;
+}
+
 std::string EntryDescriptionString()
 {
     return "    \"size\" : n,             (numeric) virtual transaction size as defined in BIP 141. This is different from actual serialized size for witness transactions as witness data is discounted.\n"
@@ -773,6 +907,25 @@ struct CCoinsStats
     CCoinsStats() : nHeight(0), nTransactions(0), nTransactionOutputs(0), nSerializedSize(0), nTotalAmount(0) {}
 };
 
+/**
+ * Hash one transaction's unspent outputs into the UTXO set hash, in the
+ * serialization that hash has always had: the txid, then VARINT(n+1) and the
+ * output for each unspent output in order of n, then VARINT(0).
+ */
+static void ApplyStats(CCoinsStats &stats, CHashWriter& ss, const uint256& hash, const std::map<uint32_t, Coin>& outputs)
+{
+    assert(!outputs.empty());
+    ss << hash;
+    stats.nTransactions++;
+    for (const auto& output : outputs) {
+        ss << VARINT(output.first + 1);
+        ss << output.second.out;
+        stats.nTransactionOutputs++;
+        stats.nTotalAmount += output.second.out.nValue;
+    }
+    ss << VARINT(0);
+}
+
 //! Calculate statistics about the unspent transaction output set
 static bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats)
 {
@@ -785,32 +938,29 @@ static bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats)
         stats.nHeight = mapBlockIndex.find(stats.hashBlock)->second->nHeight;
     }
     ss << stats.hashBlock;
-    CAmount nTotalAmount = 0;
+    uint256 prevkey;
+    std::map<uint32_t, Coin> outputs;
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
-        uint256 key;
-        CCoins coins;
-        if (pcursor->GetKey(key) && pcursor->GetValue(coins)) {
-            stats.nTransactions++;
-            ss << key;
-            for (unsigned int i=0; i<coins.vout.size(); i++) {
-                const CTxOut &out = coins.vout[i];
-                if (!out.IsNull()) {
-                    stats.nTransactionOutputs++;
-                    ss << VARINT(i+1);
-                    ss << out;
-                    nTotalAmount += out.nValue;
-                }
+        COutPoint key;
+        Coin coin;
+        if (pcursor->GetKey(key) && pcursor->GetValue(coin)) {
+            if (!outputs.empty() && key.hash != prevkey) {
+                ApplyStats(stats, ss, prevkey, outputs);
+                outputs.clear();
             }
+            prevkey = key.hash;
+            outputs[key.n] = std::move(coin);
             stats.nSerializedSize += 32 + pcursor->GetValueSize();
-            ss << VARINT(0);
         } else {
             return error("%s: unable to read value", __func__);
         }
         pcursor->Next();
     }
+    if (!outputs.empty()) {
+        ApplyStats(stats, ss, prevkey, outputs);
+    }
     stats.hashSerialized = ss.GetHash();
-    stats.nTotalAmount = nTotalAmount;
     return true;
 }
 
@@ -879,6 +1029,11 @@ UniValue gettxoutsetinfo(const JSONRPCRequest& request)
             "  \"bytes_serialized\": n,  (numeric) The serialized size\n"
             "  \"hash_serialized\": \"hash\",   (string) The serialized hash\n"
             "  \"total_amount\": x.xxx          (numeric) The total amount\n"
+            "  \"cache_entries\": n,    (numeric) The number of outputs held in the coins cache\n"
+            "  \"cache_usage\": n,      (numeric) The memory used by the coins cache, in bytes\n"
+            "  \"cache_hits\": n,       (numeric) Coins lookups answered by the cache since startup\n"
+            "  \"cache_misses\": n,     (numeric) Coins lookups that had to go to the database since startup\n"
+            "  \"cache_hit_ratio\": x.xxx  (numeric) cache_hits / (cache_hits + cache_misses)\n"
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("gettxoutsetinfo", "")
@@ -897,6 +1052,14 @@ UniValue gettxoutsetinfo(const JSONRPCRequest& request)
         ret.push_back(Pair("bytes_serialized", (int64_t)stats.nSerializedSize));
         ret.push_back(Pair("hash_serialized", stats.hashSerialized.GetHex()));
         ret.push_back(Pair("total_amount", ValueFromAmount(stats.nTotalAmount)));
+        LOCK(cs_main);
+        uint64_t nHits = pcoinsTip->GetCacheHits();
+        uint64_t nMisses = pcoinsTip->GetCacheMisses();
+        ret.push_back(Pair("cache_entries", (int64_t)pcoinsTip->GetCacheSize()));
+        ret.push_back(Pair("cache_usage", (int64_t)pcoinsTip->DynamicMemoryUsage()));
+        ret.push_back(Pair("cache_hits", nHits));
+        ret.push_back(Pair("cache_misses", nMisses));
+        ret.push_back(Pair("cache_hit_ratio", nHits + nMisses > 0 ? (double)nHits / (nHits + nMisses) : 0.0));
     } else {
         throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
     }
@@ -928,7 +1091,6 @@ UniValue gettxout(const JSONRPCRequest& request)
             "        ,...\n"
             "     ]\n"
             "  },\n"
-            "  \"version\" : n,            (numeric) The version\n"
             "  \"coinbase\" : true|false   (boolean) Coinbase or not\n"
             "}\n"
 
@@ -952,33 +1114,32 @@ UniValue gettxout(const JSONRPCRequest& request)
     if (request.params.size() > 2)
         fMempool = request.params[2].get_bool();
 
-    CCoins coins;
+    COutPoint out(hash, n);
+    Coin coin;
     if (fMempool) {
         LOCK(mempool.cs);
         CCoinsViewMemPool view(pcoinsTip, mempool);
-        if (!view.GetCoins(hash, coins))
+        if (!view.GetCoin(out, coin) || mempool.isSpent(out)) { // TODO: filtering spent coins should be done by the CCoinsViewMemPool
             return NullUniValue;
-        mempool.pruneSpent(hash, coins); // TODO: this should be done by the CCoinsViewMemPool
+        }
     } else {
-        if (!pcoinsTip->GetCoins(hash, coins))
+        if (!pcoinsTip->GetCoin(out, coin)) {
             return NullUniValue;
+        }
     }
-    if (n<0 || (unsigned int)n>=coins.vout.size() || coins.vout[n].IsNull())
-        return NullUniValue;
 
     BlockMap::iterator it = mapBlockIndex.find(pcoinsTip->GetBestBlock());
     CBlockIndex *pindex = it->second;
     ret.push_back(Pair("bestblock", pindex->GetBlockHash().GetHex()));
-    if ((unsigned int)coins.nHeight == MEMPOOL_HEIGHT)
+    if (coin.nHeight == MEMPOOL_HEIGHT)
         ret.push_back(Pair("confirmations", 0));
     else
-        ret.push_back(Pair("confirmations", pindex->nHeight - coins.nHeight + 1));
-    ret.push_back(Pair("value", ValueFromAmount(coins.vout[n].nValue)));
+        ret.push_back(Pair("confirmations", (int64_t)(pindex->nHeight - coin.nHeight + 1)));
+    ret.push_back(Pair("value", ValueFromAmount(coin.out.nValue)));
     UniValue o(UniValue::VOBJ);
-    ScriptPubKeyToJSON(coins.vout[n].scriptPubKey, o, true);
+    ScriptPubKeyToJSON(coin.out.scriptPubKey, o, true);
     ret.push_back(Pair("scriptPubKey", o));
-    ret.push_back(Pair("version", coins.nVersion));
-    ret.push_back(Pair("coinbase", coins.fCoinBase));
+    ret.push_back(Pair("coinbase", (bool)coin.fCoinBase));
 
     return ret;
 }
@@ -1121,7 +1282,7 @@ UniValue getblockchaininfo(const JSONRPCRequest& request)
     obj.push_back(Pair("headers",               pindexBestHeader ? pindexBestHeader->nHeight : -1));
     obj.push_back(Pair("bestblockhash",         chainActive.Tip()->GetBlockHash().GetHex()));
     obj.push_back(Pair("difficulty",            (double)GetDifficulty()));
-    obj.push_back(Pair("mediantime",            (int64_t)chainActive.Tip()->GetMedianTimePast()));
+    obj.push_back(Pair("mediantime",            chainActive.GetMedianTimePast(chainActive.Height())));
     obj.push_back(Pair("verificationprogress",  GuessVerificationProgress(Params().TxData(), chainActive.Tip())));
     obj.push_back(Pair("chainwork",             chainActive.Tip()->nChainWork.GetHex()));
     obj.push_back(Pair("pruned",                fPruneMode));
@@ -1431,6 +1592,7 @@ static const CRPCCommand commands[] =
     { "blockchain",         "getmempoolentry",        &getmempoolentry,        true,  {"txid"} },
     { "blockchain",         "getmempoolinfo",         &getmempoolinfo,         true,  {} },
     { "blockchain",         "getrawmempool",          &getrawmempool,          true,  {"verbose"} },
+    { "blockchain",         "getretargetstats",       &getretargetstats,       true,  {"startheight","endheight","slowfactor"} },
     { "blockchain",         "gettxout",               &gettxout,               true,  {"txid","n","include_mempool"} },
     { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        true,  {} },
     { "blockchain",         "pruneblockchain",        &pruneblockchain,        true,  {"height"} },
@@ -38,6 +38,9 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "generatetoaddress", 2, "maxtries" },
     { "getnetworkhashps", 0, "nblocks" },
     { "getnetworkhashps", 1, "height" },
+    { "getretargetstats", 0, "startheight" },
+    { "getretargetstats", 1, "endheight" },
+    { "getretargetstats", 2, "slowfactor" },
     { "sendtoaddress", 1, "amount" },
     { "sendtoaddress", 4, "subtractfeefromamount" },
     { "settxfee", 0, "amount" },
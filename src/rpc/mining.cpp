@@ -12,15 +12,18 @@
 #include "consensus/validation.h"
 #include "core_io.h"
 #include "init.h"
+#include "manifest.h"
 #include "validation.h"
 #include "miner.h"
 #include "net.h"
 #include "pow.h"
+#include "powminer.h"
 #include "rpc/server.h"
 #include "txmempool.h"
 #include "util.h"
 #include "utilstrencodings.h"
 #include "validationinterface.h"
+#include "virtualclock.h"
 
 #include <memory>
 #include <stdint.h>
@@ -54,12 +57,12 @@ UniValue GetNetworkHashPS(int lookup, int height) {
     if (lookup > pb->nHeight)
         lookup = pb->nHeight;
 
-    CBlockIndex *pb0 = pb;
-    int64_t minTime = pb0->GetBlockTime();
+    // pb is in chainActive, so the window is a scan of its time array.
+    const int nHeight = pb->nHeight;
+    int64_t minTime = chainActive.GetBlockTime(nHeight);
     int64_t maxTime = minTime;
-    for (int i = 0; i < lookup; i++) {
-        pb0 = pb0->pprev;
-        int64_t time = pb0->GetBlockTime();
+    for (int i = nHeight - lookup; i < nHeight; i++) {
+        int64_t time = chainActive.GetBlockTime(i);
         minTime = std::min(time, minTime);
         maxTime = std::max(time, maxTime);
     }
@@ -68,7 +71,7 @@ UniValue GetNetworkHashPS(int lookup, int height) {
     if (minTime == maxTime)
         return 0;
 
-    arith_uint256 workDiff = pb->nChainWork - pb0->nChainWork;
+    arith_uint256 workDiff = chainActive.GetChainWork(nHeight) - chainActive.GetChainWork(nHeight - lookup);
     int64_t timeDiff = maxTime - minTime;
 
     return workDiff.getdouble() / timeDiff;
@@ -99,9 +102,13 @@ UniValue getnetworkhashps(const JSONRPCRequest& request)
 UniValue generateBlocks(boost::shared_ptr<CReserveScript> coinbaseScript, int nGenerate, uint64_t nMaxTries, bool keepScript)
 {
     static const int nInnerLoopCount = 0x10000;
+    // Shared by every generate call, so the workers' scratchpads are allocated once
+    static CPowMiner miner(GetArg("-minerthreads", DEFAULT_MINER_THREADS));
     int nHeightStart = 0;
     int nHeightEnd = 0;
     int nHeight = 0;
+    //! Height the virtual clock was last advanced for, so extranonce rolls don't advance it again
+    int nClockHeight = -1;
 
     {   // Don't keep cs_main locked
         LOCK(cs_main);
@@ -120,15 +127,28 @@ UniValue generateBlocks(boost::shared_ptr<CReserveScript> coinbaseScript, int nG
         {
             LOCK(cs_main);
             IncrementExtraNonce(pblock, chainActive.Tip(), nExtraNonce);
+            if (IsVirtualClockEnabled()) {
+                // The declared hashrate, not the real nonce search, decides when this block is found.
+                if (nClockHeight != nHeight) {
+                    AdvanceVirtualClock(pblock->nBits);
+                    nClockHeight = nHeight;
+                }
+                pblock->nTime = GetVirtualBlockTime(chainActive.GetMedianTimePast(chainActive.Height()));
+                // Retargets may depend on the block's own time (min-difficulty
+                // rules, DualKGW3's 12h rule), so match nBits to the new nTime.
+                pblock->nBits = GetNextWorkRequired(chainActive.Tip(), pblock, Params().GetConsensus());
+            }
         }
-        while (nMaxTries > 0 && pblock->nNonce < nInnerLoopCount && !CheckProofOfWork(pblock->GetPoWHash(), pblock->nBits, Params().GetConsensus())) {
-            ++pblock->nNonce;
-            --nMaxTries;
-        }
-        if (nMaxTries == 0) {
-            break;
-        }
-        if (pblock->nNonce == nInnerLoopCount) {
+        CMiningTarget target;
+        if (!target.SetCompact(pblock->nBits, Params().GetConsensus().powLimit))
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Block template has an invalid nBits");
+        uint64_t nHashes = 0;
+        bool fFound = miner.Search(*pblock, target, pblock->nNonce, std::min<uint64_t>(nInnerLoopCount - pblock->nNonce, nMaxTries), nHashes);
+        nMaxTries -= std::min(nHashes, nMaxTries);
+        if (!fFound) {
+            if (nMaxTries == 0) {
+                break;
+            }
             continue;
         }
         std::shared_ptr<const CBlock> shared_pblock = std::make_shared<const CBlock>(*pblock);
@@ -152,6 +172,7 @@ UniValue generate(const JSONRPCRequest& request)
         throw runtime_error(
             "generate nblocks ( maxtries )\n"
             "\nMine up to nblocks blocks immediately (before the RPC call returns)\n"
+            "to a wallet key, or with -seed to a key derived from the seed.\n"
             "\nArguments:\n"
             "1. nblocks      (numeric, required) How many blocks are generated immediately.\n"
             "2. maxtries     (numeric, optional) How many iterations to try (default = 1000000).\n"
@@ -168,6 +189,14 @@ UniValue generate(const JSONRPCRequest& request)
         nMaxTries = request.params[1].get_int();
     }
 
+    // A -seed run pays to a key derived from the seed, so that its blocks are the same every time.
+    uint64_t nSeed;
+    if (GetSeedArg(nSeed)) {
+        boost::shared_ptr<CReserveScript> coinbaseScript(new CReserveScript());
+        coinbaseScript->reserveScript = GetSeedCoinbaseScript(nSeed);
+        return generateBlocks(coinbaseScript, nGenerate, nMaxTries, false);
+    }
+
     boost::shared_ptr<CReserveScript> coinbaseScript;
     GetMainSignals().ScriptForMining(coinbaseScript);
 
@@ -678,7 +707,7 @@ UniValue getblocktemplate(const JSONRPCRequest& request)
     result.push_back(Pair("coinbasevalue", (int64_t)pblock->vtx[0]->vout[0].nValue));
     result.push_back(Pair("longpollid", chainActive.Tip()->GetBlockHash().GetHex() + i64tostr(nTransactionsUpdatedLast)));
     result.push_back(Pair("target", hashTarget.GetHex()));
-    result.push_back(Pair("mintime", (int64_t)pindexPrev->GetMedianTimePast()+1));
+    result.push_back(Pair("mintime", (int64_t)chainActive.GetMedianTimePast(pindexPrev)+1));
     result.push_back(Pair("mutable", aMutable));
     result.push_back(Pair("noncerange", "00000000ffffffff"));
     int64_t nSigOpLimit = MAX_BLOCK_SIGOPS_COST;
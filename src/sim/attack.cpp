@@ -0,0 +1,180 @@
+// Copyright (c) 2017 The Litebench developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "sim/attack.h"
+
+#include "pow.h"
+#include "random.h"
+#include "tinyformat.h"
+#include "utilstrencodings.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <limits>
+#include <memory>
+
+static const char* const attackStrategyNames[] = {"mtp", "future", "alternate", "warp", "random"};
+
+std::string CAttackStrategy::ToString() const
+{
+    if (type == ATTACK_ALTERNATE || type == ATTACK_WARP)
+        return strprintf("%s:%d", attackStrategyNames[type], nPeriod);
+    return attackStrategyNames[type];
+}
+
+bool CAttackStrategy::Parse(const std::string& strStrategy, int nInterval, CAttackStrategy& strategy)
+{
+    size_t nColon = strStrategy.find(':');
+    std::string strName = strStrategy.substr(0, nColon);
+    for (int i = ATTACK_MTP; i <= ATTACK_RANDOM; i++) {
+        if (strName != attackStrategyNames[i])
+            continue;
+        strategy.type = (AttackStrategy)i;
+        strategy.nPeriod = 0;
+        if (strategy.type == ATTACK_ALTERNATE)
+            strategy.nPeriod = 2;
+        else if (strategy.type == ATTACK_WARP)
+            strategy.nPeriod = std::max(nInterval, 1);
+        if (nColon == std::string::npos)
+            return true;
+        int32_t nPeriod;
+        if (strategy.nPeriod == 0 || !ParseInt32(strStrategy.substr(nColon + 1), &nPeriod) || nPeriod < 1)
+            return false;
+        strategy.nPeriod = nPeriod;
+        return true;
+    }
+    return false;
+}
+
+std::string ListAttackStrategies()
+{
+    return "mtp, future, alternate[:period], warp[:period], random";
+}
+
+namespace {
+
+/** Attacker following one of the fixed strategies. */
+class CStrategyAttacker : public CTimestampAttacker
+{
+private:
+    const CAttackStrategy strategy;
+    const double dFraction;
+    FastRandomContext rng;
+    int64_t nBlocks;
+
+public:
+    CStrategyAttacker(const CAttackStrategy& strategyIn, double dFractionIn, uint64_t nSeed) : strategy(strategyIn), dFraction(dFractionIn), rng(true), nBlocks(0)
+    {
+        rng.Seed(nSeed);
+    }
+
+    double GetFraction() const override { return dFraction; }
+
+    int64_t GetBlockTime(const CBlockIndex* pindexPrev, int64_t nMinTime, int64_t nMaxTime) override
+    {
+        nBlocks++;
+        switch (strategy.type) {
+        case ATTACK_MTP:
+            return nMinTime;
+        case ATTACK_FUTURE:
+            return nMaxTime;
+        case ATTACK_ALTERNATE:
+            return nBlocks % strategy.nPeriod == 0 ? nMaxTime : nMinTime;
+        case ATTACK_WARP:
+            return (pindexPrev->nHeight + 1) % strategy.nPeriod == strategy.nPeriod - 1 ? nMaxTime : nMinTime;
+        case ATTACK_RANDOM:
+            return nMinTime + (int64_t)(rng.randdouble() * (nMaxTime - nMinTime + 1));
+        }
+        return nMinTime;
+    }
+};
+
+struct AttackJob
+{
+    const CRetargetAlgorithm* palgorithm;
+    //! Index into the (strategy, fraction) pairs, or -1 for the honest run
+    int nAttack;
+    int nTrial;
+};
+
+void RunAttackJob(const Consensus::Params& params, uint32_t nGenesisTime, uint32_t nGenesisBits, const CAttackConfig& config, const AttackJob& job, CAttackStats& stats)
+{
+    CHashrateModel hashrate(config.dHashrate);
+    uint64_t nSeed = MixSeed(MixSeed(config.nSeed) ^ (uint64_t)job.nTrial);
+    CSimulator sim(params, *job.palgorithm, hashrate, nSeed, config.nBlocks);
+    std::unique_ptr<CStrategyAttacker> attacker;
+    if (job.nAttack >= 0) {
+        const CAttackStrategy& strategy = config.vStrategies[job.nAttack / config.vFractions.size()];
+        attacker.reset(new CStrategyAttacker(strategy, config.vFractions[job.nAttack % config.vFractions.size()], MixSeed(nSeed)));
+        sim.SetAttacker(attacker.get());
+    }
+    sim.Reset(nGenesisTime, nGenesisBits);
+    sim.Run(config.nWarmup);
+    int64_t nStart = sim.GetClock();
+    sim.Run(config.nBlocks - config.nWarmup);
+
+    const CSimChain& chain = sim.GetChain();
+    const int nFinalHeight = chain.Height() - std::max((chain.Height() - config.nWarmup) / 10, 1) + 1;
+    double dSum = 0, dFinalSum = 0;
+    stats.dMinDifficulty = std::numeric_limits<double>::max();
+    for (int nHeight = config.nWarmup + 1; nHeight <= chain.Height(); nHeight++) {
+        double dDifficulty = GetDifficulty(chain[nHeight].nBits);
+        dSum += dDifficulty;
+        if (nHeight >= nFinalHeight)
+            dFinalSum += dDifficulty;
+        stats.dMinDifficulty = std::min(stats.dMinDifficulty, dDifficulty);
+    }
+    stats.dElapsed = std::max<double>(sim.GetClock() - nStart, 1);
+    stats.dMeanDifficulty = dSum / (chain.Height() - config.nWarmup);
+    stats.dFinalDifficulty = dFinalSum / (chain.Height() - nFinalHeight + 1);
+    stats.nTimeLag = sim.GetClock() - chain.Tip()->GetBlockTime();
+    stats.fStalled = sim.GetClock() >= std::numeric_limits<uint32_t>::max();
+}
+
+} // namespace
+
+std::vector<CAttackResult> RunAttacks(const Consensus::Params& params, uint32_t nGenesisTime, uint32_t nGenesisBits, const CAttackConfig& config)
+{
+    assert(config.nWarmup >= 0 && config.nWarmup < config.nBlocks);
+    const int nAttacks = config.vStrategies.size() * config.vFractions.size();
+    const int nRunsPerAlgorithm = config.nTrials * (nAttacks + 1);
+
+    // Per algorithm: each trial's honest run, then its attacked runs.
+    std::vector<AttackJob> vJobs;
+    for (const CRetargetAlgorithm* palgorithm : config.vAlgorithms)
+        for (int nTrial = 0; nTrial < config.nTrials; nTrial++)
+            for (int nAttack = -1; nAttack < nAttacks; nAttack++)
+                vJobs.push_back(AttackJob{palgorithm, nAttack, nTrial});
+
+    std::vector<CAttackStats> vStats(vJobs.size());
+    RunJobs(vJobs.size(), config.nThreads, [&](size_t nJob) {
+        RunAttackJob(params, nGenesisTime, nGenesisBits, config, vJobs[nJob], vStats[nJob]);
+    });
+
+    std::vector<CAttackResult> vResults;
+    for (size_t nAlgorithm = 0; nAlgorithm < config.vAlgorithms.size(); nAlgorithm++) {
+        for (int nAttack = 0; nAttack < nAttacks; nAttack++) {
+            vResults.emplace_back();
+            CAttackResult& result = vResults.back();
+            result.palgorithm = config.vAlgorithms[nAlgorithm];
+            result.strategy = config.vStrategies[nAttack / config.vFractions.size()];
+            result.dFraction = config.vFractions[nAttack % config.vFractions.size()];
+            for (int nTrial = 0; nTrial < config.nTrials; nTrial++) {
+                size_t nHonest = nAlgorithm * nRunsPerAlgorithm + nTrial * (nAttacks + 1);
+                const CAttackStats& honest = vStats[nHonest];
+                const CAttackStats& attacked = vStats[nHonest + 1 + nAttack];
+                if (honest.fStalled || attacked.fStalled) {
+                    result.nStalled++;
+                    continue;
+                }
+                result.speedup.Push(honest.dElapsed / attacked.dElapsed);
+                result.difficulty.Push(attacked.dMeanDifficulty / honest.dMeanDifficulty);
+                result.minDifficulty.Push(attacked.dMinDifficulty / honest.dMinDifficulty);
+                result.finalDifficulty.Push(attacked.dFinalDifficulty / honest.dFinalDifficulty);
+                result.timeLag.Push(attacked.nTimeLag);
+            }
+        }
+    }
+    return vResults;
+}
@@ -0,0 +1,117 @@
+// Copyright (c) 2017 The Litebench developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_SIM_ATTACK_H
+#define BITCOIN_SIM_ATTACK_H
+
+#include "consensus/params.h"
+#include "retarget.h"
+#include "sim/simulator.h"
+#include "sim/sweep.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/** Default number of blocks per attack run */
+static const int DEFAULT_ATTACK_BLOCKS = 100000;
+/** Default shares of the hashrate the attacker is tried with */
+static const char* const DEFAULT_ATTACK_FRACTIONS = "0.1,0.3,0.5";
+
+/** Ways an attacker can pick its block timestamps. */
+enum AttackStrategy
+{
+    ATTACK_MTP,        //!< always median time past + 1
+    ATTACK_FUTURE,     //!< always as far ahead of the clock as consensus allows
+    ATTACK_ALTERNATE,  //!< every nPeriod-th attacker block as far ahead as allowed, the rest at median time past + 1
+    ATTACK_WARP,       //!< median time past + 1, except blocks closing a retarget window of nPeriod heights, as far ahead as allowed
+    ATTACK_RANDOM,     //!< uniformly anywhere consensus allows
+};
+
+/** A strategy and its parameter, written name[:period] on the command line. */
+struct CAttackStrategy
+{
+    AttackStrategy type;
+    int nPeriod;
+
+    CAttackStrategy() : type(ATTACK_MTP), nPeriod(0) {}
+
+    std::string ToString() const;
+
+    /**
+     * Parse name[:period]. Without a period, alternate uses 2 and warp uses
+     * nInterval, the chain's retarget interval. Returns false if strStrategy
+     * is not valid.
+     */
+    static bool Parse(const std::string& strStrategy, int nInterval, CAttackStrategy& strategy);
+};
+
+/** Every strategy with its default period, as accepted by CAttackStrategy::Parse. */
+std::string ListAttackStrategies();
+
+/** What one run did, counted from the end of the warmup. */
+struct CAttackStats
+{
+    //! Simulated wall clock seconds taken to mine the blocks
+    double dElapsed;
+    double dMeanDifficulty;
+    double dMinDifficulty;
+    //! Mean difficulty over the last tenth of the run
+    double dFinalDifficulty;
+    //! How far the tip's timestamp is behind the wall clock at the end, in seconds
+    int64_t nTimeLag;
+    //! The difficulty ran away and the clock hit the end of nTime's range
+    bool fStalled;
+
+    CAttackStats() : dElapsed(0), dMeanDifficulty(0), dMinDifficulty(0), dFinalDifficulty(0), nTimeLag(0), fStalled(false) {}
+};
+
+/**
+ * Outcome of one strategy at one hashrate share against one algorithm, as
+ * ratios to honest runs of the same algorithm on the same seeds.
+ */
+struct CAttackResult
+{
+    const CRetargetAlgorithm* palgorithm;
+    CAttackStrategy strategy;
+    double dFraction;
+    //! Honest wall clock time / attacked wall clock time for the same number of blocks
+    CRunningStat speedup;
+    //! Mean, minimum and final difficulty over the honest run's
+    CRunningStat difficulty;
+    CRunningStat minDifficulty;
+    CRunningStat finalDifficulty;
+    CRunningStat timeLag;
+    //! Trials left out of the ratios above because a run stalled
+    int nStalled;
+
+    CAttackResult() : palgorithm(NULL), dFraction(0), nStalled(0) {}
+};
+
+/** Parameters of an attack search. */
+struct CAttackConfig
+{
+    std::vector<const CRetargetAlgorithm*> vAlgorithms;
+    std::vector<CAttackStrategy> vStrategies;
+    std::vector<double> vFractions;
+    int nTrials;
+    int nBlocks;
+    int nWarmup;
+    double dHashrate;
+    uint64_t nSeed;
+    int nThreads;
+
+    CAttackConfig() : nTrials(DEFAULT_SWEEP_TRIALS), nBlocks(DEFAULT_ATTACK_BLOCKS), nWarmup(DEFAULT_SIM_WARMUP), dHashrate(DEFAULT_SIM_HASHRATE), nSeed(0), nThreads(1) {}
+};
+
+/**
+ * Run every algorithm honestly and under every (strategy, fraction) pair of
+ * config, config.nTrials times each, spread across config.nThreads threads.
+ * Trial n uses the same seed for every run, so each attacked run is compared
+ * with an honest run that started from the same random draws. Returns one
+ * entry per (algorithm, strategy, fraction), algorithms outermost.
+ */
+std::vector<CAttackResult> RunAttacks(const Consensus::Params& params, uint32_t nGenesisTime, uint32_t nGenesisBits, const CAttackConfig& config);
+
+#endif // BITCOIN_SIM_ATTACK_H
@@ -0,0 +1,328 @@
+// Copyright (c) 2017 The Litebench developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "sim/replay.h"
+
+#include "crypto/common.h"
+#include "hash.h"
+#include "pow.h"
+#include "sim/sweep.h"
+#include "tinyformat.h"
+#include "uint256.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <map>
+#include <stdexcept>
+#include <string.h>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+namespace {
+
+const size_t HEADER_SIZE = 80;
+const int64_t SECONDS_PER_DAY = 24 * 60 * 60;
+
+/** A whole file mapped read-only. */
+class CMappedFile
+{
+private:
+    boost::interprocess::file_mapping file;
+    boost::interprocess::mapped_region region;
+
+public:
+    explicit CMappedFile(const std::string& strFile)
+    {
+        using namespace boost::interprocess;
+        if (boost::filesystem::file_size(strFile) == 0)
+            return;
+        try {
+            file = file_mapping(strFile.c_str(), read_only);
+            region = mapped_region(file, read_only);
+        } catch (const interprocess_exception& e) {
+            throw std::runtime_error(strprintf("Cannot map %s: %s", strFile, e.what()));
+        }
+        region.advise(mapped_region::advice_sequential);
+    }
+
+    const unsigned char* begin() const { return (const unsigned char*)region.get_address(); }
+    const unsigned char* end() const { return begin() + region.get_size(); }
+    size_t size() const { return region.get_size(); }
+};
+
+/** Whether p starts a block file record: a network magic, a length, then that many bytes, then the magic again or the end. */
+bool IsBlockFile(const CMappedFile& file)
+{
+    if (file.size() < 8 + HEADER_SIZE)
+        return false;
+    uint32_t nMagic = ReadLE32(file.begin());
+    uint64_t nNext = 8 + (uint64_t)ReadLE32(file.begin() + 4);
+    if (nMagic == 0 || nNext < 8 + HEADER_SIZE || nNext > file.size())
+        return false;
+    return nNext == file.size() || (nNext + 4 <= file.size() && ReadLE32(file.begin() + nNext) == nMagic);
+}
+
+/**
+ * Puts the headers of block files in chain order. Block files hold stale
+ * blocks and store blocks out of order, so all headers are collected first;
+ * Finish() then hands the sink the chain with the most work, starting at the
+ * one header whose parent is not among them.
+ */
+class CBlockFileOrderer
+{
+private:
+    static const uint32_t NO_PARENT = std::numeric_limits<uint32_t>::max();
+
+    struct CHeaderEntry
+    {
+        unsigned char header[HEADER_SIZE];
+        uint32_t nParent;
+    };
+
+    std::function<void(const unsigned char*)> sink;
+    std::vector<CHeaderEntry> vHeaders;
+    std::map<uint256, uint32_t> mapIndex;
+    //! Headers whose parent has not come (yet), by the hash of that parent
+    std::multimap<uint256, uint32_t> mapUnknownParent;
+
+public:
+    explicit CBlockFileOrderer(std::function<void(const unsigned char*)> sinkIn) : sink(sinkIn) {}
+
+    void Add(const unsigned char* pheader)
+    {
+        uint256 hash = Hash(pheader, pheader + HEADER_SIZE);
+        if (mapIndex.count(hash))
+            return;
+        uint32_t nIndex = vHeaders.size();
+        if (nIndex == NO_PARENT)
+            throw std::runtime_error("Too many headers");
+        mapIndex.insert(std::make_pair(hash, nIndex));
+
+        CHeaderEntry entry;
+        memcpy(entry.header, pheader, HEADER_SIZE);
+        uint256 hashPrev;
+        memcpy(hashPrev.begin(), pheader + 4, 32);
+        std::map<uint256, uint32_t>::const_iterator itParent = mapIndex.find(hashPrev);
+        entry.nParent = itParent == mapIndex.end() ? NO_PARENT : itParent->second;
+        if (entry.nParent == NO_PARENT)
+            mapUnknownParent.insert(std::make_pair(hashPrev, nIndex));
+        vHeaders.push_back(entry);
+
+        std::pair<std::multimap<uint256, uint32_t>::iterator, std::multimap<uint256, uint32_t>::iterator> range = mapUnknownParent.equal_range(hash);
+        for (std::multimap<uint256, uint32_t>::iterator it = range.first; it != range.second; ++it)
+            vHeaders[it->second].nParent = nIndex;
+        mapUnknownParent.erase(range.first, range.second);
+    }
+
+    /** Pass the headers of the most-work chain to the sink. */
+    void Finish()
+    {
+        if (vHeaders.empty())
+            return;
+        // Anything else without a parent would be a second, disconnected
+        // chain, and replaying only one of them would quietly stop short.
+        if (mapUnknownParent.size() != 1)
+            throw std::runtime_error(strprintf("Headers form %u disconnected chains (missing block file?)", (unsigned int)mapUnknownParent.size()));
+        uint32_t nRoot = mapUnknownParent.begin()->second;
+
+        // Chain work, summed along parent links with an explicit stack since
+        // parents may be stored after their children.
+        std::vector<long double> vWork(vHeaders.size(), -1);
+        vWork[nRoot] = GetBlockWork(ReadLE32(vHeaders[nRoot].header + 72));
+        std::vector<uint32_t> vStack;
+        for (uint32_t i = 0; i < vHeaders.size(); i++) {
+            uint32_t n = i;
+            while (vWork[n] < 0) {
+                vStack.push_back(n);
+                n = vHeaders[n].nParent;
+            }
+            for (; !vStack.empty(); vStack.pop_back()) {
+                n = vStack.back();
+                vWork[n] = vWork[vHeaders[n].nParent] + GetBlockWork(ReadLE32(vHeaders[n].header + 72));
+            }
+        }
+
+        uint32_t nTip = std::max_element(vWork.begin(), vWork.end()) - vWork.begin();
+        std::vector<uint32_t> vChain;
+        for (uint32_t n = nTip; n != NO_PARENT; n = vHeaders[n].nParent)
+            vChain.push_back(n);
+        for (std::vector<uint32_t>::reverse_iterator it = vChain.rbegin(); it != vChain.rend(); ++it)
+            sink(vHeaders[*it].header);
+
+        std::vector<CHeaderEntry>().swap(vHeaders);
+        mapIndex.clear();
+        mapUnknownParent.clear();
+    }
+
+    void ReadFile(const std::string& strFile)
+    {
+        CMappedFile file(strFile);
+        const unsigned char* p = file.begin();
+        // Block files are preallocated, so they may end in zeros.
+        while (file.end() - p >= 8 && ReadLE32(p) != 0) {
+            uint32_t nSize = ReadLE32(p + 4);
+            if (nSize < HEADER_SIZE || (size_t)(file.end() - p - 8) < nSize)
+                throw std::runtime_error(strprintf("%s: truncated block at offset %u", strFile, (unsigned int)(p - file.begin())));
+            Add(p + 8);
+            p += 8 + nSize;
+        }
+    }
+};
+
+struct ReplayJob
+{
+    const CRetargetAlgorithm* palgorithm;
+    CReplayResult* presult;
+};
+
+void RunReplayJob(const Consensus::Params& params, const CHashrateHistory& history, uint64_t nSeed, const ReplayJob& job)
+{
+    CReplayHashrateModel hashrate(history);
+    const std::vector<std::pair<uint32_t, uint32_t> >& vSeed = history.GetSeed();
+    // Room for twice the blocks the target spacing would make of the
+    // history; an algorithm that outruns that is cut off there.
+    int64_t nCapacity = vSeed.size() + 2 * ((int64_t)history.GetEndTime() - history.GetStartTime()) / params.nPowTargetSpacing + 1000;
+    nCapacity = std::min<int64_t>(nCapacity, std::numeric_limits<int>::max() / 2);
+    CSimulator sim(params, *job.palgorithm, hashrate, nSeed, nCapacity);
+    sim.Reset(vSeed[0].first, vSeed[0].second);
+    for (size_t i = 1; i < vSeed.size(); i++)
+        sim.Append(vSeed[i].first, vSeed[i].second);
+    const CSimChain& chain = sim.GetChain();
+    while (sim.GetClock() < history.GetEndTime()) {
+        if (chain.Height() >= nCapacity) {
+            job.presult->fTruncated = true;
+            break;
+        }
+        sim.Step();
+    }
+
+    job.presult->palgorithm = job.palgorithm;
+    job.presult->stats = CSimStats::Compute(chain, params, hashrate, vSeed.size());
+    std::vector<CReplayDay>& vDays = job.presult->vDays;
+    for (int nHeight = 1; nHeight <= chain.Height(); nHeight++) {
+        const CBlockIndex& block = chain[nHeight];
+        size_t nDay = std::max<int64_t>(block.GetBlockTime() - history.GetStartTime(), 0) / SECONDS_PER_DAY;
+        if (nDay >= vDays.size())
+            vDays.resize(nDay + 1);
+        vDays[nDay].Add(block.GetBlockTime() - block.pprev->GetBlockTime(), GetDifficulty(block.nBits));
+    }
+}
+
+} // namespace
+
+void CHashrateHistory::AddHeader(const unsigned char* pheader)
+{
+    const uint32_t nTimeRaw = ReadLE32(pheader + 68);
+    const uint32_t nBits = ReadLE32(pheader + 72);
+    const size_t nHeader = vTime.size();
+    if (vSeed.size() < nSeedBlocks)
+        vSeed.push_back(std::make_pair(nTimeRaw, nBits));
+
+    // Timestamps may go backwards a little; the hashrate curve is laid out
+    // along their running maximum.
+    uint32_t nTime = nHeader ? std::max(nTimeRaw, vTime.back()) : nTimeRaw;
+    vTime.push_back(nTime);
+    if (nHeader) {
+        size_t nDay = (nTime - vTime.front()) / SECONDS_PER_DAY;
+        if (nDay >= vDays.size())
+            vDays.resize(nDay + 1);
+        vDays[nDay].Add((double)nTimeRaw - nTimeLast, GetDifficulty(nBits));
+    }
+    nTimeLast = nTimeRaw;
+
+    // The hashrate over the nWindow headers ending here belongs to the header
+    // in the middle of them; headers before the first middle share its value.
+    dWorkTotal += GetBlockWork(nBits);
+    vRing[nHeader % vRing.size()] = std::make_pair(nTime, dWorkTotal);
+    if (nHeader >= (size_t)nWindow) {
+        const std::pair<uint32_t, long double>& start = vRing[(nHeader - nWindow) % vRing.size()];
+        dHashrateLast = (double)((dWorkTotal - start.second) / std::max<uint32_t>(nTime - start.first, 1));
+        vHashrate.resize(nHeader - nWindow / 2 + 1, dHashrateLast);
+    }
+}
+
+void CHashrateHistory::Finish()
+{
+    if (vTime.size() < 2)
+        throw std::runtime_error("Need at least two headers to replay");
+    if (vHashrate.empty()) {
+        // Shorter than one window: one average over all of it.
+        const std::pair<uint32_t, long double>& start = vRing[0];
+        dHashrateLast = (double)((dWorkTotal - start.second) / std::max<uint32_t>(vTime.back() - start.first, 1));
+    }
+    vHashrate.resize(vTime.size(), dHashrateLast);
+    std::vector<std::pair<uint32_t, long double> >().swap(vRing);
+}
+
+void CHashrateHistory::Read(const std::string& strPath)
+{
+    vRing.assign(nWindow + 1, std::make_pair(0, 0.0L));
+    CBlockFileOrderer orderer([this](const unsigned char* pheader) { AddHeader(pheader); });
+    try {
+        if (boost::filesystem::is_directory(strPath)) {
+            std::vector<std::string> vFiles;
+            for (boost::filesystem::directory_iterator it(strPath); it != boost::filesystem::directory_iterator(); ++it) {
+                std::string strName = it->path().filename().string();
+                if (strName.size() == 12 && strName.compare(0, 3, "blk") == 0 && strName.compare(8, 4, ".dat") == 0)
+                    vFiles.push_back(it->path().string());
+            }
+            if (vFiles.empty())
+                throw std::runtime_error(strprintf("No blk?????.dat files in %s", strPath));
+            std::sort(vFiles.begin(), vFiles.end());
+            for (const std::string& strFile : vFiles)
+                orderer.ReadFile(strFile);
+        } else {
+            CMappedFile file(strPath);
+            if (IsBlockFile(file)) {
+                orderer.ReadFile(strPath);
+            } else {
+                if (file.size() % HEADER_SIZE)
+                    throw std::runtime_error(strprintf("%s is neither a block file nor a whole number of %u-byte headers", strPath, (unsigned int)HEADER_SIZE));
+                for (const unsigned char* p = file.begin(); p != file.end(); p += HEADER_SIZE)
+                    AddHeader(p);
+            }
+        }
+    } catch (const boost::filesystem::filesystem_error& e) {
+        throw std::runtime_error(e.what());
+    }
+    orderer.Finish();
+    Finish();
+}
+
+double CHashrateHistory::GetHashrate(int64_t nTime, size_t& nHint) const
+{
+    // The simulator asks in nearly increasing time order, a few samples on
+    // at a time.
+    static const size_t MAX_SCAN = 16;
+    size_t n = std::min(nHint, vTime.size() - 1);
+    if (vTime[n] <= nTime) {
+        size_t nScanEnd = std::min(n + MAX_SCAN, vTime.size() - 1);
+        while (n < nScanEnd && vTime[n + 1] <= nTime)
+            n++;
+        if (n == nScanEnd && n + 1 < vTime.size() && vTime[n + 1] <= nTime)
+            n = std::upper_bound(vTime.begin() + n, vTime.end(), nTime, [](int64_t nValue, uint32_t nSample) { return nValue < nSample; }) - vTime.begin() - 1;
+    } else {
+        std::vector<uint32_t>::const_iterator it = std::upper_bound(vTime.begin(), vTime.begin() + n, nTime, [](int64_t nValue, uint32_t nSample) { return nValue < nSample; });
+        n = it == vTime.begin() ? 0 : it - vTime.begin() - 1;
+    }
+    nHint = n;
+    return vHashrate[n];
+}
+
+std::vector<CReplayResult> RunReplays(const Consensus::Params& params, const CHashrateHistory& history, const std::vector<const CRetargetAlgorithm*>& vAlgorithms, uint64_t nSeed, int nThreads)
+{
+    std::vector<CReplayResult> vResults(vAlgorithms.size());
+    std::vector<ReplayJob> vJobs;
+    for (size_t i = 0; i < vAlgorithms.size(); i++)
+        vJobs.push_back(ReplayJob{vAlgorithms[i], &vResults[i]});
+
+    RunJobs(vJobs.size(), nThreads, [&](size_t nJob) {
+        RunReplayJob(params, history, nSeed, vJobs[nJob]);
+    });
+    return vResults;
+}
@@ -0,0 +1,129 @@
+// Copyright (c) 2017 The Litebench developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_SIM_REPLAY_H
+#define BITCOIN_SIM_REPLAY_H
+
+#include "consensus/params.h"
+#include "retarget.h"
+#include "sim/simulator.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/** Default number of headers the observed hashrate is averaged over */
+static const int DEFAULT_REPLAY_WINDOW = 120;
+/** Default number of leading headers copied verbatim into every replayed chain */
+static const int DEFAULT_REPLAY_SEED_BLOCKS = 2016;
+
+/** Blocks, block times and difficulty of one day of a chain, for the replay time series. */
+struct CReplayDay
+{
+    int nBlocks;
+    double dSolveTimeSum;
+    double dDifficultySum;
+
+    CReplayDay() : nBlocks(0), dSolveTimeSum(0), dDifficultySum(0) {}
+
+    void Add(double dSolveTime, double dDifficulty)
+    {
+        nBlocks++;
+        dSolveTimeSum += dSolveTime;
+        dDifficultySum += dDifficulty;
+    }
+};
+
+/**
+ * The hashrate a real chain saw, reconstructed from its headers: at every
+ * header, the work its targets imply over a window of nWindow headers
+ * centred on it, divided by the time that window took.
+ *
+ * Headers are read from a raw dump (consecutive 80-byte headers in chain
+ * order), from a blk*.dat block file, or from a directory of them. Either way
+ * the input is memory-mapped and streamed through once; what is kept is one
+ * (time, hashrate) sample per header plus the first few headers themselves,
+ * which replays start from. Block files store blocks in arrival order, so a
+ * block whose parent has not been seen yet is held back until it has; of
+ * two children of one block, the first seen is followed.
+ */
+class CHashrateHistory
+{
+private:
+    //! Header times, made non-decreasing, and the hashrate from each time on
+    std::vector<uint32_t> vTime;
+    std::vector<double> vHashrate;
+    //! The first headers of the chain, as (nTime, nBits)
+    std::vector<std::pair<uint32_t, uint32_t> > vSeed;
+    //! What the real chain did, per day since its first header
+    std::vector<CReplayDay> vDays;
+    const int nWindow;
+    const size_t nSeedBlocks;
+
+    //! Non-decreasing time and cumulative work of the last nWindow+1 headers, by header number modulo nWindow+1
+    std::vector<std::pair<uint32_t, long double> > vRing;
+    long double dWorkTotal;
+    uint32_t nTimeLast;
+    double dHashrateLast;
+
+    void AddHeader(const unsigned char* pheader);
+    void Finish();
+
+public:
+    CHashrateHistory(int nWindowIn, int nSeedBlocksIn) : nWindow(nWindowIn), nSeedBlocks(nSeedBlocksIn), dWorkTotal(0), nTimeLast(0), dHashrateLast(0) {}
+
+    /** Read a raw header dump, a block file or a directory of block files; throws std::runtime_error. */
+    void Read(const std::string& strPath);
+
+    size_t Headers() const { return vTime.size(); }
+    uint32_t GetStartTime() const { return vTime.front(); }
+    uint32_t GetEndTime() const { return vTime.back(); }
+
+    /**
+     * Hashrate at nTime, seconds since the epoch. nHint is the sample the
+     * caller's last lookup landed on; lookups at times close after it are
+     * resolved by scanning forward from there instead of by binary search.
+     */
+    double GetHashrate(int64_t nTime, size_t& nHint) const;
+
+    /** (nTime, nBits) of the first headers, up to the seed count given at construction. */
+    const std::vector<std::pair<uint32_t, uint32_t> >& GetSeed() const { return vSeed; }
+
+    const std::vector<CReplayDay>& GetDays() const { return vDays; }
+};
+
+/** Hashrate model replaying a CHashrateHistory from its first header on. */
+class CReplayHashrateModel : public CHashrateModel
+{
+private:
+    const CHashrateHistory& history;
+    mutable size_t nHint;
+
+public:
+    explicit CReplayHashrateModel(const CHashrateHistory& historyIn) : CHashrateModel(0), history(historyIn), nHint(0) {}
+
+    double GetHashrate(int64_t nElapsed) const override { return history.GetHashrate(history.GetStartTime() + nElapsed, nHint); }
+};
+
+/** What one algorithm made of a replayed history. */
+struct CReplayResult
+{
+    const CRetargetAlgorithm* palgorithm;
+    //! Over the blocks after the seed
+    CSimStats stats;
+    std::vector<CReplayDay> vDays;
+    //! The run stopped at its block capacity before the history ended
+    bool fTruncated;
+
+    CReplayResult() : palgorithm(NULL), fTruncated(false) {}
+};
+
+/**
+ * Replay history through each of vAlgorithms, spread across nThreads threads:
+ * every chain starts with the history's seed headers, then is mined by the
+ * simulator under the observed hashrate until the history's last timestamp.
+ */
+std::vector<CReplayResult> RunReplays(const Consensus::Params& params, const CHashrateHistory& history, const std::vector<const CRetargetAlgorithm*>& vAlgorithms, uint64_t nSeed, int nThreads);
+
+#endif // BITCOIN_SIM_REPLAY_H
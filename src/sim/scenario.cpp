@@ -0,0 +1,221 @@
+// Copyright (c) 2017 The Litebench developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "sim/scenario.h"
+
+#include "tinyformat.h"
+#include "utilstrencodings.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/filesystem.hpp>
+
+/** The total hashrate never drops below this multiple of the base. */
+static const double MIN_SCENARIO_FACTOR = 0.000001;
+
+namespace {
+
+bool ParseScenarioTime(std::string str, int64_t& nTime)
+{
+    int64_t nUnit = 1;
+    if (!str.empty()) {
+        switch (str[str.size() - 1]) {
+        case 's': nUnit = 1; break;
+        case 'm': nUnit = 60; break;
+        case 'h': nUnit = 60 * 60; break;
+        case 'd': nUnit = 24 * 60 * 60; break;
+        default: nUnit = 0;
+        }
+        if (nUnit)
+            str.erase(str.size() - 1);
+        else
+            nUnit = 1;
+    }
+    double dTime;
+    if (!ParseDouble(str, &dTime) || dTime < 0 || dTime * nUnit > (double)std::numeric_limits<uint32_t>::max())
+        return false;
+    nTime = (int64_t)(dTime * nUnit);
+    return true;
+}
+
+class CScenarioLine
+{
+private:
+    const std::vector<std::string>& vWords;
+    int nLine;
+
+public:
+    CScenarioLine(const std::vector<std::string>& vWordsIn, int nLineIn) : vWords(vWordsIn), nLine(nLineIn) {}
+
+    std::runtime_error Error(const std::string& strWhat) const
+    {
+        return std::runtime_error(strprintf("line %d: %s", nLine, strWhat));
+    }
+
+    void CheckArgs(size_t nMin, size_t nMax) const
+    {
+        if (vWords.size() - 1 < nMin || vWords.size() - 1 > nMax)
+            throw Error(strprintf("'%s' takes %s arguments", vWords[0], nMin == nMax ? strprintf("%u", nMin) : strprintf("%u to %u", nMin, nMax)));
+    }
+
+    int64_t Time(size_t nArg) const
+    {
+        int64_t nTime;
+        if (!ParseScenarioTime(vWords[nArg], nTime))
+            throw Error(strprintf("invalid time '%s'", vWords[nArg]));
+        return nTime;
+    }
+
+    double Number(size_t nArg, double dMin, double dMax) const
+    {
+        double d;
+        if (!ParseDouble(vWords[nArg], &d) || d < dMin || d > dMax)
+            throw Error(strprintf("invalid value '%s' (expected %g to %g)", vWords[nArg], dMin, dMax));
+        return d;
+    }
+};
+
+} // namespace
+
+CScenario CScenario::Parse(const std::string& strText, const std::string& strDefaultName)
+{
+    CScenario scenario(strDefaultName);
+    std::istringstream stream(strText);
+    std::string strLine;
+    for (int nLine = 1; std::getline(stream, strLine); nLine++) {
+        strLine = strLine.substr(0, strLine.find('#'));
+        boost::trim(strLine);
+        if (strLine.empty())
+            continue;
+        std::vector<std::string> vWords;
+        boost::split(vWords, strLine, boost::is_any_of(" \t\r"), boost::token_compress_on);
+        CScenarioLine line(vWords, nLine);
+        const std::string& strDirective = vWords[0];
+
+        if (strDirective == "name") {
+            line.CheckArgs(1, 1);
+            scenario.strName = vWords[1];
+        } else if (strDirective == "step" || strDirective == "ramp") {
+            line.CheckArgs(2, 2);
+            Point point{line.Time(1), line.Number(2, 0, 1e9), strDirective == "ramp"};
+            if (!scenario.vPoints.empty() && point.nTime < scenario.vPoints.back().nTime)
+                throw line.Error("step and ramp times must not go backwards");
+            scenario.vPoints.push_back(point);
+        } else if (strDirective == "onoff") {
+            line.CheckArgs(5, 5);
+            OnOff onoff{line.Time(1), line.Time(2), line.Time(3), line.Number(4, 0, 1), line.Number(5, 0, 1e9)};
+            if (onoff.nEnd <= onoff.nStart || onoff.nPeriod <= 0)
+                throw line.Error("onoff needs start < end and a positive period");
+            scenario.vOnOff.push_back(onoff);
+        } else if (strDirective == "diurnal") {
+            line.CheckArgs(1, 2);
+            scenario.dDiurnalAmplitude = line.Number(1, 0, 0.999);
+            if (vWords.size() > 2)
+                scenario.nDiurnalPeriod = line.Time(2);
+            if (scenario.nDiurnalPeriod <= 0)
+                throw line.Error("diurnal period must be positive");
+        } else if (strDirective == "join" || strDirective == "leave") {
+            line.CheckArgs(2, 2);
+            double dFactor = line.Number(2, 0, 1e9);
+            scenario.vMiners.push_back(Point{line.Time(1), strDirective == "join" ? dFactor : -dFactor, false});
+        } else if (strDirective == "skew") {
+            line.CheckArgs(3, 3);
+            double dOffset = line.Number(3, -1e9, 1e9);
+            Skew skew{line.Time(1), line.Number(2, 0, 1), (int64_t)dOffset};
+            if (!scenario.vSkews.empty() && skew.nTime < scenario.vSkews.back().nTime)
+                throw line.Error("skew times must not go backwards");
+            scenario.vSkews.push_back(skew);
+        } else {
+            throw line.Error(strprintf("unknown directive '%s'", strDirective));
+        }
+    }
+    std::stable_sort(scenario.vMiners.begin(), scenario.vMiners.end(), [](const Point& a, const Point& b) { return a.nTime < b.nTime; });
+    return scenario;
+}
+
+CScenario CScenario::Read(const std::string& strFile)
+{
+    std::ifstream file(strFile.c_str());
+    if (!file)
+        throw std::runtime_error(strprintf("Cannot open scenario file %s", strFile));
+    std::stringstream ss;
+    ss << file.rdbuf();
+    try {
+        return Parse(ss.str(), boost::filesystem::path(strFile).stem().string());
+    } catch (const std::runtime_error& e) {
+        throw std::runtime_error(strprintf("%s: %s", strFile, e.what()));
+    }
+}
+
+bool CScenario::GetBuiltin(const std::string& strName, int64_t nEventTime, double dStepFactor, CScenario& scenario)
+{
+    scenario = CScenario(strName);
+    if (strName == "constant")
+        return true;
+    if (strName == "step" || strName == "drop") {
+        scenario.vPoints.push_back(Point{nEventTime, strName == "step" ? dStepFactor : 1 / dStepFactor, false});
+        return true;
+    }
+    return false;
+}
+
+double CScenario::GetFactor(int64_t nElapsed) const
+{
+    // Base multiplier: hold the last point reached, or interpolate towards the
+    // next one if that is a ramp.
+    auto it = std::upper_bound(vPoints.begin(), vPoints.end(), nElapsed, [](int64_t n, const Point& point) { return n < point.nTime; });
+    int64_t nPrevTime = it == vPoints.begin() ? 0 : (it - 1)->nTime;
+    double dFactor = it == vPoints.begin() ? 1 : (it - 1)->dFactor;
+    if (it != vPoints.end() && it->fRamp && it->nTime > nPrevTime)
+        dFactor += (it->dFactor - dFactor) * (nElapsed - nPrevTime) / (it->nTime - nPrevTime);
+
+    for (const Point& miner : vMiners) {
+        if (miner.nTime > nElapsed)
+            break;
+        dFactor += miner.dFactor;
+    }
+    for (const OnOff& onoff : vOnOff) {
+        if (nElapsed >= onoff.nStart && nElapsed < onoff.nEnd && (nElapsed - onoff.nStart) % onoff.nPeriod < onoff.dDuty * onoff.nPeriod)
+            dFactor += onoff.dFactor;
+    }
+    if (dDiurnalAmplitude > 0)
+        dFactor *= 1 + dDiurnalAmplitude * sin(2 * M_PI * nElapsed / nDiurnalPeriod);
+    return std::max(dFactor, MIN_SCENARIO_FACTOR);
+}
+
+int64_t CScenario::GetEventTime() const
+{
+    int64_t nEventTime = std::numeric_limits<int64_t>::max();
+    if (!vPoints.empty())
+        nEventTime = vPoints[0].fRamp ? 0 : vPoints[0].nTime;
+    if (!vMiners.empty())
+        nEventTime = std::min(nEventTime, vMiners[0].nTime);
+    for (const OnOff& onoff : vOnOff)
+        nEventTime = std::min(nEventTime, onoff.nStart);
+    return nEventTime == std::numeric_limits<int64_t>::max() ? -1 : nEventTime;
+}
+
+const CScenario::Skew* CScenario::GetSkew(int64_t nElapsed) const
+{
+    auto it = std::upper_bound(vSkews.begin(), vSkews.end(), nElapsed, [](int64_t n, const Skew& skew) { return n < skew.nTime; });
+    if (it == vSkews.begin() || (it - 1)->dFraction <= 0)
+        return NULL;
+    return &*(it - 1);
+}
+
+bool CScenarioHashrateModel::GetTimestampSkew(int64_t nElapsed, double& dFraction, int64_t& nOffset) const
+{
+    const CScenario::Skew* pskew = scenario.GetSkew(nElapsed);
+    if (!pskew)
+        return false;
+    dFraction = pskew->dFraction;
+    nOffset = pskew->nOffset;
+    return true;
+}
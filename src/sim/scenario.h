@@ -0,0 +1,114 @@
+// Copyright (c) 2017 The Litebench developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_SIM_SCENARIO_H
+#define BITCOIN_SIM_SCENARIO_H
+
+#include "sim/simulator.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * A scripted hashrate scenario: how the hashrate pointed at a chain changes
+ * over time, as multiples of a base hashrate, and which share of blocks carry
+ * manipulated timestamps. Scenarios are read from text files, one directive
+ * per line; blank lines and anything after a '#' are ignored. Times are
+ * seconds after the start of the run, and take an optional m, h or d suffix.
+ *
+ *   name <name>                       name used in reports (default: the file name)
+ *   step <time> <factor>              base multiplier jumps to <factor> at <time>
+ *   ramp <time> <factor>              base multiplier moves linearly from the previous
+ *                                     point to <factor>, reached at <time>
+ *   onoff <start> <end> <period> <duty> <factor>
+ *                                     multipool: from <start> to <end>, <factor> times the base
+ *                                     hashrate is added for the first <duty> fraction of every <period>
+ *   diurnal <amplitude> [<period>]    everything is multiplied by 1 + amplitude * sin(2 pi t / period)
+ *                                     (period default: 1d)
+ *   join <time> <factor>              a miner of <factor> times the base hashrate joins at <time>
+ *   leave <time> <factor>             a miner of <factor> times the base hashrate leaves at <time>
+ *   skew <time> <fraction> <offset>   from <time> on, <fraction> of blocks are stamped <offset> seconds
+ *                                     from the clock, within what consensus accepts
+ *
+ * The base multiplier starts at 1. The total never drops below a millionth of
+ * the base hashrate, so a chain whose miners all leave stalls rather than
+ * stops.
+ */
+class CScenario
+{
+public:
+    struct Point
+    {
+        int64_t nTime;
+        double dFactor;
+        bool fRamp;
+    };
+
+    struct OnOff
+    {
+        int64_t nStart;
+        int64_t nEnd;
+        int64_t nPeriod;
+        double dDuty;
+        double dFactor;
+    };
+
+    struct Skew
+    {
+        int64_t nTime;
+        double dFraction;
+        int64_t nOffset;
+    };
+
+    std::string strName;
+    //! Base multiplier points, in time order
+    std::vector<Point> vPoints;
+    std::vector<OnOff> vOnOff;
+    //! Joins (positive factor) and leaves (negative factor), in time order
+    std::vector<Point> vMiners;
+    std::vector<Skew> vSkews;
+    double dDiurnalAmplitude;
+    int64_t nDiurnalPeriod;
+
+    explicit CScenario(const std::string& strNameIn = "constant") : strName(strNameIn), dDiurnalAmplitude(0), nDiurnalPeriod(24 * 60 * 60) {}
+
+    /** Parse scenario text; throws std::runtime_error naming the offending line. */
+    static CScenario Parse(const std::string& strText, const std::string& strDefaultName);
+
+    /** Read and parse a scenario file. */
+    static CScenario Read(const std::string& strFile);
+
+    /**
+     * The scenarios litebench-sim -sweep has built in: constant, step (hashrate
+     * multiplied by dStepFactor at nEventTime) and drop (divided by it).
+     * Returns false if strName is not one of them.
+     */
+    static bool GetBuiltin(const std::string& strName, int64_t nEventTime, double dStepFactor, CScenario& scenario);
+
+    /** Multiple of the base hashrate nElapsed seconds after the start. */
+    double GetFactor(int64_t nElapsed) const;
+
+    /** Time of the first change to the hashrate, or -1 if it never changes. */
+    int64_t GetEventTime() const;
+
+    /** The timestamp skew in force nElapsed seconds after the start, or NULL. */
+    const Skew* GetSkew(int64_t nElapsed) const;
+};
+
+/** Hashrate model following a scenario, relative to a base hashrate. */
+class CScenarioHashrateModel : public CHashrateModel
+{
+private:
+    const CScenario& scenario;
+
+public:
+    CScenarioHashrateModel(const CScenario& scenarioIn, double dHashrateIn) : CHashrateModel(dHashrateIn), scenario(scenarioIn) {}
+
+    double GetHashrate(int64_t nElapsed) const override { return dHashrate * scenario.GetFactor(nElapsed); }
+    int64_t GetEventTime() const override { return scenario.GetEventTime(); }
+    bool GetTimestampSkew(int64_t nElapsed, double& dFraction, int64_t& nOffset) const override;
+};
+
+#endif // BITCOIN_SIM_SCENARIO_H
@@ -0,0 +1,177 @@
+// Copyright (c) 2017 The Litebench developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "sim/simulator.h"
+
+#include "pow.h"
+#include "primitives/block.h"
+#include "telemetry.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+CSimChain::CSimChain(int nCapacity)
+{
+    vIndex.reserve(nCapacity + 1);
+    vTime.reserve(nCapacity + 1);
+}
+
+void CSimChain::Reset(uint32_t nTime, uint32_t nBits)
+{
+    vIndex.clear();
+    vTime.assign(1, nTime);
+    vIndex.emplace_back();
+    CBlockIndex& genesis = vIndex.back();
+    genesis.nHeight = 0;
+    genesis.nTime = nTime;
+    genesis.nBits = nBits;
+    genesis.nTimeMax = nTime;
+}
+
+CBlockIndex* CSimChain::Append(uint32_t nTime, uint32_t nBits)
+{
+    assert(!vIndex.empty());
+    // Growing past the reservation would move every entry and leave the
+    // pprev pointers dangling.
+    assert(vIndex.size() < vIndex.capacity());
+    CBlockIndex* pprev = &vIndex.back();
+    vIndex.emplace_back();
+    CBlockIndex* pindex = &vIndex.back();
+    pindex->pprev = pprev;
+    pindex->nHeight = pprev->nHeight + 1;
+    pindex->nTime = nTime;
+    pindex->nBits = nBits;
+    pindex->nTimeMax = std::max(pprev->nTimeMax, nTime);
+    vTime.push_back(nTime);
+    return pindex;
+}
+
+CSimStats CSimStats::Compute(const CSimChain& chain, const Consensus::Params& params, const CHashrateModel& hashrate, int nFirstHeight)
+{
+    CSimStats stats;
+    nFirstHeight = std::max(nFirstHeight, 1);
+    if (chain.Height() < nFirstHeight)
+        return stats;
+
+    const int64_t nStartTime = chain[0].GetBlockTime();
+    const int64_t nEventTime = hashrate.GetEventTime();
+    double dSum = 0, dSumSq = 0, dDiffSum = 0, dDevSum = 0, dDevSumSq = 0;
+    stats.dMinDifficulty = std::numeric_limits<double>::max();
+    for (int nHeight = nFirstHeight; nHeight <= chain.Height(); nHeight++) {
+        const CBlockIndex& block = chain[nHeight];
+        int64_t nElapsed = block.pprev->GetBlockTime() - nStartTime;
+        double dSolve = (double)block.GetBlockTime() - (double)block.pprev->GetBlockTime();
+        double dDifficulty = GetDifficulty(block.nBits);
+        dSum += dSolve;
+        dSumSq += dSolve * dSolve;
+        dDiffSum += dDifficulty;
+        stats.dMinDifficulty = std::min(stats.dMinDifficulty, dDifficulty);
+        stats.dMaxDifficulty = std::max(stats.dMaxDifficulty, dDifficulty);
+
+        double dExpected = GetBlockWork(block.nBits) / hashrate.GetHashrate(nElapsed) / params.nPowTargetSpacing;
+        double dDev = log(dExpected);
+        dDevSum += dDev;
+        dDevSumSq += dDev * dDev;
+        if (nEventTime >= 0 && stats.nRecoveryTime < 0 && nElapsed >= nEventTime && fabs(dDev) <= log(1.1))
+            stats.nRecoveryTime = nElapsed - nEventTime;
+    }
+    stats.nBlocks = chain.Height() - nFirstHeight + 1;
+    stats.dMeanBlockTime = dSum / stats.nBlocks;
+    stats.dStdDevBlockTime = sqrt(std::max(0.0, dSumSq / stats.nBlocks - stats.dMeanBlockTime * stats.dMeanBlockTime));
+    stats.dMeanDifficulty = dDiffSum / stats.nBlocks;
+    double dDevMean = dDevSum / stats.nBlocks;
+    stats.dOscillation = sqrt(std::max(0.0, dDevSumSq / stats.nBlocks - dDevMean * dDevMean));
+    stats.nElapsed = chain.Tip()->GetBlockTime() - chain[nFirstHeight - 1].GetBlockTime();
+    return stats;
+}
+
+CSimulator::CSimulator(const Consensus::Params& paramsIn, const CRetargetAlgorithm& algorithmIn, const CHashrateModel& hashrateIn, uint64_t nSeed, int nCapacity)
+    : params(paramsIn), algorithm(algorithmIn), hashrate(hashrateIn), pattacker(NULL), ptelemetry(NULL), rng(true), chain(nCapacity), dClock(0), nStartTime(0)
+{
+    rng.Seed(nSeed);
+}
+
+int64_t CSimulator::GetClock() const
+{
+    // A runaway target can push the clock past what nTime can hold.
+    return (int64_t)std::min(dClock, (double)std::numeric_limits<uint32_t>::max());
+}
+
+void CSimulator::Reset(uint32_t nGenesisTime, uint32_t nGenesisBits)
+{
+    chain.Reset(nGenesisTime, nGenesisBits);
+    // The old instance may have cached the previous chain, whose entries the
+    // new one reuses the memory of.
+    retarget = algorithm.factory(params);
+    params.retarget = retarget.get();
+    nStartTime = nGenesisTime;
+    dClock = nGenesisTime;
+}
+
+double CSimulator::SampleSolveTime(uint32_t nBits, double dHashrateIn)
+{
+    assert(dHashrateIn > 0);
+    return -log(rng.randdouble()) * GetBlockWork(nBits) / dHashrateIn;
+}
+
+const CBlockIndex* CSimulator::Append(uint32_t nTime, uint32_t nBits)
+{
+    dClock = std::max(dClock, (double)nTime);
+    return chain.Append(nTime, nBits);
+}
+
+const CBlockIndex* CSimulator::Step()
+{
+    const CBlockIndex* pindexPrev = chain.Tip();
+    assert(pindexPrev && retarget);
+
+    // Honest miner: the header carries the current clock, but never less than
+    // what ContextualCheckBlockHeader accepts.
+    const int64_t nMinTime = chain.GetMedianTimePast(pindexPrev->nHeight) + 1;
+    CBlockHeader header;
+    header.nTime = std::max(nMinTime, GetClock());
+    header.nBits = GetNextWorkRequired(pindexPrev, &header, params);
+
+    dClock += SampleSolveTime(header.nBits, hashrate.GetHashrate(GetClock() - nStartTime));
+    header.nTime = std::max(nMinTime, GetClock());
+
+    // Skewing miner: the clock plus an offset, within the bounds
+    // ContextualCheckBlockHeader accepts with the clock as adjusted time.
+    double dFraction;
+    int64_t nOffset;
+    if (hashrate.GetTimestampSkew(GetClock() - nStartTime, dFraction, nOffset) && rng.randdouble() < dFraction) {
+        int64_t nTime = std::min(GetClock() + nOffset, GetClock() + MAX_FUTURE_BLOCK_TIME);
+        nTime = std::max(nTime, nMinTime);
+        header.nTime = std::min<int64_t>(nTime, std::numeric_limits<uint32_t>::max());
+    }
+
+    if (pattacker && rng.randdouble() < pattacker->GetFraction()) {
+        int64_t nMaxTime = std::max(GetClock() + MAX_FUTURE_BLOCK_TIME, nMinTime);
+        int64_t nTime = std::max(nMinTime, std::min(pattacker->GetBlockTime(pindexPrev, nMinTime, nMaxTime), nMaxTime));
+        header.nTime = std::min<int64_t>(nTime, std::numeric_limits<uint32_t>::max());
+    }
+
+    // Retargets that look at the block's own time (min-difficulty rules,
+    // DualKGW3's 12h rule) must see the timestamp actually stamped, or the
+    // block would carry bits ContextualCheckBlockHeader rejects.
+    header.nBits = GetNextWorkRequired(pindexPrev, &header, params);
+    CRetargetState state;
+    if (ptelemetry)
+        state = retarget->GetLastState();
+
+    const CBlockIndex* pindex = chain.Append(header.nTime, header.nBits);
+    if (ptelemetry) {
+        CRetargetRecord record;
+        record.Set(pindex, algorithm.nId, state);
+        ptelemetry->Append(record);
+    }
+    return pindex;
+}
+
+void CSimulator::Run(int nBlocks)
+{
+    for (int i = 0; i < nBlocks; i++)
+        Step();
+}
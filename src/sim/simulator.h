@@ -0,0 +1,180 @@
+// Copyright (c) 2017 The Litebench developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_SIM_SIMULATOR_H
+#define BITCOIN_SIM_SIMULATOR_H
+
+#include "chain.h"
+#include "consensus/params.h"
+#include "random.h"
+#include "retarget.h"
+
+#include <memory>
+#include <stdint.h>
+#include <vector>
+
+class CRetargetTelemetry;
+
+/** Default number of blocks simulated per run */
+static const int DEFAULT_SIM_BLOCKS = 10000;
+/** Default total hashrate pointed at the simulated chain, in hashes per second */
+static const double DEFAULT_SIM_HASHRATE = 100000;
+/** Default number of leading blocks left out of the statistics */
+static const int DEFAULT_SIM_WARMUP = 1000;
+
+/**
+ * Model of the total hashrate pointed at a simulated chain.
+ * The base model is a constant; scenarios derive from it.
+ */
+class CHashrateModel
+{
+protected:
+    double dHashrate;
+
+public:
+    explicit CHashrateModel(double dHashrateIn) : dHashrate(dHashrateIn) {}
+    virtual ~CHashrateModel() {}
+
+    /** Hashrate in hashes per second, nElapsed seconds after the start of the run. */
+    virtual double GetHashrate(int64_t nElapsed) const { return dHashrate; }
+
+    /** Time of the scenario's hashrate shock, in seconds after the start of the run, or -1 if there is none. */
+    virtual int64_t GetEventTime() const { return -1; }
+
+    /**
+     * Whether some miners skew block timestamps nElapsed seconds after the
+     * start; if so, dFraction of blocks are stamped nOffset seconds from the clock.
+     */
+    virtual bool GetTimestampSkew(int64_t nElapsed, double& dFraction, int64_t& nOffset) const { return false; }
+};
+
+/**
+ * A miner with a share of the hashrate who picks the timestamps of the blocks
+ * it finds to game the retarget, rather than reporting the clock.
+ */
+class CTimestampAttacker
+{
+public:
+    virtual ~CTimestampAttacker() {}
+
+    /** Share of the hashrate, and so of the blocks, the attacker has. */
+    virtual double GetFraction() const = 0;
+
+    /**
+     * nTime for the attacker's next block on top of pindexPrev. Anything from
+     * nMinTime (median time past + 1) to nMaxTime (the clock plus the
+     * future limit) is accepted by consensus; other values are clamped.
+     */
+    virtual int64_t GetBlockTime(const CBlockIndex* pindexPrev, int64_t nMinTime, int64_t nMaxTime) = 0;
+};
+
+/**
+ * A synthetic chain of block index entries kept in one contiguous allocation.
+ * Entries carry only what the retarget code looks at (height, nTime, nBits and
+ * the pprev linkage); there are no hashes, no block data and no database.
+ */
+class CSimChain
+{
+private:
+    //! Capacity is reserved up front, so pprev pointers into it stay valid.
+    std::vector<CBlockIndex> vIndex;
+    //! nTime of vIndex by height, for median time past without striding over whole entries
+    std::vector<uint32_t> vTime;
+
+public:
+    explicit CSimChain(int nCapacity);
+
+    /** Start the chain with a genesis entry. */
+    void Reset(uint32_t nTime, uint32_t nBits);
+
+    /** Append a block on top of the tip. */
+    CBlockIndex* Append(uint32_t nTime, uint32_t nBits);
+
+    const CBlockIndex* Tip() const { return vIndex.empty() ? NULL : &vIndex.back(); }
+    int Height() const { return (int)vIndex.size() - 1; }
+    const CBlockIndex& operator[](int nHeight) const { return vIndex[nHeight]; }
+
+    /** Median time past of the block at nHeight. */
+    int64_t GetMedianTimePast(int nHeight) const { return ::GetMedianTimePast(vTime.data(), nHeight); }
+};
+
+/** Summary statistics of a simulated run. */
+struct CSimStats
+{
+    int nBlocks;
+    double dMeanBlockTime;
+    double dStdDevBlockTime;
+    double dMinDifficulty;
+    double dMaxDifficulty;
+    double dMeanDifficulty;
+    //! Standard deviation of ln(expected solve time / target spacing): how far,
+    //! and how persistently, difficulty swings around the hashrate's equilibrium.
+    double dOscillation;
+    //! Seconds from the hashrate event until the expected solve time is back
+    //! within 10% of the target spacing; -1 if it never is, or there is no event.
+    int64_t nRecoveryTime;
+    int64_t nElapsed;
+
+    CSimStats() : nBlocks(0), dMeanBlockTime(0), dStdDevBlockTime(0), dMinDifficulty(0), dMaxDifficulty(0), dMeanDifficulty(0), dOscillation(0), nRecoveryTime(-1), nElapsed(0) {}
+
+    /** Compute over the blocks of chain from nFirstHeight up to the tip. */
+    static CSimStats Compute(const CSimChain& chain, const Consensus::Params& params, const CHashrateModel& hashrate, int nFirstHeight = 1);
+};
+
+/**
+ * Offline retarget simulator. Builds a chain block by block: the retarget code
+ * picks nBits for the next block exactly as it would in the node, then a solve
+ * time is drawn from the exponential distribution implied by that target and
+ * the hashrate model. No hashing is done.
+ */
+class CSimulator
+{
+private:
+    //! Copy of the chain's params, bound to this simulation's own retarget instance
+    Consensus::Params params;
+    const CRetargetAlgorithm& algorithm;
+    std::unique_ptr<CRetarget> retarget;
+    const CHashrateModel& hashrate;
+    CTimestampAttacker* pattacker;
+    CRetargetTelemetry* ptelemetry;
+    FastRandomContext rng;
+    CSimChain chain;
+    //! Simulated wall clock, in seconds since the epoch
+    double dClock;
+    int64_t nStartTime;
+
+public:
+    CSimulator(const Consensus::Params& paramsIn, const CRetargetAlgorithm& algorithmIn, const CHashrateModel& hashrateIn, uint64_t nSeed, int nCapacity);
+
+    /** Start over from a genesis block with the given time and bits, with a fresh retarget instance. */
+    void Reset(uint32_t nGenesisTime, uint32_t nGenesisBits);
+
+    /** Have pattackerIn (which must outlive the simulator) mine its share of the blocks; NULL for none. */
+    void SetAttacker(CTimestampAttacker* pattackerIn) { pattacker = pattackerIn; }
+
+    /** Append a record for every block mined to ptelemetryIn (which must outlive the simulator); NULL for none. */
+    void SetTelemetry(CRetargetTelemetry* ptelemetryIn) { ptelemetry = ptelemetryIn; }
+
+    /** Draw the time in seconds needed to solve a block at nBits with the given hashrate. */
+    double SampleSolveTime(uint32_t nBits, double dHashrateIn);
+
+    /** Current simulated time, in seconds since the epoch. */
+    int64_t GetClock() const;
+
+    /**
+     * Append a block with the given time and bits instead of mining one, and
+     * move the clock up to its time: for starting a chain from real history.
+     */
+    const CBlockIndex* Append(uint32_t nTime, uint32_t nBits);
+
+    /** Mine one simulated block on top of the tip. */
+    const CBlockIndex* Step();
+
+    /** Mine nBlocks simulated blocks. */
+    void Run(int nBlocks);
+
+    const CSimChain& GetChain() const { return chain; }
+};
+
+#endif // BITCOIN_SIM_SIMULATOR_H
@@ -0,0 +1,141 @@
+// Copyright (c) 2017 The Litebench developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "sim/sweep.h"
+
+#include "random.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <exception>
+#include <mutex>
+
+#include <boost/thread.hpp>
+
+void CRunningStat::Push(double dValue)
+{
+    nCount++;
+    double dDelta = dValue - dMean;
+    dMean += dDelta / nCount;
+    dM2 += dDelta * (dValue - dMean);
+}
+
+double CRunningStat::StdDev() const
+{
+    return nCount > 1 ? sqrt(dM2 / (nCount - 1)) : 0;
+}
+
+namespace {
+
+/** Hands out the jobs of one RunJobs call and keeps the first error. */
+class CJobRunner
+{
+private:
+    const size_t nJobs;
+    const std::function<void(size_t)>& job;
+    //! Next job to hand out; idle workers claim jobs from here one at a time.
+    std::atomic<size_t> nNextJob;
+    std::mutex cs;
+    std::exception_ptr error;
+
+public:
+    CJobRunner(size_t nJobsIn, const std::function<void(size_t)>& jobIn) : nJobs(nJobsIn), job(jobIn), nNextJob(0) {}
+
+    void Worker()
+    {
+        try {
+            while (true) {
+                size_t nJob = nNextJob++;
+                if (nJob >= nJobs)
+                    return;
+                job(nJob);
+            }
+        } catch (...) {
+            // Escaping a worker thread would terminate the process: keep the
+            // first error to rethrow after the join, and hand out no more jobs.
+            std::lock_guard<std::mutex> lock(cs);
+            if (!error)
+                error = std::current_exception();
+            nNextJob = nJobs;
+        }
+    }
+
+    //! Rethrow the first error a worker ran into, once all have been joined.
+    void RethrowError()
+    {
+        if (error)
+            std::rethrow_exception(error);
+    }
+};
+
+struct SweepJob
+{
+    const CRetargetAlgorithm* palgorithm;
+    size_t nScenario;
+    int nTrial;
+};
+
+void RunSweepJob(const Consensus::Params& params, uint32_t nGenesisTime, uint32_t nGenesisBits, const CSweepConfig& config, const SweepJob& job, CSimStats& stats)
+{
+    CScenarioHashrateModel hashrate(config.vScenarios[job.nScenario], config.dHashrate);
+
+    uint64_t nSeed = MixSeed(MixSeed(config.nSeed ^ ((uint64_t)job.nScenario << 32)) ^ (uint64_t)job.nTrial);
+    CSimulator sim(params, *job.palgorithm, hashrate, nSeed, config.nBlocks);
+    sim.Reset(nGenesisTime, nGenesisBits);
+    sim.Run(config.nBlocks);
+    stats = CSimStats::Compute(sim.GetChain(), params, hashrate, config.nWarmup + 1);
+}
+
+} // namespace
+
+void RunJobs(size_t nJobs, int nThreads, std::function<void(size_t)> job)
+{
+    CJobRunner runner(nJobs, job);
+    nThreads = std::max(1, std::min(nThreads, (int)nJobs));
+    boost::thread_group threadGroup;
+    for (int i = 0; i < nThreads; i++)
+        threadGroup.create_thread(boost::bind(&CJobRunner::Worker, &runner));
+    threadGroup.join_all();
+    runner.RethrowError();
+}
+
+std::vector<CSweepResult> RunSweep(const Consensus::Params& params, uint32_t nGenesisTime, uint32_t nGenesisBits, const CSweepConfig& config)
+{
+    // Trials are the innermost loop so that consecutive jobs, which tend to
+    // run concurrently, cost about the same.
+    std::vector<SweepJob> vJobs;
+    for (const CRetargetAlgorithm* palgorithm : config.vAlgorithms)
+        for (size_t nScenario = 0; nScenario < config.vScenarios.size(); nScenario++)
+            for (int nTrial = 0; nTrial < config.nTrials; nTrial++)
+                vJobs.push_back(SweepJob{palgorithm, nScenario, nTrial});
+
+    // Every job owns one slot, so workers never share mutable state.
+    std::vector<CSimStats> vStats(vJobs.size());
+    RunJobs(vJobs.size(), config.nThreads, [&](size_t nJob) {
+        RunSweepJob(params, nGenesisTime, nGenesisBits, config, vJobs[nJob], vStats[nJob]);
+    });
+
+    std::vector<CSweepResult> vResults;
+    for (size_t nJob = 0; nJob < vJobs.size(); nJob++) {
+        const SweepJob& job = vJobs[nJob];
+        const CSimStats& stats = vStats[nJob];
+        if (job.nTrial == 0) {
+            vResults.emplace_back();
+            vResults.back().palgorithm = job.palgorithm;
+            vResults.back().strScenario = config.vScenarios[job.nScenario].strName;
+            vResults.back().fEvent = config.vScenarios[job.nScenario].GetEventTime() >= 0;
+        }
+        CSweepResult& result = vResults.back();
+        result.meanBlockTime.Push(stats.dMeanBlockTime);
+        result.stdDevBlockTime.Push(stats.dStdDevBlockTime);
+        result.oscillation.Push(stats.dOscillation);
+        if (stats.nRecoveryTime >= 0)
+            result.recoveryTime.Push(stats.nRecoveryTime);
+        else if (result.fEvent)
+            result.nUnrecovered++;
+        result.vTrials.push_back(stats);
+    }
+    return vResults;
+}
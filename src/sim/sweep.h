@@ -0,0 +1,93 @@
+// Copyright (c) 2017 The Litebench developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_SIM_SWEEP_H
+#define BITCOIN_SIM_SWEEP_H
+
+#include "consensus/params.h"
+#include "retarget.h"
+#include "sim/scenario.h"
+#include "sim/simulator.h"
+
+#include <functional>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/** Default number of independent runs per (algorithm, scenario) pair */
+static const int DEFAULT_SWEEP_TRIALS = 20;
+/** Default hashrate multiplier applied by the built-in step and drop scenarios */
+static const double DEFAULT_SWEEP_STEP_FACTOR = 10;
+
+/**
+ * Call job(0) through job(nJobs - 1) on up to nThreads worker threads. Each
+ * idle worker claims the next job index from a shared counter, so faster jobs
+ * do not leave threads waiting. The first exception a job throws stops the
+ * hand-out and is rethrown once every worker has been joined.
+ */
+void RunJobs(size_t nJobs, int nThreads, std::function<void(size_t)> job);
+
+/** Running mean and variance (Welford's method). */
+class CRunningStat
+{
+private:
+    int64_t nCount;
+    double dMean;
+    double dM2;
+
+public:
+    CRunningStat() : nCount(0), dMean(0), dM2(0) {}
+
+    void Push(double dValue);
+
+    int64_t Count() const { return nCount; }
+    double Mean() const { return dMean; }
+    double StdDev() const;
+};
+
+/** Aggregated outcome of all trials of one algorithm under one scenario. */
+struct CSweepResult
+{
+    const CRetargetAlgorithm* palgorithm;
+    std::string strScenario;
+    //! Whether the scenario has a hashrate event to recover from
+    bool fEvent;
+    CRunningStat meanBlockTime;
+    CRunningStat stdDevBlockTime;
+    CRunningStat oscillation;
+    //! Recovery time, over the trials that recovered
+    CRunningStat recoveryTime;
+    //! Trials that had a hashrate event but never recovered from it
+    int nUnrecovered;
+    //! Per-trial statistics, in trial order
+    std::vector<CSimStats> vTrials;
+
+    CSweepResult() : palgorithm(NULL), fEvent(false), nUnrecovered(0) {}
+};
+
+/** Parameters of a sweep. */
+struct CSweepConfig
+{
+    std::vector<const CRetargetAlgorithm*> vAlgorithms;
+    std::vector<CScenario> vScenarios;
+    int nTrials;
+    int nBlocks;
+    int nWarmup;
+    double dHashrate;
+    uint64_t nSeed;
+    int nThreads;
+
+    CSweepConfig() : nTrials(DEFAULT_SWEEP_TRIALS), nBlocks(DEFAULT_SIM_BLOCKS), nWarmup(DEFAULT_SIM_WARMUP), dHashrate(DEFAULT_SIM_HASHRATE), nSeed(0), nThreads(1) {}
+};
+
+/**
+ * Run every (algorithm, scenario, trial) combination of config, spread across
+ * config.nThreads worker threads. Each trial's seed depends only on the base
+ * seed, the scenario's place in the list and the trial number, so every algorithm faces the same
+ * sequence of random draws, and the results do not depend on the thread count.
+ * Returns one entry per (algorithm, scenario), algorithms outermost.
+ */
+std::vector<CSweepResult> RunSweep(const Consensus::Params& params, uint32_t nGenesisTime, uint32_t nGenesisBits, const CSweepConfig& config);
+
+#endif // BITCOIN_SIM_SWEEP_H
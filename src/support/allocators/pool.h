@@ -0,0 +1,189 @@
+// Copyright (c) 2017 The Litebench developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_SUPPORT_ALLOCATORS_POOL_H
+#define BITCOIN_SUPPORT_ALLOCATORS_POOL_H
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <new>
+#include <vector>
+
+/**
+ * A memory resource that carves small, equally aligned blocks out of large
+ * chunks and keeps freed blocks on per-size free lists for reuse.
+ *
+ * Node based containers make one small allocation per element. Backing them
+ * with a PoolResource turns those into pointer bumps within a chunk, and
+ * destroying the resource returns every chunk in one go instead of freeing
+ * each element. Requests larger than MAX_BLOCK_SIZE_BYTES, or with a
+ * stricter alignment than ALIGN_BYTES, are passed on to ::operator new.
+ *
+ * Memory handed back to a free list is only reused for blocks of the same
+ * size, and chunks are only released when the resource is destroyed, so
+ * NumAllocatedChunks() * ChunkSizeBytes() is what the resource really holds.
+ *
+ * Not thread safe.
+ */
+template <std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+class PoolResource
+{
+    static_assert(ALIGN_BYTES > 0 && (ALIGN_BYTES & (ALIGN_BYTES - 1)) == 0, "ALIGN_BYTES must be a power of two");
+
+    /** Free list entry, placed in the memory of the freed block itself. */
+    struct ListNode {
+        ListNode* m_next;
+    };
+
+    /** Blocks are handed out in multiples of this size, so that they can hold a ListNode. */
+    static const std::size_t ELEM_ALIGN_BYTES = ALIGN_BYTES > sizeof(ListNode) ? ALIGN_BYTES : sizeof(ListNode);
+    static_assert((ELEM_ALIGN_BYTES & (ELEM_ALIGN_BYTES - 1)) == 0, "ELEM_ALIGN_BYTES must be a power of two");
+
+    const std::size_t m_chunk_size_bytes;
+    std::vector<char*> m_allocated_chunks;
+    //! Free list heads, indexed by block size in units of ELEM_ALIGN_BYTES.
+    std::array<ListNode*, (MAX_BLOCK_SIZE_BYTES + ELEM_ALIGN_BYTES - 1) / ELEM_ALIGN_BYTES + 1> m_free_lists;
+    //! Unused tail of the most recent chunk.
+    char* m_available_memory_it;
+    char* m_available_memory_end;
+
+    static std::size_t NumElemAlignBytes(std::size_t bytes)
+    {
+        return (bytes + ELEM_ALIGN_BYTES - 1) / ELEM_ALIGN_BYTES + (bytes == 0);
+    }
+
+    static bool IsFreeListUsable(std::size_t bytes, std::size_t alignment)
+    {
+        return alignment <= ELEM_ALIGN_BYTES && bytes <= MAX_BLOCK_SIZE_BYTES;
+    }
+
+    /** Hand what is left of the current chunk to the free lists, then start a new chunk. */
+    void AllocateChunk()
+    {
+        if (m_available_memory_it != m_available_memory_end) {
+            const std::size_t remaining_num = (m_available_memory_end - m_available_memory_it) / ELEM_ALIGN_BYTES;
+            ListNode* node = reinterpret_cast<ListNode*>(m_available_memory_it);
+            node->m_next = m_free_lists[remaining_num];
+            m_free_lists[remaining_num] = node;
+        }
+        char* chunk = static_cast<char*>(::operator new(m_chunk_size_bytes));
+        m_allocated_chunks.push_back(chunk);
+        m_available_memory_it = chunk;
+        m_available_memory_end = chunk + m_chunk_size_bytes;
+    }
+
+    PoolResource(const PoolResource&);
+    PoolResource& operator=(const PoolResource&);
+
+public:
+    /** The default chunk holds a few thousand coins cache entries. */
+    static const std::size_t DEFAULT_CHUNK_SIZE_BYTES = 262144;
+
+    explicit PoolResource(std::size_t chunk_size_bytes = DEFAULT_CHUNK_SIZE_BYTES)
+        : m_chunk_size_bytes(chunk_size_bytes / ELEM_ALIGN_BYTES * ELEM_ALIGN_BYTES),
+          m_available_memory_it(nullptr), m_available_memory_end(nullptr)
+    {
+        assert(m_chunk_size_bytes >= MAX_BLOCK_SIZE_BYTES);
+        m_free_lists.fill(nullptr);
+    }
+
+    ~PoolResource()
+    {
+        for (char* chunk : m_allocated_chunks) {
+            ::operator delete(chunk);
+        }
+    }
+
+    void* Allocate(std::size_t bytes, std::size_t alignment)
+    {
+        if (!IsFreeListUsable(bytes, alignment)) {
+            return ::operator new(bytes);
+        }
+        const std::size_t num_alignments = NumElemAlignBytes(bytes);
+        if (m_free_lists[num_alignments] != nullptr) {
+            ListNode* node = m_free_lists[num_alignments];
+            m_free_lists[num_alignments] = node->m_next;
+            return node;
+        }
+        const std::size_t round_bytes = num_alignments * ELEM_ALIGN_BYTES;
+        if (static_cast<std::size_t>(m_available_memory_end - m_available_memory_it) < round_bytes) {
+            AllocateChunk();
+        }
+        void* p = m_available_memory_it;
+        m_available_memory_it += round_bytes;
+        return p;
+    }
+
+    void Deallocate(void* p, std::size_t bytes, std::size_t alignment)
+    {
+        if (!IsFreeListUsable(bytes, alignment)) {
+            ::operator delete(p);
+            return;
+        }
+        const std::size_t num_alignments = NumElemAlignBytes(bytes);
+        ListNode* node = static_cast<ListNode*>(p);
+        node->m_next = m_free_lists[num_alignments];
+        m_free_lists[num_alignments] = node;
+    }
+
+    std::size_t NumAllocatedChunks() const { return m_allocated_chunks.size(); }
+    std::size_t ChunkSizeBytes() const { return m_chunk_size_bytes; }
+    //! Capacity of the vector that tracks the chunks, for memory accounting.
+    std::size_t ChunkListCapacity() const { return m_allocated_chunks.capacity(); }
+};
+
+/**
+ * Allocator that draws from a PoolResource it does not own. Containers
+ * rebind it to their node and bucket types; all rebound copies share the
+ * same resource, which must outlive the container.
+ */
+template <class T, std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES = alignof(void*)>
+class PoolAllocator
+{
+    PoolResource<MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>* m_resource;
+
+    template <typename U, std::size_t M, std::size_t A>
+    friend class PoolAllocator;
+
+public:
+    typedef T value_type;
+    typedef PoolResource<MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES> ResourceType;
+
+    PoolAllocator(ResourceType* resource) noexcept : m_resource(resource) {}
+
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& other) noexcept : m_resource(other.m_resource) {}
+
+    template <typename U>
+    struct rebind {
+        typedef PoolAllocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES> other;
+    };
+
+    T* allocate(std::size_t n)
+    {
+        return static_cast<T*>(m_resource->Allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* p, std::size_t n) noexcept
+    {
+        m_resource->Deallocate(p, n * sizeof(T), alignof(T));
+    }
+
+    ResourceType* resource() const noexcept { return m_resource; }
+
+    template <typename U>
+    bool operator==(const PoolAllocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& other) const noexcept
+    {
+        return m_resource == other.m_resource;
+    }
+
+    template <typename U>
+    bool operator!=(const PoolAllocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& other) const noexcept
+    {
+        return m_resource != other.m_resource;
+    }
+};
+
+#endif // BITCOIN_SUPPORT_ALLOCATORS_POOL_H
@@ -0,0 +1,296 @@
+// Copyright (c) 2017 The Litebench developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "telemetry.h"
+
+#include "chain.h"
+#include "crypto/common.h"
+#include "pow.h"
+#include "retarget.h"
+#include "tinyformat.h"
+#include "util.h"
+
+#include <stdexcept>
+#include <string.h>
+
+#include <boost/filesystem.hpp>
+
+std::unique_ptr<CRetargetTelemetry> pretargetTelemetry;
+
+namespace {
+
+const char TELEMETRY_MAGIC[4] = {'L', 'B', 'R', 'T'};
+const uint32_t TELEMETRY_VERSION = 1;
+const size_t TELEMETRY_HEADER_SIZE = 4096;
+
+/**
+ * Header layout, all little-endian:
+ *   0  magic "LBRT"
+ *   4  uint32 version
+ *   8  uint32 number of columns
+ *  12  uint32 records per chunk
+ *  16  uint64 number of records
+ *  32  column directory, TELEMETRY_COLUMN_ENTRY bytes per column:
+ *      char[16] name (NUL padded), char type ('i' signed, 'u' unsigned,
+ *      'f' IEEE double), uint8 width in bytes, 2 bytes padding,
+ *      uint32 offset of the column within a chunk
+ */
+const size_t TELEMETRY_RECORDS_OFFSET = 16;
+const size_t TELEMETRY_DIRECTORY_OFFSET = 32;
+const size_t TELEMETRY_COLUMN_ENTRY = 24;
+
+struct TelemetryColumn
+{
+    const char* pszName;
+    char chType;
+    uint8_t nWidth;
+};
+
+enum
+{
+    COL_HEIGHT,
+    COL_TIME,
+    COL_SOLVETIME,
+    COL_BITS,
+    COL_DIFFICULTY,
+    COL_ALGORITHM,
+    COL_FLAGS,
+    COL_WINDOW,
+    COL_ACTUALTIMESPAN,
+    COL_TARGETTIMESPAN,
+    COL_COUNT
+};
+
+const TelemetryColumn telemetryColumns[COL_COUNT] = {
+    {"height",         'i', 4},
+    {"time",           'u', 4},
+    {"solvetime",      'i', 4},
+    {"bits",           'u', 4},
+    {"difficulty",     'f', 8},
+    {"algorithm",      'u', 1},
+    {"flags",          'u', 1},
+    {"window",         'u', 4},
+    {"actualtimespan", 'i', 8},
+    {"targettimespan", 'i', 8},
+};
+
+/** Offsets of the columns within a chunk, and the size of a chunk. */
+struct TelemetryLayout
+{
+    size_t nOffset[COL_COUNT];
+    size_t nChunkSize;
+
+    TelemetryLayout() : nChunkSize(0)
+    {
+        for (int i = 0; i < COL_COUNT; i++) {
+            nOffset[i] = nChunkSize;
+            nChunkSize += (size_t)telemetryColumns[i].nWidth * TELEMETRY_CHUNK_RECORDS;
+        }
+    }
+};
+
+const TelemetryLayout telemetryLayout;
+
+uint64_t DoubleToBits(double d)
+{
+    uint64_t n;
+    memcpy(&n, &d, sizeof(n));
+    return n;
+}
+
+double BitsToDouble(uint64_t n)
+{
+    double d;
+    memcpy(&d, &n, sizeof(d));
+    return d;
+}
+
+void WriteHeader(unsigned char* p)
+{
+    memset(p, 0, TELEMETRY_HEADER_SIZE);
+    memcpy(p, TELEMETRY_MAGIC, sizeof(TELEMETRY_MAGIC));
+    WriteLE32(p + 4, TELEMETRY_VERSION);
+    WriteLE32(p + 8, COL_COUNT);
+    WriteLE32(p + 12, TELEMETRY_CHUNK_RECORDS);
+    WriteLE64(p + TELEMETRY_RECORDS_OFFSET, 0);
+    for (int i = 0; i < COL_COUNT; i++) {
+        unsigned char* pentry = p + TELEMETRY_DIRECTORY_OFFSET + i * TELEMETRY_COLUMN_ENTRY;
+        strncpy((char*)pentry, telemetryColumns[i].pszName, 16);
+        pentry[16] = telemetryColumns[i].chType;
+        pentry[17] = telemetryColumns[i].nWidth;
+        WriteLE32(pentry + 20, telemetryLayout.nOffset[i]);
+    }
+}
+
+/** Whether p is a header this code wrote, column for column. */
+bool CheckHeader(const unsigned char* p)
+{
+    unsigned char expected[TELEMETRY_HEADER_SIZE];
+    WriteHeader(expected);
+    size_t nCompare = TELEMETRY_DIRECTORY_OFFSET + COL_COUNT * TELEMETRY_COLUMN_ENTRY;
+    return memcmp(p, expected, TELEMETRY_RECORDS_OFFSET) == 0 &&
+           memcmp(p + TELEMETRY_DIRECTORY_OFFSET, expected + TELEMETRY_DIRECTORY_OFFSET, nCompare - TELEMETRY_DIRECTORY_OFFSET) == 0;
+}
+
+uint64_t GetChunkOffset(uint64_t nChunk)
+{
+    return TELEMETRY_HEADER_SIZE + nChunk * telemetryLayout.nChunkSize;
+}
+
+} // namespace
+
+void CRetargetRecord::Set(const CBlockIndex* pindex, int nAlgorithmIn, const CRetargetState& state)
+{
+    nHeight = pindex->nHeight;
+    nTime = pindex->nTime;
+    nSolveTime = pindex->pprev ? (int32_t)((int64_t)pindex->nTime - pindex->pprev->nTime) : 0;
+    nBits = pindex->nBits;
+    dDifficulty = GetDifficulty(pindex->nBits);
+    nAlgorithm = nAlgorithmIn;
+    nFlags = state.nFlags;
+    nWindow = state.nWindow;
+    nActualTimespan = state.nActualTimespan;
+    nTargetTimespan = state.nTargetTimespan;
+}
+
+CRetargetTelemetry::CRetargetTelemetry(const std::string& strFileIn) : strFile(strFileIn), nRecords(0), nChunk(-1)
+{
+    using namespace boost::interprocess;
+    bool fNew;
+    try {
+        fNew = !boost::filesystem::exists(strFile) || boost::filesystem::file_size(strFile) == 0;
+        if (fNew) {
+            FILE* f = fopen(strFile.c_str(), "wb");
+            if (!f)
+                throw std::runtime_error(strprintf("Cannot create telemetry file %s", strFile));
+            fclose(f);
+            boost::filesystem::resize_file(strFile, TELEMETRY_HEADER_SIZE);
+        } else if (boost::filesystem::file_size(strFile) < TELEMETRY_HEADER_SIZE) {
+            throw std::runtime_error(strprintf("%s is not a retarget telemetry file", strFile));
+        }
+        file = file_mapping(strFile.c_str(), read_write);
+        header = mapped_region(file, read_write, 0, TELEMETRY_HEADER_SIZE);
+    } catch (const boost::filesystem::filesystem_error& e) {
+        throw std::runtime_error(strprintf("Cannot open telemetry file %s: %s", strFile, e.what()));
+    } catch (const interprocess_exception& e) {
+        throw std::runtime_error(strprintf("Cannot map telemetry file %s: %s", strFile, e.what()));
+    }
+
+    unsigned char* p = (unsigned char*)header.get_address();
+    if (fNew)
+        WriteHeader(p);
+    if (!CheckHeader(p))
+        throw std::runtime_error(strprintf("%s is not a retarget telemetry file of this version", strFile));
+    nRecords = ReadLE64(p + TELEMETRY_RECORDS_OFFSET);
+    uint64_t nSize = boost::filesystem::file_size(strFile);
+    if (nRecords && nSize < GetChunkOffset((nRecords - 1) / TELEMETRY_CHUNK_RECORDS + 1))
+        throw std::runtime_error(strprintf("Telemetry file %s is truncated", strFile));
+}
+
+CRetargetTelemetry::~CRetargetTelemetry()
+{
+    Flush();
+}
+
+void CRetargetTelemetry::MapChunk(int64_t nChunkIn)
+{
+    using namespace boost::interprocess;
+    uint64_t nEnd = GetChunkOffset(nChunkIn + 1);
+    try {
+        if (boost::filesystem::file_size(strFile) < nEnd)
+            boost::filesystem::resize_file(strFile, nEnd);
+        chunk.flush();
+        chunk = mapped_region(file, read_write, GetChunkOffset(nChunkIn), telemetryLayout.nChunkSize);
+    } catch (const boost::filesystem::filesystem_error& e) {
+        throw std::runtime_error(strprintf("Cannot extend telemetry file %s: %s", strFile, e.what()));
+    } catch (const interprocess_exception& e) {
+        throw std::runtime_error(strprintf("Cannot map telemetry file %s: %s", strFile, e.what()));
+    }
+    nChunk = nChunkIn;
+}
+
+void CRetargetTelemetry::Append(const CRetargetRecord& record)
+{
+    int64_t nChunkNeeded = nRecords / TELEMETRY_CHUNK_RECORDS;
+    if (nChunkNeeded != nChunk)
+        MapChunk(nChunkNeeded);
+
+    const size_t nRow = nRecords % TELEMETRY_CHUNK_RECORDS;
+    unsigned char* p = (unsigned char*)chunk.get_address();
+    const size_t* nOffset = telemetryLayout.nOffset;
+    WriteLE32(p + nOffset[COL_HEIGHT] + 4 * nRow, (uint32_t)record.nHeight);
+    WriteLE32(p + nOffset[COL_TIME] + 4 * nRow, record.nTime);
+    WriteLE32(p + nOffset[COL_SOLVETIME] + 4 * nRow, (uint32_t)record.nSolveTime);
+    WriteLE32(p + nOffset[COL_BITS] + 4 * nRow, record.nBits);
+    WriteLE64(p + nOffset[COL_DIFFICULTY] + 8 * nRow, DoubleToBits(record.dDifficulty));
+    p[nOffset[COL_ALGORITHM] + nRow] = record.nAlgorithm;
+    p[nOffset[COL_FLAGS] + nRow] = record.nFlags;
+    WriteLE32(p + nOffset[COL_WINDOW] + 4 * nRow, record.nWindow);
+    WriteLE64(p + nOffset[COL_ACTUALTIMESPAN] + 8 * nRow, (uint64_t)record.nActualTimespan);
+    WriteLE64(p + nOffset[COL_TARGETTIMESPAN] + 8 * nRow, (uint64_t)record.nTargetTimespan);
+
+    nRecords++;
+    WriteLE64((unsigned char*)header.get_address() + TELEMETRY_RECORDS_OFFSET, nRecords);
+}
+
+void CRetargetTelemetry::Flush()
+{
+    if (chunk.get_size())
+        chunk.flush();
+    if (header.get_size())
+        header.flush();
+}
+
+uint64_t CRetargetTelemetry::ExportCSV(const std::string& strFile, FILE* out)
+{
+    using namespace boost::interprocess;
+    file_mapping file;
+    mapped_region region;
+    try {
+        file = file_mapping(strFile.c_str(), read_only);
+        region = mapped_region(file, read_only);
+    } catch (const interprocess_exception& e) {
+        throw std::runtime_error(strprintf("Cannot map telemetry file %s: %s", strFile, e.what()));
+    }
+    const unsigned char* pbegin = (const unsigned char*)region.get_address();
+    if (region.get_size() < TELEMETRY_HEADER_SIZE || !CheckHeader(pbegin))
+        throw std::runtime_error(strprintf("%s is not a retarget telemetry file of this version", strFile));
+    const uint64_t nCount = ReadLE64(pbegin + TELEMETRY_RECORDS_OFFSET);
+    if (nCount && region.get_size() < GetChunkOffset((nCount - 1) / TELEMETRY_CHUNK_RECORDS + 1))
+        throw std::runtime_error(strprintf("Telemetry file %s is truncated", strFile));
+
+    fprintf(out, "height,time,solvetime,bits,difficulty,algorithm,flags,window,actualtimespan,targettimespan\n");
+    const size_t* nOffset = telemetryLayout.nOffset;
+    for (uint64_t n = 0; n < nCount; n++) {
+        const unsigned char* p = pbegin + GetChunkOffset(n / TELEMETRY_CHUNK_RECORDS);
+        const size_t nRow = n % TELEMETRY_CHUNK_RECORDS;
+        fprintf(out, "%d,%u,%d,%08x,%.8g,%u,%u,%u,%lld,%lld\n",
+            (int32_t)ReadLE32(p + nOffset[COL_HEIGHT] + 4 * nRow),
+            ReadLE32(p + nOffset[COL_TIME] + 4 * nRow),
+            (int32_t)ReadLE32(p + nOffset[COL_SOLVETIME] + 4 * nRow),
+            ReadLE32(p + nOffset[COL_BITS] + 4 * nRow),
+            BitsToDouble(ReadLE64(p + nOffset[COL_DIFFICULTY] + 8 * nRow)),
+            (unsigned int)p[nOffset[COL_ALGORITHM] + nRow],
+            (unsigned int)p[nOffset[COL_FLAGS] + nRow],
+            ReadLE32(p + nOffset[COL_WINDOW] + 4 * nRow),
+            (long long)ReadLE64(p + nOffset[COL_ACTUALTIMESPAN] + 8 * nRow),
+            (long long)ReadLE64(p + nOffset[COL_TARGETTIMESPAN] + 8 * nRow));
+    }
+    return nCount;
+}
+
+void RecordRetargetTelemetry(const CBlockIndex* pindex)
+{
+    const CRetargetAlgorithm* palgorithm = SelectedRetargetAlgorithm();
+    if (!pretargetTelemetry || !palgorithm)
+        return;
+    CRetargetRecord record;
+    record.Set(pindex, palgorithm->nId, pindex->retargetState);
+    try {
+        pretargetTelemetry->Append(record);
+    } catch (const std::runtime_error& e) {
+        LogPrintf("%s: %s; retarget telemetry stopped\n", __func__, e.what());
+        pretargetTelemetry.reset();
+    }
+}
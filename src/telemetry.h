@@ -0,0 +1,102 @@
+// Copyright (c) 2017 The Litebench developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_TELEMETRY_H
+#define BITCOIN_TELEMETRY_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <memory>
+#include <string>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+class CBlockIndex;
+struct CRetargetState;
+
+/** One block's entry in the retarget telemetry. */
+struct CRetargetRecord
+{
+    int32_t nHeight;
+    uint32_t nTime;
+    //! nTime minus the previous block's nTime; may be negative
+    int32_t nSolveTime;
+    uint32_t nBits;
+    double dDifficulty;
+    //! CRetargetAlgorithm::nId of the algorithm that picked nBits
+    uint8_t nAlgorithm;
+    //! RETARGET_* flags of CRetargetState
+    uint8_t nFlags;
+    uint32_t nWindow;
+    int64_t nActualTimespan;
+    int64_t nTargetTimespan;
+
+    CRetargetRecord() : nHeight(0), nTime(0), nSolveTime(0), nBits(0), dDifficulty(0), nAlgorithm(0), nFlags(0), nWindow(0), nActualTimespan(0), nTargetTimespan(0) {}
+
+    /** Fill in from a block, the algorithm that retargeted it, and what that call reported. */
+    void Set(const CBlockIndex* pindex, int nAlgorithmIn, const CRetargetState& state);
+};
+
+/**
+ * Append-only store of retarget records in a memory-mapped columnar file.
+ *
+ * The file is a 4 KiB header (magic, version, record count and a directory of
+ * the columns) followed by chunks of TELEMETRY_CHUNK_RECORDS records. Within a
+ * chunk each column is a contiguous array of fixed-width little-endian values,
+ * so a reader can map a file and scan one column without touching the rest.
+ * Appending is a handful of stores into the mapped current chunk; the file
+ * grows a whole chunk at a time, and the record count in the header is
+ * updated on every append, so a file is readable up to the last record while
+ * it is still being written.
+ *
+ * Opening an existing file continues after its last record. The node appends
+ * a record whenever its tip changes, so after a reorg (or a restart with the
+ * same file) a height may appear more than once; the last record for a height
+ * is the one that counts.
+ */
+class CRetargetTelemetry
+{
+private:
+    std::string strFile;
+    boost::interprocess::file_mapping file;
+    boost::interprocess::mapped_region header;
+    boost::interprocess::mapped_region chunk;
+    uint64_t nRecords;
+    //! Index of the chunk currently mapped, or -1
+    int64_t nChunk;
+
+    void MapChunk(int64_t nChunkIn);
+
+public:
+    /** Open strFileIn for appending, creating it if needed; throws std::runtime_error. */
+    explicit CRetargetTelemetry(const std::string& strFileIn);
+    ~CRetargetTelemetry();
+
+    /** Append a record; throws std::runtime_error if the file cannot be extended. */
+    void Append(const CRetargetRecord& record);
+
+    uint64_t Count() const { return nRecords; }
+
+    /** Flush the mapped pages to disk. */
+    void Flush();
+
+    /** Write every record of strFile as CSV to out; throws std::runtime_error. Returns the number of records. */
+    static uint64_t ExportCSV(const std::string& strFile, FILE* out);
+};
+
+/** Records per chunk of a telemetry file */
+static const uint32_t TELEMETRY_CHUNK_RECORDS = 65536;
+
+/** The node's telemetry sink (-telemetry), or NULL. */
+extern std::unique_ptr<CRetargetTelemetry> pretargetTelemetry;
+
+/**
+ * Append pindex, the node's new tip, to pretargetTelemetry, with the retarget
+ * state kept when its header was checked. If the file cannot be extended,
+ * telemetry is switched off.
+ */
+void RecordRetargetTelemetry(const CBlockIndex* pindex);
+
+#endif // BITCOIN_TELEMETRY_H
@@ -4,6 +4,7 @@
 
 #include "util.h"
 
+#include "support/allocators/pool.h"
 #include "support/allocators/secure.h"
 #include "test/test_bitcoin.h"
 
@@ -204,6 +205,44 @@ BOOST_AUTO_TEST_CASE(lockedpool_tests_mock)
     BOOST_CHECK(pool.stats().used == 0);
 }
 
+BOOST_AUTO_TEST_CASE(pool_resource_tests)
+{
+    PoolResource<64, 8> resource(1024);
+    BOOST_CHECK(resource.NumAllocatedChunks() == 0);
+
+    // Small blocks share one chunk
+    void *a = resource.Allocate(8, 8);
+    void *b = resource.Allocate(24, 8);
+    BOOST_CHECK(a != nullptr && b != nullptr && a != b);
+    BOOST_CHECK(resource.NumAllocatedChunks() == 1);
+
+    // A freed block is handed out again for the same size
+    resource.Deallocate(b, 24, 8);
+    void *c = resource.Allocate(24, 8);
+    BOOST_CHECK(c == b);
+
+    // Blocks above the pooled maximum do not come from the chunks
+    void *big = resource.Allocate(128, 8);
+    BOOST_CHECK(resource.NumAllocatedChunks() == 1);
+    resource.Deallocate(big, 128, 8);
+
+    // Exhausting a chunk starts another one
+    for (int i = 0; i < 20; ++i) {
+        resource.Allocate(64, 8);
+    }
+    BOOST_CHECK(resource.NumAllocatedChunks() == 2);
+    BOOST_CHECK(resource.ChunkSizeBytes() == 1024);
+
+    // Containers can share the resource through rebound allocators
+    typedef PoolAllocator<int, 64, 8> IntAllocator;
+    std::vector<int, IntAllocator> vec{IntAllocator(&resource)};
+    for (int i = 0; i < 8; ++i) {
+        vec.push_back(i);
+    }
+    BOOST_CHECK(vec[7] == 7);
+    BOOST_CHECK(vec.get_allocator().resource() == &resource);
+}
+
 // These tests used the live LockedPoolManager object, this is also used
 // by other tests so the conditions are somewhat less controllable and thus the
 // tests are somewhat more error-prone.
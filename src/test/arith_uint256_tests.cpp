@@ -368,6 +368,57 @@ BOOST_AUTO_TEST_CASE( divide )
     BOOST_CHECK_THROW(R2L / ZeroL, uint_error);
 }
 
+BOOST_AUTO_TEST_CASE( scalar64 ) // Mul64 DivMod64 MulDiv
+{
+    const arith_uint256 values[] = {ZeroL, OneL, R1L, R2L, HalfL, MaxL, R1L >> 100, R2L >> 200};
+    const uint64_t scalars[] = {1, 3, 10, 0xffffffffULL, 0x100000000ULL, 0x87654321deadbeefULL, std::numeric_limits<uint64_t>::max()};
+    for (const arith_uint256& x : values) {
+        BOOST_CHECK(arith_uint256(x).Mul64(0) == ZeroL);
+        BOOST_CHECK_THROW(arith_uint256(x).DivMod64(0), uint_error);
+        BOOST_CHECK_THROW(arith_uint256(x).MulDiv(1, 0), uint_error);
+        for (uint64_t n : scalars) {
+            // Same results as the generic operators
+            arith_uint256 prod = x;
+            BOOST_CHECK(prod.Mul64(n) == x * arith_uint256(n));
+            arith_uint256 quot = x;
+            uint64_t nRem = quot.DivMod64(n);
+            BOOST_CHECK(quot == x / arith_uint256(n));
+            BOOST_CHECK(nRem < n);
+            BOOST_CHECK_EQUAL(nRem, (x - quot * arith_uint256(n)).GetLow64());
+
+            // Where x * n fits, MulDiv agrees with *= followed by /=
+            arith_uint256 y = x >> 64;
+            arith_uint256 scaled = y;
+            BOOST_CHECK(scaled.MulDiv(n, 7));
+            BOOST_CHECK(scaled == y * arith_uint256(n) / arith_uint256(7));
+            scaled = x;
+            BOOST_CHECK(scaled.MulDiv(n, n));
+            BOOST_CHECK(scaled == x);
+        }
+    }
+    BOOST_CHECK_EQUAL(arith_uint256(1000).DivMod64(7), 6U);
+    BOOST_CHECK_EQUAL(arith_uint256(R1L).DivMod64(10), 6U);
+    BOOST_CHECK_EQUAL(arith_uint256(R1L).DivMod64(0x87654321deadbeefULL), 0x138685625df06db9ULL);
+    BOOST_CHECK_EQUAL(arith_uint256(R1L).DivMod64(std::numeric_limits<uint64_t>::max()), 0x940a624be8b853bfULL);
+
+    // The product may exceed 256 bits as long as the quotient does not.
+    arith_uint256 x = HalfL;
+    BOOST_CHECK(x.MulDiv(6, 4));
+    BOOST_CHECK(x == HalfL + (HalfL >> 1));
+    x = MaxL;
+    BOOST_CHECK(!x.MulDiv(std::numeric_limits<uint64_t>::max(), std::numeric_limits<uint64_t>::max() - 1));
+    BOOST_CHECK(x == MaxL);
+    x = HalfL;
+    BOOST_CHECK(!x.MulDiv(4, 2));
+    BOOST_CHECK(x == MaxL);
+    x = R1L;
+    BOOST_CHECK(!x.MulDiv(std::numeric_limits<uint64_t>::max(), 1));
+    BOOST_CHECK(x == MaxL);
+    x = R1L;
+    BOOST_CHECK(x.MulDiv(1, 3));
+    BOOST_CHECK(x == R1L / 3);
+}
+
 
 bool almostEqual(double d1, double d2)
 {
@@ -2,71 +2,81 @@
 // Distributed under the MIT/X11 software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "arith_uint256.h"
 #include "chain.h"
 #include "chainparams.h"
 #include "pow.h"
+#include "powminer.h"
 #include "random.h"
 #include "util.h"
 #include "test/test_bitcoin.h"
 
+#include <vector>
+
 #include <boost/test/unit_test.hpp>
 
 BOOST_FIXTURE_TEST_SUITE(pow_tests, BasicTestingSetup)
 
+/* The testcase1 vectors are Litecoin mainnet blocks, so pin the timespan and limit they were mined under */
+static Consensus::Params LitecoinRetargetParams()
+{
+    SelectParams(CBaseChainParams::MAIN);
+    Consensus::Params params = Params().GetConsensus();
+    params.nPowTargetTimespan = 3.5 * 24 * 60 * 60;
+    params.powLimit = uint256S("00000fffffffffffffffffffffffffffffffffffffffffffffffffffffffffff");
+    return params;
+}
+
 /* Test calculation of next difficulty target with no constraints applying */
 BOOST_AUTO_TEST_CASE(get_next_work)
 {
-    SelectParams(CBaseChainParams::MAIN);
-    const Consensus::Params& params = Params().GetConsensus();
+    const Consensus::Params params = LitecoinRetargetParams();
 
     int64_t nLastRetargetTime = 1358118740; // Block #278207
     CBlockIndex pindexLast;
     pindexLast.nHeight = 280223;
     pindexLast.nTime = 1358378777;  // Block #280223
     pindexLast.nBits = 0x1c0ac141;
-    BOOST_CHECK_EQUAL(CalculateNextWorkRequired(&pindexLast, nLastRetargetTime, params), 0x1c093f8d);
+    BOOST_CHECK_EQUAL(testcase1_ext(&pindexLast, nLastRetargetTime, params), 0x1c093f8d);
 }
 
 /* Test the constraint on the upper bound for next work */
 BOOST_AUTO_TEST_CASE(get_next_work_pow_limit)
 {
-    SelectParams(CBaseChainParams::MAIN);
-    const Consensus::Params& params = Params().GetConsensus();
+    const Consensus::Params params = LitecoinRetargetParams();
 
     int64_t nLastRetargetTime = 1317972665; // Block #0
     CBlockIndex pindexLast;
     pindexLast.nHeight = 2015;
     pindexLast.nTime = 1318480354;  // Block #2015
     pindexLast.nBits = 0x1e0ffff0;
-    BOOST_CHECK_EQUAL(CalculateNextWorkRequired(&pindexLast, nLastRetargetTime, params), 0x1e0fffff);
+    BOOST_CHECK_EQUAL(testcase1_ext(&pindexLast, nLastRetargetTime, params), 0x1e0fffff);
 }
 
 /* Test the constraint on the lower bound for actual time taken */
 BOOST_AUTO_TEST_CASE(get_next_work_lower_limit_actual)
 {
-    SelectParams(CBaseChainParams::MAIN);
-    const Consensus::Params& params = Params().GetConsensus();
+    const Consensus::Params params = LitecoinRetargetParams();
 
     int64_t nLastRetargetTime = 1401682934; // NOTE: Not an actual block time
     CBlockIndex pindexLast;
     pindexLast.nHeight = 578591;
     pindexLast.nTime = 1401757934;  // Block #578591
     pindexLast.nBits = 0x1b075cf1;
-    BOOST_CHECK_EQUAL(CalculateNextWorkRequired(&pindexLast, nLastRetargetTime, params), 0x1b01d73c);
+    BOOST_CHECK_EQUAL(testcase1_ext(&pindexLast, nLastRetargetTime, params), 0x1b01d73c);
 }
 
 /* Test the constraint on the upper bound for actual time taken */
 BOOST_AUTO_TEST_CASE(get_next_work_upper_limit_actual)
 {
-    SelectParams(CBaseChainParams::MAIN);
-    const Consensus::Params& params = Params().GetConsensus();
+    const Consensus::Params params = LitecoinRetargetParams();
 
     int64_t nLastRetargetTime = 1463690315; // NOTE: Not an actual block time
     CBlockIndex pindexLast;
     pindexLast.nHeight = 1001951;
     pindexLast.nTime = 1464900315;  // Block #1001951
     pindexLast.nBits = 0x1b015318;
-    BOOST_CHECK_EQUAL(CalculateNextWorkRequired(&pindexLast, nLastRetargetTime, params), 0x1b054c60);
+    BOOST_CHECK_EQUAL(testcase1_ext(&pindexLast, nLastRetargetTime, params), 0x1b054c60);
 }
 
 BOOST_AUTO_TEST_CASE(GetBlockProofEquivalentTime_test)
@@ -93,4 +103,62 @@ BOOST_AUTO_TEST_CASE(GetBlockProofEquivalentTime_test)
     }
 }
 
+/**
+ * Hashes around bnTarget: equal to it, one above and one below in the top
+ * 64-bit word, and equal in the top word with the low bits all set, all clear
+ * or one off.
+ */
+static std::vector<uint256> HashesAround(const arith_uint256& bnTarget)
+{
+    const arith_uint256 bnHighUnit = arith_uint256(1) << 192;
+    const arith_uint256 bnLowMask = bnHighUnit - 1;
+    std::vector<uint256> vHashes;
+    vHashes.push_back(ArithToUint256(bnTarget));
+    vHashes.push_back(ArithToUint256(bnTarget + bnHighUnit));
+    vHashes.push_back(ArithToUint256(bnTarget - bnHighUnit));
+    vHashes.push_back(ArithToUint256(bnTarget | bnLowMask));
+    vHashes.push_back(ArithToUint256(bnTarget & ~bnLowMask));
+    vHashes.push_back(ArithToUint256(bnTarget + 1));
+    vHashes.push_back(ArithToUint256(bnTarget - 1));
+    return vHashes;
+}
+
+/* CMiningTarget's top-word shortcut must accept exactly the hashes CheckProofOfWork does */
+BOOST_AUTO_TEST_CASE(mining_target_matches_check_proof_of_work)
+{
+    SelectParams(CBaseChainParams::MAIN);
+    const Consensus::Params& params = Params().GetConsensus();
+    const arith_uint256 bnPowLimit = UintToArith256(params.powLimit);
+
+    // powLimit as nBits and the next value up, then mantissas inside, across
+    // and below the top 64-bit word
+    for (uint32_t nBits : {bnPowLimit.GetCompact(), 0x1f010000u, 0x1e0fffffu, 0x1b0404cbu, 0x19012345u, 0x18012345u}) {
+        CMiningTarget target;
+        arith_uint256 bnTarget;
+        bnTarget.SetCompact(nBits);
+        std::vector<uint256> vHashes = HashesAround(bnTarget);
+        if (!target.SetCompact(nBits, params.powLimit)) {
+            BOOST_CHECK(bnTarget > bnPowLimit);
+            for (const uint256& hash : vHashes)
+                BOOST_CHECK(!CheckProofOfWork(hash, nBits, params));
+            continue;
+        }
+        BOOST_CHECK(target.GetTarget() == bnTarget);
+
+        int nExpected = -1;
+        for (int i = vHashes.size() - 1; i >= 0; i--) {
+            bool fValid = CheckProofOfWork(vHashes[i], nBits, params);
+            BOOST_CHECK_EQUAL(target.Check(vHashes[i]), fValid);
+            if (fValid)
+                nExpected = i;
+            BOOST_CHECK_EQUAL(target.FindFirst(&vHashes[i], vHashes.size() - i), nExpected < 0 ? -1 : nExpected - i);
+        }
+    }
+
+    // powLimit itself has no exact compact form; compare it to the full-width check
+    CMiningTarget limit(bnPowLimit);
+    for (const uint256& hash : HashesAround(bnPowLimit))
+        BOOST_CHECK_EQUAL(limit.Check(hash), UintToArith256(hash) <= bnPowLimit);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,513 @@
+// Copyright (c) 2017 The Litebench developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "arith_uint256.h"
+#include "chain.h"
+#include "chainparams.h"
+#include "primitives/block.h"
+#include "random.h"
+#include "retarget.h"
+#include "test/test_bitcoin.h"
+
+#include <algorithm>
+#include <math.h>
+#include <memory>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(retarget_tests, BasicTestingSetup)
+
+/**
+ * Grow blocks to nBlocks entries, the first one on top of pindexFork (or a
+ * genesis block if NULL). Times and targets vary from block to block so that a
+ * cache entry taken from the wrong branch shows up.
+ */
+static void BuildBranch(std::vector<CBlockIndex>& blocks, CBlockIndex* pindexFork, int nBlocks, uint32_t nSalt)
+{
+    blocks.resize(nBlocks);
+    for (int i = 0; i < nBlocks; i++) {
+        CBlockIndex& block = blocks[i];
+        block.pprev = i ? &blocks[i - 1] : pindexFork;
+        block.nHeight = block.pprev ? block.pprev->nHeight + 1 : 0;
+        block.nTime = block.pprev ? block.pprev->nTime + 30 + (block.nHeight * 7 + nSalt) % 271 : 1500000000;
+        block.nBits = 0x1d000000 | (0x00ffff - (block.nHeight * 131 + nSalt * 17) % 0x8000);
+        block.BuildSkip();
+    }
+}
+
+/**
+ * A chain with scattered solve times and small random targets: targets below
+ * 2**23 survive GetCompact whole, so an average that is off by one shows up in
+ * nBits.
+ */
+static void BuildRandomChain(std::vector<CBlockIndex>& blocks, int nBlocks)
+{
+    FastRandomContext rng(true);
+    blocks.resize(nBlocks);
+    for (int i = 0; i < nBlocks; i++) {
+        CBlockIndex& block = blocks[i];
+        block.pprev = i ? &blocks[i - 1] : NULL;
+        block.nHeight = i;
+        block.nTime = i ? blocks[i - 1].nTime + rng.rand32() % 600 : 1500000000;
+        block.nBits = arith_uint256(0x100000 + rng.rand32() % 0x700000).GetCompact();
+        block.BuildSkip();
+    }
+}
+
+/** KGW as it was before the window cache: a pprev walk with a running average. */
+static unsigned int ReferenceKGW(const CBlockIndex* pindexLast, const Consensus::Params& params)
+{
+    const CBlockIndex* BlockReading = pindexLast;
+    uint64_t PastBlocksMass = 0;
+    int64_t PastRateActualSeconds = 0;
+    int64_t PastRateTargetSeconds = 0;
+    arith_uint256 PastDifficultyAverage;
+    arith_uint256 PastDifficultyAveragePrev;
+
+    uint64_t PastBlocksMin = (uint64_t)(params.nPowTargetTimespan * 0.025) / params.nPowTargetSpacing;
+    uint64_t PastBlocksMax = (uint64_t)(params.nPowTargetTimespan * 7) / params.nPowTargetSpacing;
+
+    for (unsigned int i = 1; BlockReading && BlockReading->nHeight > 0; i++) {
+        if (PastBlocksMax > 0 && i > PastBlocksMax) { break; }
+        PastBlocksMass++;
+
+        PastDifficultyAverage.SetCompact(BlockReading->nBits);
+        if (i > 1) {
+            if (PastDifficultyAverage >= PastDifficultyAveragePrev)
+                PastDifficultyAverage = ((PastDifficultyAverage - PastDifficultyAveragePrev) / i) + PastDifficultyAveragePrev;
+            else
+                PastDifficultyAverage = PastDifficultyAveragePrev - ((PastDifficultyAveragePrev - PastDifficultyAverage) / i);
+        }
+        PastDifficultyAveragePrev = PastDifficultyAverage;
+
+        PastRateActualSeconds = std::max<int64_t>(pindexLast->GetBlockTime() - BlockReading->GetBlockTime(), 0);
+        PastRateTargetSeconds = params.nPowTargetSpacing * PastBlocksMass;
+        double PastRateAdjustmentRatio = 1;
+        if (PastRateActualSeconds != 0)
+            PastRateAdjustmentRatio = double(PastRateTargetSeconds) / double(PastRateActualSeconds);
+        double EventHorizonDeviation = 1 + (0.7084 * pow((double(PastBlocksMass)/double(28.2)), -1.228));
+        if (PastBlocksMass >= PastBlocksMin && (PastRateAdjustmentRatio <= 1 / EventHorizonDeviation || PastRateAdjustmentRatio >= EventHorizonDeviation))
+            break;
+        BlockReading = BlockReading->pprev;
+    }
+
+    arith_uint256 bnNew(PastDifficultyAverage);
+    if (PastRateActualSeconds != 0) {
+        bnNew *= PastRateActualSeconds;
+        bnNew /= PastRateTargetSeconds;
+    }
+    if (bnNew > UintToArith256(params.powLimit))
+        bnNew = UintToArith256(params.powLimit);
+    return bnNew.GetCompact();
+}
+
+/** DGW3 as it was before the window cache, on chains where no min-difficulty rule applies. */
+static unsigned int ReferenceDGW(const CBlockIndex* pindexLast, const Consensus::Params& params)
+{
+    const arith_uint256 bnPowLimit = UintToArith256(params.powLimit);
+    int64_t nPastBlocks = 24;
+    if (pindexLast->nHeight < nPastBlocks)
+        return bnPowLimit.GetCompact();
+
+    const CBlockIndex* pindex = pindexLast;
+    arith_uint256 bnPastTargetAvg;
+    for (unsigned int nCountBlocks = 1; nCountBlocks <= nPastBlocks; nCountBlocks++) {
+        arith_uint256 bnTarget = arith_uint256().SetCompact(pindex->nBits);
+        if (nCountBlocks == 1)
+            bnPastTargetAvg = bnTarget;
+        else
+            bnPastTargetAvg = (bnPastTargetAvg * nCountBlocks + bnTarget) / (nCountBlocks + 1);
+        if (nCountBlocks != nPastBlocks)
+            pindex = pindex->pprev;
+    }
+
+    arith_uint256 bnNew(bnPastTargetAvg);
+    int64_t nActualTimespan = pindexLast->GetBlockTime() - pindex->GetBlockTime();
+    int64_t nTargetTimespan = nPastBlocks * params.nPowTargetSpacing;
+    nActualTimespan = std::min(std::max(nActualTimespan, nTargetTimespan/3), nTargetTimespan*3);
+    bnNew *= nActualTimespan;
+    bnNew /= nTargetTimespan;
+    if (bnNew > bnPowLimit)
+        bnNew = bnPowLimit;
+    return bnNew.GetCompact();
+}
+
+/**
+ * A chain through asert's anchor, which GetNextWorkRequired places at height
+ * 99 (the last block it gives powLimit whatever the algorithm), and
+ * nHeightDelta blocks past it, with the tip nTimeDelta seconds after the
+ * anchor's parent.
+ */
+static void BuildASERTChain(std::vector<CBlockIndex>& blocks, uint32_t nAnchorBits, int64_t nTimeDelta, int nHeightDelta)
+{
+    const int nAnchorHeight = 99;
+    blocks.resize(nAnchorHeight + nHeightDelta + 1);
+    for (size_t i = 0; i < blocks.size(); i++) {
+        CBlockIndex& block = blocks[i];
+        block.pprev = i ? &blocks[i - 1] : NULL;
+        block.nHeight = i;
+        block.nTime = 1500000000 + i * 150;
+        block.nBits = (int)i == nAnchorHeight ? nAnchorBits : 0x1e00ffff;
+        block.BuildSkip();
+    }
+    blocks.back().nTime = blocks[nAnchorHeight - 1].nTime + nTimeDelta;
+}
+
+/** Check cache against the chain ending at pindexLast over heights nFirst through pindexLast's. */
+static void CheckCache(const CRetargetCache& cache, const CBlockIndex* pindexLast, int nFirst)
+{
+    arith_uint256 bnSum;
+    for (const CBlockIndex* pindex = pindexLast; pindex && pindex->nHeight >= nFirst; pindex = pindex->pprev) {
+        BOOST_CHECK(cache.Contains(pindex));
+        BOOST_CHECK_EQUAL(cache.GetBlockTime(pindex->nHeight), pindex->GetBlockTime());
+        bnSum += arith_uint256().SetCompact(pindex->nBits);
+        BOOST_CHECK(cache.GetTargetSum(pindex->nHeight, pindexLast->nHeight) == bnSum);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(retarget_cache_sync)
+{
+    std::vector<CBlockIndex> chain;
+    BuildBranch(chain, NULL, 200, 0);
+
+    CRetargetCache cache;
+    BOOST_CHECK(cache.Sync(&chain[199], 10));
+    BOOST_CHECK_EQUAL(cache.Height(), 199);
+    CheckCache(cache, &chain[199], 0);
+
+    // Extending the tip appends
+    std::vector<CBlockIndex> tip;
+    BuildBranch(tip, &chain[199], 1, 0);
+    BOOST_CHECK(cache.Sync(&tip[0], 10));
+    BOOST_CHECK_EQUAL(cache.Height(), 200);
+    CheckCache(cache, &tip[0], 0);
+}
+
+BOOST_AUTO_TEST_CASE(retarget_cache_reorg)
+{
+    std::vector<CBlockIndex> chain;
+    BuildBranch(chain, NULL, 200, 0);
+    CRetargetCache cache;
+    BOOST_CHECK(cache.Sync(&chain[199], 10));
+
+    // A longer branch forking 4 blocks below the tip rewinds to the fork point
+    std::vector<CBlockIndex> fork;
+    BuildBranch(fork, &chain[195], 10, 1);
+    BOOST_CHECK(cache.Sync(&fork[9], 10));
+    BOOST_CHECK_EQUAL(cache.Height(), 205);
+    BOOST_CHECK(!cache.Contains(&chain[196]));
+    BOOST_CHECK(!cache.Contains(&chain[199]));
+    CheckCache(cache, &fork[9], 0);
+
+    // Back to a shorter branch: the entries above its tip are dropped
+    BOOST_CHECK(cache.Sync(&chain[199], 10));
+    BOOST_CHECK_EQUAL(cache.Height(), 199);
+    BOOST_CHECK(!cache.Contains(&fork[0]));
+    CheckCache(cache, &chain[199], 0);
+
+    // A block the cache already holds needs nothing
+    BOOST_CHECK(cache.Sync(&chain[150], 10));
+    BOOST_CHECK_EQUAL(cache.Height(), 199);
+    CheckCache(cache, &chain[150], 0);
+}
+
+BOOST_AUTO_TEST_CASE(retarget_cache_deep_fork)
+{
+    std::vector<CBlockIndex> chain;
+    BuildBranch(chain, NULL, 200, 0);
+    CRetargetCache cache;
+    BOOST_CHECK(cache.Sync(&chain[199], 10));
+
+    // A fork deeper than nMaxReorg is refused, and the cache left as it was
+    std::vector<CBlockIndex> fork;
+    BuildBranch(fork, &chain[50], 160, 2);
+    BOOST_CHECK(!cache.Sync(&fork[159], 24));
+    BOOST_CHECK_EQUAL(cache.Height(), 199);
+    CheckCache(cache, &chain[199], 0);
+
+    // It is loaded into a scratch cache instead, covering just the window
+    CRetargetCache scratch;
+    scratch.Load(&fork[159], 24);
+    BOOST_CHECK_EQUAL(scratch.Height(), 210);
+    BOOST_CHECK(!scratch.Contains(&fork[135]));
+    CheckCache(scratch, &fork[159], 187);
+
+    // Loading again replaces the window, wherever it was
+    scratch.Load(&chain[100], 24);
+    BOOST_CHECK_EQUAL(scratch.Height(), 100);
+    BOOST_CHECK(!scratch.Contains(&fork[159]));
+    CheckCache(scratch, &chain[100], 77);
+}
+
+BOOST_AUTO_TEST_CASE(retarget_window_deep_fork)
+{
+    // An instance following one chain, then asked about a deep fork, must
+    // answer as a fresh instance does, and still follow its chain afterwards.
+    const Consensus::Params& params = Params().GetConsensus();
+    std::vector<CBlockIndex> chain;
+    BuildBranch(chain, NULL, 300, 0);
+    std::vector<CBlockIndex> fork;
+    BuildBranch(fork, &chain[100], 150, 3);
+
+    CBlockHeader header;
+    for (const char* strName : {"dgw3", "digishield", "oss"}) {
+        std::unique_ptr<CRetarget> retarget = CreateRetarget(strName, params);
+        for (int i = 100; i < 300; i++) {
+            header.nTime = chain[i].nTime + 150;
+            retarget->GetNextWorkRequired(&chain[i], &header, params);
+        }
+
+        header.nTime = fork[149].nTime + 150;
+        unsigned int nBits = retarget->GetNextWorkRequired(&fork[149], &header, params);
+        BOOST_CHECK_EQUAL(nBits, CreateRetarget(strName, params)->GetNextWorkRequired(&fork[149], &header, params));
+
+        header.nTime = chain[299].nTime + 150;
+        nBits = retarget->GetNextWorkRequired(&chain[299], &header, params);
+        BOOST_CHECK_EQUAL(nBits, CreateRetarget(strName, params)->GetNextWorkRequired(&chain[299], &header, params));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(retarget_kgw_matches_pprev_walk)
+{
+    // The cached window must give the targets the pprev walk gave, bit for bit
+    const Consensus::Params& params = Params().GetConsensus();
+    std::vector<CBlockIndex> chain;
+    BuildRandomChain(chain, 3000);
+
+    std::unique_ptr<CRetarget> retarget = CreateRetarget("kgw", params);
+    CBlockHeader header;
+    for (int i = 1; i < 3000; i++) {
+        header.nTime = chain[i].nTime + 150;
+        BOOST_CHECK_EQUAL(retarget->GetNextWorkRequired(&chain[i], &header, params), ReferenceKGW(&chain[i], params));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(retarget_dgw_matches_pprev_walk)
+{
+    const Consensus::Params& params = Params().GetConsensus();
+    std::vector<CBlockIndex> chain;
+    BuildRandomChain(chain, 3000);
+
+    std::unique_ptr<CRetarget> retarget = CreateRetarget("dgw3", params);
+    CBlockHeader header;
+    for (int i = 1; i < 3000; i++) {
+        header.nTime = chain[i].nTime + 150;
+        BOOST_CHECK_EQUAL(retarget->GetNextWorkRequired(&chain[i], &header, params), ReferenceDGW(&chain[i], params));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(retarget_lwma_clamp)
+{
+    // Timestamps running backwards make the weighted solve time negative: the
+    // target must bottom out at a tenth of the window's average, not reach zero
+    const Consensus::Params& params = Params().GetConsensus();
+    const int64_t N = params.nLWMAWindow;
+    const int64_t T = params.nPowTargetSpacing;
+    std::vector<CBlockIndex> chain;
+    BuildBranch(chain, NULL, 200, 0);
+    for (int i = 200 - N; i < 200; i++)
+        chain[i].nTime = chain[i - 1].nTime - 100;
+
+    std::unique_ptr<CRetarget> retarget = CreateRetarget("lwma", params);
+    CBlockHeader header;
+    header.nTime = chain[199].nTime + T;
+    unsigned int nBits = retarget->GetNextWorkRequired(&chain[199], &header, params);
+    BOOST_CHECK(retarget->GetLastState().nFlags & RETARGET_CLAMP_LOW);
+
+    const int64_t k = N * (N + 1) / 2 * T;
+    arith_uint256 bnExpected;
+    for (int i = 200 - N; i < 200; i++)
+        bnExpected += arith_uint256().SetCompact(chain[i].nBits);
+    bnExpected *= (uint32_t)(k / 10);
+    bnExpected /= arith_uint256(N * k);
+    BOOST_CHECK_EQUAL(nBits, bnExpected.GetCompact());
+
+    // Before the backwards run there is nothing to clamp
+    retarget->GetNextWorkRequired(&chain[120], &header, params);
+    BOOST_CHECK_EQUAL((int)retarget->GetLastState().nFlags, 0);
+}
+
+BOOST_AUTO_TEST_CASE(retarget_lwma_reorg)
+{
+    // LWMA slides its sums along with the tip; across reorgs of any depth it
+    // must answer as an instance that builds them from the window does
+    const Consensus::Params& params = Params().GetConsensus();
+    std::vector<CBlockIndex> chain;
+    BuildBranch(chain, NULL, 300, 0);
+    std::vector<CBlockIndex> shallow;
+    BuildBranch(shallow, &chain[297], 5, 4);
+    std::vector<CBlockIndex> deep;
+    BuildBranch(deep, &chain[180], 130, 5);
+
+    std::unique_ptr<CRetarget> retarget = CreateRetarget("lwma", params);
+    CBlockHeader header;
+    std::vector<const CBlockIndex*> vTips;
+    for (int i = 1; i < 300; i++)
+        vTips.push_back(&chain[i]);
+    for (const CBlockIndex& block : shallow)
+        vTips.push_back(&block);
+    vTips.push_back(&chain[299]);
+    for (const CBlockIndex& block : deep)
+        vTips.push_back(&block);
+    vTips.push_back(&shallow[4]);
+    for (const CBlockIndex* pindex : vTips) {
+        header.nTime = pindex->nTime + 150;
+        BOOST_CHECK_EQUAL(retarget->GetNextWorkRequired(pindex, &header, params), CreateRetarget("lwma", params)->GetNextWorkRequired(pindex, &header, params));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(retarget_ema_clamp)
+{
+    // The solve time is bounded to [-6T, 6T]; at the bounds nothing is
+    // flagged, past them the bound is used and the side flagged
+    const Consensus::Params& params = Params().GetConsensus();
+    const int64_t T = params.nPowTargetSpacing;
+    BOOST_REQUIRE_EQUAL(params.nEMAWindow, 36);
+    const struct {
+        int64_t nSolveTime;
+        uint8_t nFlags;
+        uint32_t nBits;
+    } vectors[] = {
+        // 0x1b0404cb * (36T + 5T) / 36T and 0x1b0404cb * (36T - 7T) / 36T
+        { 6 * T,        0,                   0x1b0493ae },
+        { 6 * T + 1,    RETARGET_CLAMP_HIGH, 0x1b0493ae },
+        { 100 * T,      RETARGET_CLAMP_HIGH, 0x1b0493ae },
+        { -6 * T,       0,                   0x1b033cbf },
+        { -6 * T - 1,   RETARGET_CLAMP_LOW,  0x1b033cbf },
+        { -100 * T,     RETARGET_CLAMP_LOW,  0x1b033cbf },
+    };
+
+    std::unique_ptr<CRetarget> retarget = CreateRetarget("ema", params);
+    CBlockHeader header;
+    for (const auto& v : vectors) {
+        std::vector<CBlockIndex> chain(2);
+        chain[0].nTime = 1500000000;
+        chain[1].pprev = &chain[0];
+        chain[1].nHeight = 1;
+        chain[1].nTime = chain[0].nTime + v.nSolveTime;
+        chain[1].nBits = 0x1b0404cb;
+        header.nTime = chain[1].nTime + T;
+        BOOST_CHECK_EQUAL(retarget->GetNextWorkRequired(&chain[1], &header, params), v.nBits);
+        BOOST_CHECK_EQUAL((int)retarget->GetLastState().nFlags, (int)v.nFlags);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(retarget_asert_cubic)
+{
+    // With a half-life of 2^16 seconds the exponent's fraction is the tip's
+    // lateness in seconds, and an anchor of 2^200 puts the cubic's 2^x * 2^16
+    // factor into the target's top bits, exactly
+    Consensus::Params params = Params().GetConsensus();
+    params.nASERTHalfLife = 65536;
+    const int64_t T = params.nPowTargetSpacing;
+    const arith_uint256 bnAnchor = arith_uint256(1) << 200;
+    BOOST_REQUIRE_EQUAL(arith_uint256().SetCompact(0x1a010000).GetHex(), bnAnchor.GetHex());
+
+    // Reference values of 65536 + ((195766423245049 f + 971821376 f^2 + 5127 f^3 + 2^47) >> 48)
+    const std::pair<int64_t, uint32_t> vectors[] = {
+        {0, 65536}, {1, 65537}, {16384, 77938}, {32768, 92674}, {49152, 110225}, {65535, 131071},
+    };
+    std::unique_ptr<CRetarget> retarget = CreateRetarget("asert", params);
+    CBlockHeader header;
+    std::vector<CBlockIndex> chain;
+    for (const auto& v : vectors) {
+        BuildASERTChain(chain, 0x1a010000, T + v.first, 0);
+        arith_uint256 bnNew = arith_uint256().SetCompact(retarget->GetNextWorkRequired(&chain.back(), &header, params));
+        BOOST_CHECK_EQUAL((bnNew >> 184).GetLow64(), v.second);
+    }
+
+    // Across the whole fraction the cubic is within 0.013% of 2^x
+    BuildASERTChain(chain, 0x1a010000, T, 0);
+    for (int64_t nFrac = 0; nFrac < 65536; nFrac += 97) {
+        chain.back().nTime = chain[98].nTime + T + nFrac;
+        arith_uint256 bnNew = arith_uint256().SetCompact(retarget->GetNextWorkRequired(&chain.back(), &header, params));
+        double dFactor = (bnNew >> 184).GetLow64() / 65536.0;
+        BOOST_CHECK_SMALL(dFactor / pow(2.0, nFrac / 65536.0) - 1, 0.00013);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(retarget_asert_vectors)
+{
+    // From an independent big-integer transcription of the aserti3-2d
+    // reference, with Bitcoin Cash's two-day half-life and 150s blocks
+    Consensus::Params params = Params().GetConsensus();
+    params.nASERTHalfLife = 2 * 24 * 60 * 60;
+    BOOST_REQUIRE_EQUAL(params.nPowTargetSpacing, 150);
+    const struct {
+        uint32_t nAnchorBits;
+        int64_t nTimeDelta;
+        int nHeightDelta;
+        uint32_t nBits;
+    } vectors[] = {
+        { 0x1d00ffff, 150, 0, 0x1d00ffff },
+        { 0x1d00ffff, 0, 0, 0x1d00ffd8 },
+        { 0x1d00ffff, 172950, 0, 0x1d01fffe },
+        { 0x1b0404cb, 236550, 1000, 0x1b05aecf },
+        { 0x1b0404cb, 63750, 1000, 0x1b02d767 },
+        { 0x1b0404cb, 129600, 287, 0x1b05aecf },
+        { 0x1b0404cb, 12345, 2000, 0x1b01444a },
+        { 0x1b0404cb, 3688527, 5000, 0x1d081005 },
+        { 0x1c093f8d, -6161850, 5000, 0x17093f8d },
+        { 0x1e00ffff, -3600, 0, 0x1e00fc2f },
+        { 0x1f00ffff, 520050, 10, 0x1f00ffff },
+    };
+
+    CBlockHeader header;
+    for (const auto& v : vectors) {
+        std::vector<CBlockIndex> chain;
+        BuildASERTChain(chain, v.nAnchorBits, v.nTimeDelta, v.nHeightDelta);
+        BOOST_CHECK_EQUAL(CreateRetarget("asert", params)->GetNextWorkRequired(&chain.back(), &header, params), v.nBits);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(retarget_asert_anchor)
+{
+    const Consensus::Params& params = Params().GetConsensus();
+    const int64_t T = params.nPowTargetSpacing;
+    const int64_t nHalfLife = params.nASERTHalfLife;
+    const uint32_t nAnchorBits = 0x1b0404cb;
+    const arith_uint256 bnAnchor = arith_uint256().SetCompact(nAnchorBits);
+    std::unique_ptr<CRetarget> retarget = CreateRetarget("asert", params);
+    CBlockHeader header;
+    std::vector<CBlockIndex> chain;
+
+    // Below the anchor there is nothing to go on
+    BuildASERTChain(chain, nAnchorBits, T, 0);
+    BOOST_CHECK_EQUAL(retarget->GetNextWorkRequired(&chain[98], &header, params), UintToArith256(params.powLimit).GetCompact());
+
+    // On schedule the anchor's target comes back unchanged; a half-life late
+    // or early doubles or halves it
+    for (int nHeightDelta : {0, 1, 287, 10000}) {
+        BuildASERTChain(chain, nAnchorBits, T * (nHeightDelta + 1), nHeightDelta);
+        BOOST_CHECK_EQUAL(retarget->GetNextWorkRequired(&chain.back(), &header, params), nAnchorBits);
+        chain.back().nTime += nHalfLife;
+        BOOST_CHECK_EQUAL(retarget->GetNextWorkRequired(&chain.back(), &header, params), arith_uint256(bnAnchor << 1).GetCompact());
+        chain.back().nTime -= 2 * nHalfLife;
+        BOOST_CHECK_EQUAL(retarget->GetNextWorkRequired(&chain.back(), &header, params), arith_uint256(bnAnchor >> 1).GetCompact());
+    }
+
+    // Far ahead of schedule the target bottoms out at 1; far behind, at powLimit
+    BuildASERTChain(chain, nAnchorBits, -1400000000, 100);
+    BOOST_CHECK_EQUAL(retarget->GetNextWorkRequired(&chain.back(), &header, params), 0x01010000U);
+    BuildASERTChain(chain, nAnchorBits, 2500000000LL, 100);
+    BOOST_CHECK_EQUAL(retarget->GetNextWorkRequired(&chain.back(), &header, params), UintToArith256(params.powLimit).GetCompact());
+    BOOST_CHECK(retarget->GetLastState().nFlags & RETARGET_POW_LIMIT);
+
+    // The anchor is kept while calls follow one chain, and found again on a
+    // branch that forked below it
+    BuildASERTChain(chain, nAnchorBits, T * 201, 200);
+    std::vector<CBlockIndex> fork;
+    BuildBranch(fork, &chain[50], 250, 6);
+    std::vector<const CBlockIndex*> vTips;
+    for (int i = 99; i < 300; i++)
+        vTips.push_back(&chain[i]);
+    for (int i = 48; i < 250; i++)
+        vTips.push_back(&fork[i]);
+    vTips.push_back(&chain[299]);
+    for (const CBlockIndex* pindex : vTips)
+        BOOST_CHECK_EQUAL(retarget->GetNextWorkRequired(pindex, &header, params), CreateRetarget("asert", params)->GetNextWorkRequired(pindex, &header, params));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -32,4 +32,26 @@ BOOST_AUTO_TEST_CASE(scrypt_hashtest)
     }
 }
 
+BOOST_AUTO_TEST_CASE(scrypt_multi_matches_generic)
+{
+    // Every lane of the multi-nonce hash must match the generic hash of the
+    // header with that nonce filled in
+    std::vector<unsigned char> header = ParseHex("020000004c1271c211717198227392b029a64a7971931d351b387bb80db027f270411e398a07046f7d4a08dd815412a8712f874a7ebf0507e3878bd24e20a3b73fd750a667d2f451eac7471b00de6659");
+    const int ways = scrypt_multi_ways();
+    BOOST_CHECK(ways == 1 || ways == 4 || ways == 8);
+    std::vector<char> scratchpad(SCRYPT_MULTI_SCRATCHPAD_SIZE);
+    char output[SCRYPT_MAX_WAYS * 32];
+    char generic_scratchpad[SCRYPT_SCRATCHPAD_SIZE];
+    const uint32_t nFirstNonce = 0xfffffff0; // wraps around within the run
+    for (uint32_t nNonce = nFirstNonce; nNonce != nFirstNonce + 64; nNonce += ways) {
+        scrypt_1024_1_1_256_multi((const char*)&header[0], nNonce, output, &scratchpad[0]);
+        for (int i = 0; i < ways; i++) {
+            le32enc(&header[76], nNonce + i);
+            uint256 hash;
+            scrypt_1024_1_1_256_sp_generic((const char*)&header[0], BEGIN(hash), generic_scratchpad);
+            BOOST_CHECK(memcmp(output + 32 * i, hash.begin(), 32) == 0);
+        }
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
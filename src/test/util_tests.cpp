@@ -6,6 +6,7 @@
 
 #include "clientversion.h"
 #include "primitives/transaction.h"
+#include "random.h"
 #include "sync.h"
 #include "utilstrencodings.h"
 #include "utilmoneystr.h"
@@ -266,6 +267,24 @@ BOOST_AUTO_TEST_CASE(util_seed_insecure_rand)
     }
 }
 
+BOOST_AUTO_TEST_CASE(util_FastRandomContext_Seed)
+{
+    FastRandomContext a(true), b(true);
+    // Equal seeds repeat, and seeds differing in any one bit do not.
+    a.Seed(1234);
+    b.Seed(1234);
+    for (int i = 0; i < 16; i++)
+        BOOST_CHECK_EQUAL(a.rand32(), b.rand32());
+    for (int nBit = 0; nBit < 64; nBit++) {
+        a.Seed(1234);
+        b.Seed(1234 ^ ((uint64_t)1 << nBit));
+        bool fDiffer = false;
+        for (int i = 0; i < 4; i++)
+            fDiffer |= a.rand32() != b.rand32();
+        BOOST_CHECK_MESSAGE(fDiffer, strprintf("seed bit %d ignored", nBit));
+    }
+}
+
 BOOST_AUTO_TEST_CASE(util_TimingResistantEqual)
 {
     BOOST_CHECK(TimingResistantEqual(std::string(""), std::string("")));
@@ -13,6 +13,7 @@
 #include "ui_interface.h"
 #include "util.h"
 #include "utilstrencodings.h"
+#include "virtualclock.h"
 #include "warnings.h"
 
 #include <boost/foreach.hpp>
@@ -35,6 +36,8 @@ int64_t GetTimeOffset()
 
 int64_t GetAdjustedTime()
 {
+    if (IsVirtualClockEnabled())
+        return GetVirtualTime();
     return GetTime() + GetTimeOffset();
 }
 
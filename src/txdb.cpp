@@ -7,13 +7,18 @@
 
 #include "chainparams.h"
 #include "hash.h"
+#include "init.h"
 #include "pow.h"
 #include "uint256.h"
+#include "ui_interface.h"
+#include "util.h"
+#include "warnings.h"
 
 #include <stdint.h>
 
 #include <boost/thread.hpp>
 
+static const char DB_COIN = 'C';
 static const char DB_COINS = 'c';
 static const char DB_BLOCK_FILES = 'f';
 static const char DB_TXINDEX = 't';
@@ -25,16 +30,105 @@ static const char DB_REINDEX_FLAG = 'R';
 static const char DB_LAST_BLOCK = 'l';
 
 
+namespace {
+
+/** Key of a coin record: DB_COIN, then the outpoint's txid and VARINT(n). */
+struct CoinEntry {
+    COutPoint* outpoint;
+    char key;
+    CoinEntry(const COutPoint* ptr) : outpoint(const_cast<COutPoint*>(ptr)), key(DB_COIN)  {}
+
+    template<typename Stream>
+    void Serialize(Stream &s) const {
+        s << key;
+        s << outpoint->hash;
+        s << VARINT(outpoint->n);
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        s >> key;
+        s >> outpoint->hash;
+        s >> VARINT(outpoint->n);
+    }
+};
+
+/**
+ * A legacy DB_COINS record: every unspent output of one transaction.
+ *
+ * Serialized format:
+ * - VARINT(nVersion)
+ * - VARINT(nCode)
+ * - unspentness bitvector, for vout[2] and further; least significant byte first
+ * - the non-spent CTxOuts (via CTxOutCompressor)
+ * - VARINT(nHeight)
+ *
+ * The nCode value consists of:
+ * - bit 0: IsCoinBase()
+ * - bit 1: vout[0] is not spent
+ * - bit 2: vout[1] is not spent
+ * - The higher bits encode N, the number of non-zero bytes in the following bitvector.
+ *   - In case both bit 1 and bit 2 are unset, they encode N-1, as there must be at
+ *     least one non-spent output).
+ *
+ * Only read, by CCoinsViewDB::Upgrade.
+ */
+class CLegacyCoins
+{
+public:
+    bool fCoinBase;
+    std::vector<CTxOut> vout; // spent outputs are .IsNull()
+    int nHeight;
+
+    CLegacyCoins() : fCoinBase(false), nHeight(0) {}
+
+    template<typename Stream>
+    void Unserialize(Stream &s) {
+        unsigned int nCode = 0;
+        // version
+        int nVersionDummy;
+        ::Unserialize(s, VARINT(nVersionDummy));
+        // header code
+        ::Unserialize(s, VARINT(nCode));
+        fCoinBase = nCode & 1;
+        std::vector<bool> vAvail(2, false);
+        vAvail[0] = (nCode & 2) != 0;
+        vAvail[1] = (nCode & 4) != 0;
+        unsigned int nMaskCode = (nCode / 8) + ((nCode & 6) != 0 ? 0 : 1);
+        // spentness bitmask
+        while (nMaskCode > 0) {
+            unsigned char chAvail = 0;
+            ::Unserialize(s, chAvail);
+            for (unsigned int p = 0; p < 8; p++) {
+                bool f = (chAvail & (1 << p)) != 0;
+                vAvail.push_back(f);
+            }
+            if (chAvail != 0)
+                nMaskCode--;
+        }
+        // txouts themself
+        vout.assign(vAvail.size(), CTxOut());
+        for (unsigned int i = 0; i < vAvail.size(); i++) {
+            if (vAvail[i])
+                ::Unserialize(s, REF(CTxOutCompressor(vout[i])));
+        }
+        // coinbase height
+        ::Unserialize(s, VARINT(nHeight));
+    }
+};
+
+}
+
 CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true) 
 {
 }
 
-bool CCoinsViewDB::GetCoins(const uint256 &txid, CCoins &coins) const {
-    return db.Read(std::make_pair(DB_COINS, txid), coins);
+bool CCoinsViewDB::GetCoin(const COutPoint &outpoint, Coin &coin) const {
+    return db.Read(CoinEntry(&outpoint), coin);
 }
 
-bool CCoinsViewDB::HaveCoins(const uint256 &txid) const {
-    return db.Exists(std::make_pair(DB_COINS, txid));
+bool CCoinsViewDB::HaveCoin(const COutPoint &outpoint) const {
+    return db.Exists(CoinEntry(&outpoint));
 }
 
 uint256 CCoinsViewDB::GetBestBlock() const {
@@ -44,29 +138,256 @@ uint256 CCoinsViewDB::GetBestBlock() const {
     return hashBestChain;
 }
 
-bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
+bool CCoinsViewDB::WriteCoins(const CCoinsMap &mapCoins, const uint256 &hashBlock) {
     CDBBatch batch(db);
-    size_t count = 0;
     size_t changed = 0;
-    for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
+    for (CCoinsMap::const_iterator it = mapCoins.begin(); it != mapCoins.end(); it++) {
         if (it->second.flags & CCoinsCacheEntry::DIRTY) {
-            if (it->second.coins.IsPruned())
-                batch.Erase(std::make_pair(DB_COINS, it->first));
+            CoinEntry entry(&it->first);
+            if (it->second.coin.IsSpent())
+                batch.Erase(entry);
             else
-                batch.Write(std::make_pair(DB_COINS, it->first), it->second.coins);
+                batch.Write(entry, it->second.coin);
             changed++;
         }
-        count++;
-        CCoinsMap::iterator itOld = it++;
-        mapCoins.erase(itOld);
     }
     if (!hashBlock.IsNull())
         batch.Write(DB_BEST_BLOCK, hashBlock);
 
-    LogPrint("coindb", "Committing %u changed transactions (out of %u) to coin database...\n", (unsigned int)changed, (unsigned int)count);
+    LogPrint("coindb", "Committing %u changed transaction outputs (out of %u) to coin database...\n", (unsigned int)changed, (unsigned int)mapCoins.size());
     return db.WriteBatch(batch);
 }
 
+bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
+    bool ret = WriteCoins(mapCoins, hashBlock);
+    mapCoins.clear();
+    return ret;
+}
+
+CCoinsViewWriteBehind::CCoinsViewWriteBehind(CCoinsViewDB *dbIn) : db(dbIn), fQueued(false), fFailed(false), fStop(false) {
+    threadWrite = std::thread(&TraceThread<std::function<void()> >, "coinsdb", std::function<void()>(std::bind(&CCoinsViewWriteBehind::ThreadWrite, this)));
+}
+
+CCoinsViewWriteBehind::~CCoinsViewWriteBehind() {
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        fStop = true;
+    }
+    cond.notify_all();
+    threadWrite.join();
+}
+
+void CCoinsViewWriteBehind::WaitIdle(std::unique_lock<std::mutex> &lock) const {
+    cond.wait(lock, [this] { return !fQueued; });
+}
+
+void CCoinsViewWriteBehind::ThreadWrite() {
+    std::unique_lock<std::mutex> lock(cs);
+    while (true) {
+        cond.wait(lock, [this] { return fQueued || fStop; });
+        if (!fQueued)
+            return;
+
+        // BatchWrite does not touch the pending map while it is queued, and
+        // readers only look things up in it, so it can be read unlocked.
+        lock.unlock();
+        int64_t nStart = GetTimeMillis();
+        bool fOk = false;
+        try {
+            fOk = db->WriteCoins(*mapPending, hashPending);
+        } catch (const std::runtime_error& e) {
+            LogPrintf("%s: %s\n", __func__, e.what());
+        }
+        LogPrint("coindb", "Background coin database write of %u entries took %dms\n", (unsigned int)mapPending->size(), GetTimeMillis() - nStart);
+        lock.lock();
+
+        fQueued = false;
+        if (fOk) {
+            mapPending.reset();
+            pendingResource.reset();
+            hashPending.SetNull();
+        } else {
+            // The pending map is the only up to date copy of these coins, so
+            // keep serving reads from it, and stop the node now rather than
+            // at the next flush.
+            fFailed = true;
+            const std::string strMessage = "Failed to write to coin database";
+            SetMiscWarning(strMessage);
+            LogPrintf("*** %s\n", strMessage);
+            uiInterface.ThreadSafeMessageBox(_("Error: A fatal internal error occurred, see debug.log for details"), "", CClientUIInterface::MSG_ERROR);
+            StartShutdown();
+        }
+        cond.notify_all();
+    }
+}
+
+bool CCoinsViewWriteBehind::GetCoin(const COutPoint &outpoint, Coin &coin) const {
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        if (mapPending) {
+            CCoinsMap::const_iterator it = static_cast<const CCoinsMap&>(*mapPending).find(outpoint);
+            if (it != mapPending->end()) {
+                if (it->second.coin.IsSpent())
+                    return false;
+                coin = it->second.coin;
+                return true;
+            }
+        }
+    }
+    return db->GetCoin(outpoint, coin);
+}
+
+bool CCoinsViewWriteBehind::HaveCoin(const COutPoint &outpoint) const {
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        if (mapPending) {
+            CCoinsMap::const_iterator it = static_cast<const CCoinsMap&>(*mapPending).find(outpoint);
+            if (it != mapPending->end())
+                return !it->second.coin.IsSpent();
+        }
+    }
+    return db->HaveCoin(outpoint);
+}
+
+uint256 CCoinsViewWriteBehind::GetBestBlock() const {
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        if (mapPending && !hashPending.IsNull())
+            return hashPending;
+    }
+    return db->GetBestBlock();
+}
+
+bool CCoinsViewWriteBehind::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
+    std::unique_lock<std::mutex> lock(cs);
+    WaitIdle(lock);
+    if (fFailed)
+        return false;
+
+    pendingResource.reset(new CCoinsMapMemoryResource());
+    mapPending.reset(new CCoinsMap(0, CCoinsMap::hasher(), CCoinsMap::key_equal(), pendingResource.get()));
+    for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
+        if (it->second.flags & CCoinsCacheEntry::DIRTY)
+            mapPending->emplace(it->first, std::move(it->second));
+        CCoinsMap::iterator itOld = it++;
+        mapCoins.erase(itOld);
+    }
+    hashPending = hashBlock;
+    fQueued = true;
+    cond.notify_all();
+    return true;
+}
+
+CCoinsViewCursor *CCoinsViewWriteBehind::Cursor() const {
+    std::unique_lock<std::mutex> lock(cs);
+    WaitIdle(lock);
+    return db->Cursor();
+}
+
+bool CCoinsViewWriteBehind::Sync() {
+    std::unique_lock<std::mutex> lock(cs);
+    WaitIdle(lock);
+    return !fFailed;
+}
+
+CCoinsViewPrefetch::CCoinsViewPrefetch(CCoinsView *baseIn, int nThreads) : CCoinsViewBacked(baseIn), nGeneration(0), nInFlight(0), fStop(false) {
+    for (int i = 0; i < nThreads; i++)
+        threads.emplace_back(&TraceThread<std::function<void()> >, "prefetch", std::function<void()>(std::bind(&CCoinsViewPrefetch::ThreadPrefetch, this)));
+}
+
+CCoinsViewPrefetch::~CCoinsViewPrefetch() {
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        fStop = true;
+    }
+    cond.notify_all();
+    for (std::thread& thread : threads)
+        thread.join();
+}
+
+void CCoinsViewPrefetch::ThreadPrefetch() {
+    std::unique_lock<std::mutex> lock(cs);
+    while (true) {
+        cond.wait(lock, [this] { return fStop || !queue.empty(); });
+        if (fStop)
+            return;
+
+        COutPoint outpoint = queue.front();
+        queue.pop_front();
+        uint64_t nGenerationStart = nGeneration;
+        nInFlight++;
+        lock.unlock();
+        Coin coin;
+        bool fFound = base->GetCoin(outpoint, coin);
+        lock.lock();
+        if (--nInFlight == 0 && queue.empty())
+            cond.notify_all();
+
+        if (!fFound || nGenerationStart != nGeneration)
+            continue;
+        // Coins that were never asked for (the block did not connect, or the
+        // cache above had them already) pile up; start over when full.
+        if (mapStaged.size() >= MAX_PREFETCH_COINS)
+            mapStaged.clear();
+        mapStaged.emplace(outpoint, std::move(coin));
+    }
+}
+
+void CCoinsViewPrefetch::Invalidate() {
+    std::lock_guard<std::mutex> lock(cs);
+    nGeneration++;
+    queue.clear();
+    mapStaged.clear();
+}
+
+bool CCoinsViewPrefetch::GetCoin(const COutPoint &outpoint, Coin &coin) const {
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        boost::unordered_map<COutPoint, Coin, SaltedOutpointHasher>::iterator it = mapStaged.find(outpoint);
+        if (it != mapStaged.end()) {
+            coin = std::move(it->second);
+            mapStaged.erase(it);
+            return true;
+        }
+    }
+    return base->GetCoin(outpoint, coin);
+}
+
+bool CCoinsViewPrefetch::HaveCoin(const COutPoint &outpoint) const {
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        if (mapStaged.count(outpoint))
+            return true;
+    }
+    return base->HaveCoin(outpoint);
+}
+
+bool CCoinsViewPrefetch::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
+    // Before, so nothing stale is handed out during the write; after, so
+    // lookups that raced with the write are not staged either.
+    Invalidate();
+    bool ret = base->BatchWrite(mapCoins, hashBlock);
+    Invalidate();
+    return ret;
+}
+
+void CCoinsViewPrefetch::Prefetch(const std::vector<COutPoint> &vOutpoints) {
+    if (threads.empty())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        if (queue.size() + vOutpoints.size() > MAX_PREFETCH_COINS)
+            return;
+        queue.insert(queue.end(), vOutpoints.begin(), vOutpoints.end());
+    }
+    cond.notify_all();
+}
+
+void CCoinsViewPrefetch::WaitIdle() {
+    std::unique_lock<std::mutex> lock(cs);
+    cond.wait(lock, [this] { return fStop || (queue.empty() && nInFlight == 0); });
+}
+
 CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe) {
 }
 
@@ -96,25 +417,31 @@ CCoinsViewCursor *CCoinsViewDB::Cursor() const
     /* It seems that there are no "const iterators" for LevelDB.  Since we
        only need read operations on it, use a const-cast to get around
        that restriction.  */
-    i->pcursor->Seek(DB_COINS);
+    i->pcursor->Seek(DB_COIN);
     // Cache key of first record
-    i->pcursor->GetKey(i->keyTmp);
+    if (i->pcursor->Valid()) {
+        CoinEntry entry(&i->keyTmp.second);
+        i->pcursor->GetKey(entry);
+        i->keyTmp.first = entry.key;
+    } else {
+        i->keyTmp.first = 0; // Make sure Valid() and GetKey() return false
+    }
     return i;
 }
 
-bool CCoinsViewDBCursor::GetKey(uint256 &key) const
+bool CCoinsViewDBCursor::GetKey(COutPoint &key) const
 {
     // Return cached key
-    if (keyTmp.first == DB_COINS) {
+    if (keyTmp.first == DB_COIN) {
         key = keyTmp.second;
         return true;
     }
     return false;
 }
 
-bool CCoinsViewDBCursor::GetValue(CCoins &coins) const
+bool CCoinsViewDBCursor::GetValue(Coin &coin) const
 {
-    return pcursor->GetValue(coins);
+    return pcursor->GetValue(coin);
 }
 
 unsigned int CCoinsViewDBCursor::GetValueSize() const
@@ -124,14 +451,92 @@ unsigned int CCoinsViewDBCursor::GetValueSize() const
 
 bool CCoinsViewDBCursor::Valid() const
 {
-    return keyTmp.first == DB_COINS;
+    return keyTmp.first == DB_COIN;
 }
 
 void CCoinsViewDBCursor::Next()
 {
     pcursor->Next();
-    if (!pcursor->Valid() || !pcursor->GetKey(keyTmp))
+    CoinEntry entry(&keyTmp.second);
+    if (!pcursor->Valid() || !pcursor->GetKey(entry)) {
         keyTmp.first = 0; // Invalidate cached key after last record so that Valid() and GetKey() return false
+    } else {
+        keyTmp.first = entry.key;
+    }
+}
+
+/**
+ * Rewrite a chainstate of per-transaction DB_COINS records as per-output
+ * DB_COIN ones. Each record's outputs are written in the same batch that
+ * erases it, so an upgrade that is interrupted (by a crash, or by shutdown,
+ * which it checks for) picks up where it stopped on the next start.
+ */
+bool CCoinsViewDB::Upgrade() {
+    std::unique_ptr<CDBIterator> pcursor(db.NewIterator());
+    pcursor->Seek(std::make_pair(DB_COINS, uint256()));
+    if (!pcursor->Valid()) {
+        return true;
+    }
+
+    int64_t count = 0;
+    int64_t nOutputs = 0;
+    LogPrintf("Upgrading utxo-set database...\n");
+    LogPrintf("[0%%]...");
+    uiInterface.ShowProgress(_("Upgrading UTXO database"), 0);
+    size_t batch_size = 1 << 24;
+    CDBBatch batch(db);
+    int reportDone = 0;
+    std::pair<unsigned char, uint256> key;
+    std::pair<unsigned char, uint256> prev_key = {DB_COINS, uint256()};
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        if (ShutdownRequested()) {
+            break;
+        }
+        if (pcursor->GetKey(key) && key.first == DB_COINS) {
+            if (count++ % 256 == 0) {
+                // Legacy records are in txid order, so the txid's first bytes tell how far along we are
+                uint32_t high = 0x100 * *key.second.begin() + *(key.second.begin() + 1);
+                int percentageDone = (int)(high * 100.0 / 65536.0 + 0.5);
+                uiInterface.ShowProgress(_("Upgrading UTXO database"), percentageDone);
+                if (reportDone < percentageDone/10) {
+                    // report max. every 10% step
+                    LogPrintf("[%d%%]...", percentageDone);
+                    reportDone = percentageDone/10;
+                }
+            }
+            CLegacyCoins old_coins;
+            if (!pcursor->GetValue(old_coins)) {
+                return error("%s: cannot parse legacy coins record", __func__);
+            }
+            COutPoint outpoint(key.second, 0);
+            for (size_t i = 0; i < old_coins.vout.size(); ++i) {
+                if (!old_coins.vout[i].IsNull() && !old_coins.vout[i].scriptPubKey.IsUnspendable()) {
+                    Coin newcoin(std::move(old_coins.vout[i]), old_coins.nHeight, old_coins.fCoinBase);
+                    outpoint.n = i;
+                    CoinEntry entry(&outpoint);
+                    batch.Write(entry, newcoin);
+                    nOutputs++;
+                }
+            }
+            batch.Erase(key);
+            if (batch.SizeEstimate() > batch_size) {
+                db.WriteBatch(batch);
+                batch.Clear();
+                db.CompactRange(prev_key, key);
+                prev_key = key;
+            }
+            pcursor->Next();
+        } else {
+            break;
+        }
+    }
+    db.WriteBatch(batch);
+    db.CompactRange(std::make_pair((unsigned char)DB_COINS, uint256()), key);
+    uiInterface.ShowProgress("", 100);
+    LogPrintf("[%s].\n", ShutdownRequested() ? "CANCELLED" : "DONE");
+    LogPrintf("Upgraded %d transactions to %d unspent outputs\n", count, nOutputs);
+    return !ShutdownRequested();
 }
 
 bool CBlockTreeDB::WriteBatchSync(const std::vector<std::pair<int, const CBlockFileInfo*> >& fileInfo, int nLastFile, const std::vector<const CBlockIndex*>& blockinfo) {
@@ -10,8 +10,13 @@
 #include "dbwrapper.h"
 #include "chain.h"
 
+#include <condition_variable>
+#include <deque>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -41,6 +46,12 @@ static const int64_t nMaxBlockDBCache = 2;
 static const int64_t nMaxBlockDBAndTxIndexCache = 1024;
 //! Max memory allocated to coin DB specific cache (MiB)
 static const int64_t nMaxCoinsDBCache = 8;
+//! -dbwritebehind default
+static const bool DEFAULT_DB_WRITE_BEHIND = true;
+//! -prefetchthreads default
+static const int DEFAULT_PREFETCH_THREADS = 4;
+//! Maximum number of coins held by the prefetch staging area
+static const size_t MAX_PREFETCH_COINS = 100000;
 
 struct CDiskTxPos : public CDiskBlockPos
 {
@@ -75,11 +86,70 @@ protected:
 public:
     CCoinsViewDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
 
-    bool GetCoins(const uint256 &txid, CCoins &coins) const;
-    bool HaveCoins(const uint256 &txid) const;
+    bool GetCoin(const COutPoint &outpoint, Coin &coin) const;
+    bool HaveCoin(const COutPoint &outpoint) const;
     uint256 GetBestBlock() const;
     bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock);
     CCoinsViewCursor *Cursor() const;
+
+    //! Write the dirty entries of mapCoins, and hashBlock if not null, in one batch. mapCoins is left untouched.
+    bool WriteCoins(const CCoinsMap &mapCoins, const uint256 &hashBlock);
+
+    //! Attempt to update from an older database format. Returns whether an error occurred.
+    bool Upgrade();
+};
+
+/**
+ * Write-behind layer on top of CCoinsViewDB.
+ *
+ * BatchWrite() moves the dirty entries into a pending map and returns; a
+ * background thread commits them to the database, together with the best
+ * block marker in the same batch, so the chainstate on disk always matches
+ * some flushed block. Reads look at the pending entries before the database.
+ *
+ * Only one batch is in flight at a time: a BatchWrite() that arrives while
+ * the previous batch is still being written waits for it to finish.
+ *
+ * If a write fails the node is shut down, and the entries stay pending so
+ * reads do not fall back to the outdated database in the meantime.
+ */
+class CCoinsViewWriteBehind : public CCoinsView
+{
+private:
+    CCoinsViewDB *db;
+
+    mutable std::mutex cs;
+    mutable std::condition_variable cond;
+    //! Entries handed over by the last BatchWrite, and the arena they live in. Set while fQueued, and kept after a failed write.
+    std::unique_ptr<CCoinsMapMemoryResource> pendingResource;
+    std::unique_ptr<CCoinsMap> mapPending;
+    uint256 hashPending;
+    bool fQueued;
+    bool fFailed;
+    bool fStop;
+    std::thread threadWrite;
+
+    void ThreadWrite();
+    //! Block until no batch is in flight.
+    void WaitIdle(std::unique_lock<std::mutex> &lock) const;
+
+    CCoinsViewWriteBehind(const CCoinsViewWriteBehind &);
+    void operator=(const CCoinsViewWriteBehind &);
+
+public:
+    explicit CCoinsViewWriteBehind(CCoinsViewDB *dbIn);
+    //! Commits any batch still in flight before returning.
+    ~CCoinsViewWriteBehind();
+
+    bool GetCoin(const COutPoint &outpoint, Coin &coin) const;
+    bool HaveCoin(const COutPoint &outpoint) const;
+    uint256 GetBestBlock() const;
+    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock);
+    //! Waits for the batch in flight, so the cursor sees all flushed coins.
+    CCoinsViewCursor *Cursor() const;
+
+    //! Wait for the batch in flight, if any, to be committed. Returns false if a background write failed.
+    bool Sync();
 };
 
 /** Specialization of CCoinsViewCursor to iterate over a CCoinsViewDB */
@@ -88,8 +158,8 @@ class CCoinsViewDBCursor: public CCoinsViewCursor
 public:
     ~CCoinsViewDBCursor() {}
 
-    bool GetKey(uint256 &key) const;
-    bool GetValue(CCoins &coins) const;
+    bool GetKey(COutPoint &key) const;
+    bool GetValue(Coin &coin) const;
     unsigned int GetValueSize() const;
 
     bool Valid() const;
@@ -99,11 +169,56 @@ private:
     CCoinsViewDBCursor(CDBIterator* pcursorIn, const uint256 &hashBlockIn):
         CCoinsViewCursor(hashBlockIn), pcursor(pcursorIn) {}
     std::unique_ptr<CDBIterator> pcursor;
-    std::pair<char, uint256> keyTmp;
+    std::pair<char, COutPoint> keyTmp;
 
     friend class CCoinsViewDB;
 };
 
+/**
+ * Read-only staging area in front of the coins database.
+ *
+ * Prefetch() queues outpoints for a pool of worker threads, which read them
+ * from the base view in parallel and stage the unspent ones. A cache above
+ * this view then finds those coins in memory instead of reading them one by
+ * one, and each staged coin is handed out once and dropped.
+ *
+ * Every BatchWrite() passing through discards the staged coins and any
+ * lookups in flight, so nothing read before a write can be handed out after.
+ */
+class CCoinsViewPrefetch : public CCoinsViewBacked
+{
+private:
+    mutable std::mutex cs;
+    std::condition_variable cond;
+    std::deque<COutPoint> queue;
+    mutable boost::unordered_map<COutPoint, Coin, SaltedOutpointHasher> mapStaged;
+    //! Bumped around every write, so lookups started before it are not staged.
+    uint64_t nGeneration;
+    //! Lookups taken off the queue and not yet staged or dropped
+    int nInFlight;
+    bool fStop;
+    std::vector<std::thread> threads;
+
+    void ThreadPrefetch();
+    void Invalidate();
+
+    CCoinsViewPrefetch(const CCoinsViewPrefetch &);
+    void operator=(const CCoinsViewPrefetch &);
+
+public:
+    CCoinsViewPrefetch(CCoinsView *baseIn, int nThreads);
+    ~CCoinsViewPrefetch();
+
+    bool GetCoin(const COutPoint &outpoint, Coin &coin) const;
+    bool HaveCoin(const COutPoint &outpoint) const;
+    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock);
+
+    //! Queue outpoints to be looked up in the background.
+    void Prefetch(const std::vector<COutPoint> &vOutpoints);
+    //! Wait until every queued lookup has been staged or dropped.
+    void WaitIdle();
+};
+
 /** Access to the block database (blocks/index/) */
 class CBlockTreeDB : public CDBWrapper
 {
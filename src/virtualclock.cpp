@@ -0,0 +1,74 @@
+// Copyright (c) 2017 The Litebench developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "virtualclock.h"
+
+#include "chain.h"
+#include "pow.h"
+#include "random.h"
+#include "sim/scenario.h"
+#include "sync.h"
+
+#include <assert.h>
+#include <atomic>
+#include <limits>
+#include <math.h>
+#include <memory>
+
+static CCriticalSection cs_virtualClock;
+//! Checked by every GetAdjustedTime() call, so kept outside the lock
+static std::atomic<bool> fVirtualClock(false);
+//! Kept fractional, so short solve times still add up
+static double dVirtualTime = 0;
+static int64_t nVirtualStartTime = 0;
+static CScenario virtualScenario;
+static std::unique_ptr<CScenarioHashrateModel> virtualHashrate;
+static std::unique_ptr<FastRandomContext> virtualClockRng;
+
+void EnableVirtualClock(double dHashrate, int64_t nStartTime, const CScenario& scenario, uint64_t nSeed)
+{
+    LOCK(cs_virtualClock);
+    dVirtualTime = nStartTime;
+    nVirtualStartTime = nStartTime;
+    virtualScenario = scenario;
+    virtualHashrate.reset(new CScenarioHashrateModel(virtualScenario, dHashrate));
+    virtualClockRng.reset(new FastRandomContext(true));
+    virtualClockRng->Seed(nSeed);
+    fVirtualClock = true;
+}
+
+bool IsVirtualClockEnabled()
+{
+    return fVirtualClock;
+}
+
+int64_t GetVirtualTime()
+{
+    LOCK(cs_virtualClock);
+    return (int64_t)dVirtualTime;
+}
+
+int64_t AdvanceVirtualClock(uint32_t nBits)
+{
+    LOCK(cs_virtualClock);
+    assert(fVirtualClock);
+    double dHashrate = virtualHashrate->GetHashrate((int64_t)dVirtualTime - nVirtualStartTime);
+    dVirtualTime += -log(virtualClockRng->randdouble()) * GetBlockWork(nBits) / dHashrate;
+    // A runaway target can push the clock past what a block's nTime can hold.
+    dVirtualTime = std::min(dVirtualTime, (double)std::numeric_limits<uint32_t>::max());
+    return (int64_t)dVirtualTime;
+}
+
+int64_t GetVirtualBlockTime(int64_t nMedianTimePast)
+{
+    LOCK(cs_virtualClock);
+    assert(fVirtualClock);
+    int64_t nNow = (int64_t)dVirtualTime;
+    int64_t nTime = nNow;
+    double dFraction;
+    int64_t nOffset;
+    if (virtualHashrate->GetTimestampSkew(nNow - nVirtualStartTime, dFraction, nOffset) && virtualClockRng->randdouble() < dFraction)
+        nTime = std::min(nNow + nOffset, nNow + MAX_FUTURE_BLOCK_TIME);
+    return std::min<int64_t>(std::max(nTime, nMedianTimePast + 1), std::numeric_limits<uint32_t>::max());
+}
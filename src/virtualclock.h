@@ -0,0 +1,58 @@
+// Copyright (c) 2017 The Litebench developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_VIRTUALCLOCK_H
+#define BITCOIN_VIRTUALCLOCK_H
+
+#include <stdint.h>
+
+class CScenario;
+
+/** Default for -virtualhashrate: 0 keeps the node on the system clock */
+static const double DEFAULT_VIRTUAL_HASHRATE = 0;
+
+/**
+ * The virtual clock lets a node mined with generate behave as if a miner of a
+ * declared hashrate were working on its chain. Blocks are still real scrypt
+ * proofs at whatever target the retarget algorithm picks, but time only moves
+ * when a block is mined, by a solve time drawn from the exponential
+ * distribution that target and the declared hashrate imply. While it is
+ * enabled, GetAdjustedTime() returns virtual time rather than the system
+ * clock plus the network offset.
+ *
+ * Unlike SetMockTime, which pins every GetTime() caller to one value set from
+ * outside, the virtual clock only replaces the node's notion of consensus time
+ * and moves on its own as the chain grows.
+ *
+ * A scenario (see sim/scenario.h) can make the declared hashrate vary over
+ * virtual time, and have some blocks carry skewed timestamps, as it does in
+ * litebench-sim.
+ */
+
+/**
+ * Start the virtual clock at nStartTime, for a declared dHashrate in hashes
+ * per second, scaled over time by scenario. Solve times and skewed
+ * timestamps are drawn from a generator seeded with nSeed.
+ */
+void EnableVirtualClock(double dHashrate, int64_t nStartTime, const CScenario& scenario, uint64_t nSeed);
+
+bool IsVirtualClockEnabled();
+
+/** Current virtual time, in seconds since the epoch. */
+int64_t GetVirtualTime();
+
+/**
+ * Move the virtual clock forward by the time the declared hashrate would take
+ * to solve one block at nBits, and return the new virtual time.
+ */
+int64_t AdvanceVirtualClock(uint32_t nBits);
+
+/**
+ * nTime for a block mined now on top of a block whose median time past is
+ * nMedianTimePast: the virtual time, or the time a skewing miner of the
+ * scenario would pick, always within what ContextualCheckBlockHeader accepts.
+ */
+int64_t GetVirtualBlockTime(int64_t nMedianTimePast);
+
+#endif // BITCOIN_VIRTUALCLOCK_H